@@ -0,0 +1,581 @@
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "leptjson.h"
+#include "leptmsgpack.h"
+#include "leptwriter.h"
+#include "leptcache.h"
+#include "leptreclaim.h"
+#include "leptreader.h"
+#include "leptedit.h"
+#include "leptcontext.h"
+
+/**
+ * bench.c
+ * 极简的性能测试程序。语料在内存中生成，每项测试重复多次取最好成绩。
+ *
+ * 用法：leptjson_bench [测试名 ...]，不带参数时运行全部测试。
+ */
+
+#define BENCH_REPEAT 5
+
+static double bench_now_ms () {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * 生成语料用的可增长字符串。
+ */
+typedef struct {
+	char* s;
+	size_t len, size;
+} bench_buffer;
+
+static void bench_append (bench_buffer* b, const char* s, size_t len) {
+	if (b->len + len + 1 > b->size) {
+		while (b->len + len + 1 > b->size) {
+			b->size = b->size == 0 ? 4096 : b->size * 2;
+		}
+		b->s = (char*)realloc(b->s, b->size);
+	}
+	memcpy(b->s + b->len, s, len);
+	b->len += len;
+	b->s[b->len] = '\0';
+}
+
+static void bench_printf (bench_buffer* b, const char* format, double d) {
+	char tmp[64];
+	bench_append(b, tmp, (size_t)snprintf(tmp, sizeof(tmp), format, d));
+}
+
+/**
+ * 混合语料：n 条记录组成的数组，包含数字、字符串、布尔值和嵌套容器。
+ */
+static char* bench_corpus_mixed (size_t n, size_t* len) {
+	bench_buffer b = { NULL, 0, 0 };
+	size_t i;
+
+	bench_append(&b, "[", 1);
+	for (i = 0; i < n; ++i) {
+		if (i > 0) {
+			bench_append(&b, ",", 1);
+		}
+		bench_printf(&b, "{\"id\":%.0f,\"name\":\"user", (double)i);
+		bench_printf(&b, "%.0f\",\"active\":true,\"score\":", (double)i);
+		bench_printf(&b, "%.17g,\"tags\":[\"alpha\",\"beta\",null],\"pos\":[", i * 0.37);
+		bench_printf(&b, "%.6f,", i * 1.5);
+		bench_printf(&b, "%.6f,", i * -2.25);
+		bench_printf(&b, "%.6f]}", i * 0.125);
+	}
+	bench_append(&b, "]", 1);
+	*len = b.len;
+	return b.s;
+}
+
+static void bench_msgpack () {
+	lept_value v;
+	size_t json_len, mp_len;
+	char* json = bench_corpus_mixed(200000, &json_len);
+	char* mp;
+	double t, parse_ms = 1e30, decode_ms = 1e30;
+	int i;
+
+	lept_init(&v);
+	for (i = 0; i < BENCH_REPEAT; ++i) {
+		t = bench_now_ms();
+		lept_parse(&v, json);
+		t = bench_now_ms() - t;
+		parse_ms = t < parse_ms ? t : parse_ms;
+		lept_free(&v);
+	}
+
+	lept_parse(&v, json);
+	mp = lept_encode_msgpack(&v, &mp_len);
+	lept_free(&v);
+	for (i = 0; i < BENCH_REPEAT; ++i) {
+		t = bench_now_ms();
+		lept_decode_msgpack(&v, mp, mp_len);
+		t = bench_now_ms() - t;
+		decode_ms = t < decode_ms ? t : decode_ms;
+		lept_free(&v);
+	}
+
+	printf("msgpack: json %zu bytes, lept_parse %.1f ms (%.0f MB/s)\n",
+		json_len, parse_ms, json_len / parse_ms / 1e3);
+	printf("msgpack: msgpack %zu bytes (%.0f%%), lept_decode_msgpack %.1f ms (%.1fx)\n",
+		mp_len, mp_len * 100.0 / json_len, decode_ms, parse_ms / decode_ms);
+	free(mp);
+	free(json);
+}
+
+/**
+ * 字符串语料：n 个字符串组成的数组，一半是 ASCII，一半是中文和其它多字节字符。
+ */
+static char* bench_corpus_text (size_t n, size_t* len) {
+	static const char* texts[] = {
+		"\"The quick brown fox jumps over the lazy dog, again and again.\"",
+		"\"\xE6\x95\xB0\xE6\x8D\xAE\xE6\xA0\xBC\xE5\xBC\x8F JSON \xE8\xA7\xA3\xE6\x9E\x90\xE5\x99\xA8 caf\xC3\xA9 \xF0\x9F\x98\x80 \xE2\x82\xAC 12\""
+	};
+	bench_buffer b = { NULL, 0, 0 };
+	size_t i;
+
+	bench_append(&b, "[", 1);
+	for (i = 0; i < n; ++i) {
+		if (i > 0) {
+			bench_append(&b, ",", 1);
+		}
+		bench_append(&b, texts[i & 1], strlen(texts[i & 1]));
+	}
+	bench_append(&b, "]", 1);
+	*len = b.len;
+	return b.s;
+}
+
+/**
+ * 转义语料：n 个字符串，几乎全是 \\uXXXX 转义，包括中文和代理对表示的 emoji。
+ */
+static char* bench_corpus_escaped (size_t n, size_t* len) {
+	static const char* texts[] = {
+		"\"\\u6570\\u636e\\u683c\\u5f0f\\u89e3\\u6790\\u5668\\uff0c\\u4e2d\\u6587\\u6d4b\\u8bd5\"",
+		"\"\\ud83d\\ude00\\ud83d\\udc4d\\ud83c\\udf89\\ud83d\\ude80\\n\\t\\\"ok\\\"\"",
+		"\"caf\\u00e9 \\u00fc\\u00f1\\u00ee\\u00e7\\u00f8\\u00f0\\u00e9 \\u20ac\\u00a3\\u00a5\\r\\n\""
+	};
+	bench_buffer b = { NULL, 0, 0 };
+	size_t i;
+
+	bench_append(&b, "[", 1);
+	for (i = 0; i < n; ++i) {
+		if (i > 0) {
+			bench_append(&b, ",", 1);
+		}
+		bench_append(&b, texts[i % 3], strlen(texts[i % 3]));
+	}
+	bench_append(&b, "]", 1);
+	*len = b.len;
+	return b.s;
+}
+
+static double bench_parse_ms (const char* json, unsigned flags) {
+	lept_value v;
+	double t, best = 1e30;
+	int i;
+
+	lept_init(&v);
+	for (i = 0; i < BENCH_REPEAT; ++i) {
+		t = bench_now_ms();
+		lept_parse_ex(&v, json, flags);
+		t = bench_now_ms() - t;
+		best = t < best ? t : best;
+		lept_free(&v);
+	}
+	return best;
+}
+
+static void bench_utf8 () {
+	size_t len;
+	char* json = bench_corpus_text(500000, &len);
+	double plain_ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+	double strict_ms = bench_parse_ms(json, LEPT_PARSE_VALIDATE_UTF8);
+
+	printf("utf8: %zu bytes, lept_parse %.1f ms (%.0f MB/s)\n", len, plain_ms, len / plain_ms / 1e3);
+	printf("utf8: LEPT_PARSE_VALIDATE_UTF8 %.1f ms (%.0f MB/s, +%.0f%%)\n",
+		strict_ms, len / strict_ms / 1e3, (strict_ms - plain_ms) * 100.0 / plain_ms);
+	free(json);
+}
+
+/**
+ * 同一份语料的紧凑和缩进两种形式。缩进语料再套几层对象，让缩进更深。
+ */
+static void bench_whitespace () {
+	lept_value v, wrap;
+	size_t min_len, pretty_len, i;
+	char* json = bench_corpus_mixed(200000, &min_len);
+	char* pretty;
+	double min_ms, pretty_ms;
+
+	lept_init(&v);
+	lept_parse(&v, json);
+	free(json);
+	for (i = 0; i < 4; ++i) {
+		lept_init(&wrap);
+		lept_set_object(&wrap, 1);
+		lept_move(lept_set_object_value(&wrap, "level", 5), &v);
+		lept_move(&v, &wrap);
+	}
+	json = lept_stringify(&v, &min_len);
+	pretty = lept_stringify_pretty(&v, &pretty_len, 4);
+	lept_free(&v);
+
+	min_ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+	pretty_ms = bench_parse_ms(pretty, LEPT_PARSE_DEFAULT_FLAGS);
+	printf("whitespace: minified %zu bytes, lept_parse %.1f ms (%.0f MB/s)\n",
+		min_len, min_ms, min_len / min_ms / 1e3);
+	printf("whitespace: indented %zu bytes, lept_parse %.1f ms (%.0f MB/s)\n",
+		pretty_len, pretty_ms, pretty_len / pretty_ms / 1e3);
+	free(json);
+	free(pretty);
+}
+
+static void bench_escape () {
+	size_t len;
+	char* json = bench_corpus_escaped(500000, &len);
+	double ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+
+	printf("escape: %zu bytes, lept_parse %.1f ms (%.0f MB/s)\n", len, ms, len / ms / 1e3);
+	free(json);
+}
+
+/**
+ * 同一份小文档反复解析，比较直接解析和经过缓存的耗时。
+ */
+static void bench_cache () {
+	size_t len, i, n = 20000;
+	char* json = bench_corpus_mixed(20, &len);
+	lept_cache* c = lept_cache_new(1 << 20);
+	lept_shared* doc;
+	lept_value v;
+	double parse_ms, cache_ms;
+
+	lept_init(&v);
+	parse_ms = bench_now_ms();
+	for (i = 0; i < n; ++i) {
+		lept_parse(&v, json);
+		lept_free(&v);
+	}
+	parse_ms = bench_now_ms() - parse_ms;
+
+	cache_ms = bench_now_ms();
+	for (i = 0; i < n; ++i) {
+		lept_cache_parse(c, json, LEPT_PARSE_DEFAULT_FLAGS, &doc);
+		lept_shared_release(doc);
+	}
+	cache_ms = bench_now_ms() - cache_ms;
+
+	printf("cache: %zu bytes x %zu, lept_parse %.1f ms, lept_cache_parse %.1f ms (%.0fx)\n",
+		len, n, parse_ms, cache_ms, parse_ms / cache_ms);
+	lept_cache_free(c);
+	free(json);
+}
+
+/**
+ * 调用线程释放一棵大树的耗时：同步 lept_free 和交给后台线程。
+ */
+static void bench_free () {
+	size_t len;
+	char* json = bench_corpus_mixed(200000, &len);
+	lept_value v;
+	double free_ms, deferred_ms, drain_ms;
+
+	lept_init(&v);
+	lept_parse(&v, json);
+	free_ms = bench_now_ms();
+	lept_free(&v);
+	free_ms = bench_now_ms() - free_ms;
+
+	lept_parse(&v, json);
+	deferred_ms = bench_now_ms();
+	lept_free_deferred(&v);
+	deferred_ms = bench_now_ms() - deferred_ms;
+	drain_ms = bench_now_ms();
+	lept_reclaim_drain();
+	drain_ms = bench_now_ms() - drain_ms;
+	lept_reclaim_shutdown();
+
+	printf("free: %zu bytes, lept_free %.1f ms, lept_free_deferred %.3f ms (background %.1f ms)\n",
+		len, free_ms, deferred_ms, drain_ms);
+	free(json);
+}
+
+/**
+ * 只取每条记录的 id 和 name，其余成员跳过。
+ */
+static void bench_projection () {
+	static const char* paths[] = { "[*].id", "[*].name" };
+	size_t len, i;
+	char* json = bench_corpus_mixed(200000, &len);
+	lept_projection* proj = lept_projection_compile(paths, 2);
+	lept_value v;
+	double t, full_ms, checked_ms = 1e30, trusted_ms = 1e30;
+
+	full_ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+	lept_init(&v);
+	for (i = 0; i < BENCH_REPEAT; ++i) {
+		t = bench_now_ms();
+		lept_parse_projected(&v, json, proj, LEPT_PARSE_DEFAULT_FLAGS);
+		t = bench_now_ms() - t;
+		checked_ms = t < checked_ms ? t : checked_ms;
+		lept_free(&v);
+
+		t = bench_now_ms();
+		lept_parse_projected(&v, json, proj, LEPT_PARSE_TRUST_SKIPPED);
+		t = bench_now_ms() - t;
+		trusted_ms = t < trusted_ms ? t : trusted_ms;
+		lept_free(&v);
+	}
+	printf("projection: %zu bytes, lept_parse %.1f ms, projected %.1f ms, TRUST_SKIPPED %.1f ms\n",
+		len, full_ms, checked_ms, trusted_ms);
+	lept_projection_free(proj);
+	free(json);
+}
+
+/**
+ * 从临时文件逐个读出元素，和一次解析整个文本比较。
+ */
+static void bench_reader () {
+	size_t len, n = 0;
+	char* json = bench_corpus_mixed(200000, &len);
+	FILE* fp = tmpfile();
+	lept_array_reader* r;
+	lept_value e;
+	double parse_ms, reader_ms;
+
+	fwrite(json, 1, len, fp);
+	parse_ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+	free(json);
+
+	rewind(fp);
+	reader_ms = bench_now_ms();
+	r = lept_array_reader_open_file(fp, LEPT_PARSE_DEFAULT_FLAGS);
+	while (lept_array_reader_next(r, &e) == LEPT_PARSE_OK) {
+		lept_free(&e);
+		n++;
+	}
+	lept_array_reader_close(r);
+	reader_ms = bench_now_ms() - reader_ms;
+	fclose(fp);
+
+	printf("reader: %zu bytes, lept_parse %.1f ms, lept_array_reader %zu elements %.1f ms (%.0f MB/s)\n",
+		len, parse_ms, n, reader_ms, len / reader_ms / 1e3);
+}
+
+/**
+ * 在一个大文档中反复切换某条记录的 active，和每次修改后完整解析比较。
+ */
+static void bench_edit () {
+	size_t len, i, n = 2000;
+	char* json = bench_corpus_mixed(20000, &len);
+	lept_editor* e = lept_editor_new(LEPT_PARSE_DEFAULT_FLAGS);
+	lept_editor_stats stats;
+	double parse_ms, edit_ms;
+
+	parse_ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+	lept_editor_load(e, json, len);
+	srand(1);
+	edit_ms = bench_now_ms();
+	for (i = 0; i < n; ++i) {
+		const char* text = lept_editor_text(e, NULL);
+		const char* p = strstr(text + (size_t)rand() % (len - 200), "\"active\":") + 9;
+		if (*p == 't') {
+			lept_editor_replace(e, (size_t)(p - text), 4, "false", 5);
+		} else {
+			lept_editor_replace(e, (size_t)(p - text), 5, "true", 4);
+		}
+	}
+	edit_ms = bench_now_ms() - edit_ms;
+	lept_editor_get_stats(e, &stats);
+
+	printf("edit: %zu bytes, lept_parse %.2f ms, lept_editor_replace %.4f ms per edit (%zu bytes reparsed per edit)\n",
+		len, parse_ms, edit_ms / n, (stats.reparsed_bytes - len) / n);
+	lept_editor_free(e);
+	free(json);
+}
+
+/**
+ * 带上限解析（上限足够大，不会触发）和不带上限的 lept_parse 比较，看检查本身的开销。
+ */
+static void bench_limits () {
+	size_t len, i;
+	char* json = bench_corpus_mixed(200000, &len);
+	lept_parse_limits limits = { 0, 0, 0, 0, 0 };
+	lept_value v;
+	double t, parse_ms, limited_ms = 1e30;
+
+	limits.max_input = len;
+	limits.max_nodes = len;
+	limits.max_string = 4096;
+	limits.max_container = 1 << 20;
+	limits.max_bytes = len * 64;
+	parse_ms = bench_parse_ms(json, LEPT_PARSE_DEFAULT_FLAGS);
+	lept_init(&v);
+	for (i = 0; i < BENCH_REPEAT; ++i) {
+		t = bench_now_ms();
+		lept_parse_limited(&v, json, LEPT_PARSE_DEFAULT_FLAGS, &limits);
+		t = bench_now_ms() - t;
+		limited_ms = t < limited_ms ? t : limited_ms;
+		lept_free(&v);
+	}
+	printf("limits: %zu bytes, lept_parse %.1f ms, lept_parse_limited %.1f ms\n", len, parse_ms, limited_ms);
+	free(json);
+}
+
+/**
+ * 组装容器时搬动的字节数：用 lept_context_parse 解析，读出 c.moved，按值的个数平均。
+ */
+static void bench_assembly () {
+	static const unsigned flags[] = { LEPT_PARSE_DEFAULT_FLAGS, LEPT_PARSE_PACKED_NUMBERS };
+	size_t len, i;
+	char* json = bench_corpus_mixed(200000, &len);
+	lept_context c;
+	lept_value v;
+	double parse_ms;
+
+	for (i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+		c.json = json;
+		c.stack = NULL;
+		c.size = c.top = 0;
+		c.flags = flags[i];
+		c.end = NULL;
+		lept_context_set_limits(&c, NULL);
+		lept_context_parse(&c, &v);
+		free(c.stack);
+		lept_free(&v);
+		parse_ms = bench_parse_ms(json, flags[i]);
+		printf("assembly flags %u: %zu values, %zu bytes moved (%.1f per value), lept_parse %.1f ms\n",
+			flags[i], c.nodes, c.moved, (double)c.moved / c.nodes, parse_ms);
+	}
+	free(json);
+}
+
+/**
+ * 并行输出：数字为主和字符串为主的两种语料，分别用 1、2、4、8 个线程。
+ */
+static void bench_parallel_corpus (const char* name, const char* json) {
+	static const int threads[] = { 1, 2, 4, 8 };
+	size_t i, k, length, plength;
+	lept_value v;
+	double t, serial_ms = 1e30, parallel_ms;
+	char *s, *p;
+
+	lept_init(&v);
+	lept_parse(&v, json);
+	for (k = 0; k < BENCH_REPEAT; ++k) {
+		t = bench_now_ms();
+		s = lept_stringify(&v, &length);
+		t = bench_now_ms() - t;
+		serial_ms = t < serial_ms ? t : serial_ms;
+		if (k + 1 < BENCH_REPEAT) {
+			free(s);
+		}
+	}
+	printf("parallel %s: %zu bytes, lept_stringify %.1f ms", name, length, serial_ms);
+	for (i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i) {
+		parallel_ms = 1e30;
+		for (k = 0; k < BENCH_REPEAT; ++k) {
+			t = bench_now_ms();
+			p = lept_stringify_parallel(&v, &plength, 0, threads[i]);
+			t = bench_now_ms() - t;
+			parallel_ms = t < parallel_ms ? t : parallel_ms;
+			if (plength != length || memcmp(p, s, length) != 0) {
+				printf(" (mismatch)");
+			}
+			free(p);
+		}
+		printf(", %d threads %.1f ms", threads[i], parallel_ms);
+	}
+	printf("\n");
+	free(s);
+	lept_free(&v);
+}
+
+static void bench_parallel () {
+	bench_buffer b = { NULL, 0, 0 };
+	size_t i, len;
+	char* json;
+
+	bench_append(&b, "[", 1);
+	for (i = 0; i < 1000000; ++i) {
+		bench_printf(&b, i ? ",%.17g" : "%.17g", (double)i * 1.1 / 7.0);
+	}
+	bench_append(&b, "]", 1);
+	bench_parallel_corpus("numbers", b.s);
+	free(b.s);
+
+	json = bench_corpus_escaped(300000, &len);
+	bench_parallel_corpus("strings", json);
+	free(json);
+}
+
+/**
+ * LEPT_PARSE_RAW_NUMBERS：数字为主和混合两种语料，比较解析时间，以及解析后原样输出的时间。
+ */
+static void bench_raw_corpus (const char* name, const char* json, size_t len) {
+	lept_value v;
+	double t, stringify_ms[2] = { 1e30, 1e30 };
+	size_t k, i, length;
+	unsigned flags[2] = { LEPT_PARSE_DEFAULT_FLAGS, LEPT_PARSE_RAW_NUMBERS };
+	char* s;
+
+	for (i = 0; i < 2; ++i) {
+		lept_init(&v);
+		lept_parse_ex(&v, json, flags[i]);
+		for (k = 0; k < BENCH_REPEAT; ++k) {
+			t = bench_now_ms();
+			s = lept_stringify(&v, &length);
+			t = bench_now_ms() - t;
+			stringify_ms[i] = t < stringify_ms[i] ? t : stringify_ms[i];
+			free(s);
+		}
+		lept_free(&v);
+	}
+	printf("raw %s: %zu bytes, lept_parse %.1f ms, RAW_NUMBERS %.1f ms; lept_stringify %.1f ms, raw %.1f ms\n", name, len,
+		bench_parse_ms(json, flags[0]), bench_parse_ms(json, flags[1]), stringify_ms[0], stringify_ms[1]);
+}
+
+static void bench_raw () {
+	bench_buffer b = { NULL, 0, 0 };
+	size_t i, len;
+	char* json;
+
+	bench_append(&b, "[", 1);
+	for (i = 0; i < 1000000; ++i) {
+		bench_printf(&b, i ? ",%.17g" : "%.17g", (double)i * 1.1 / 7.0);
+	}
+	bench_append(&b, "]", 1);
+	bench_raw_corpus("numbers", b.s, b.len);
+	free(b.s);
+
+	json = bench_corpus_mixed(200000, &len);
+	bench_raw_corpus("mixed", json, len);
+	free(json);
+}
+
+typedef struct {
+	const char* name;
+	void (*run)();
+} bench_entry;
+
+static const bench_entry benches[] = {
+	{ "msgpack", bench_msgpack },
+	{ "utf8", bench_utf8 },
+	{ "whitespace", bench_whitespace },
+	{ "escape", bench_escape },
+	{ "cache", bench_cache },
+	{ "free", bench_free },
+	{ "projection", bench_projection },
+	{ "reader", bench_reader },
+	{ "edit", bench_edit },
+	{ "limits", bench_limits },
+	{ "parallel", bench_parallel },
+	{ "assembly", bench_assembly },
+	{ "raw", bench_raw },
+};
+
+int main (int argc, char* argv[]) {
+	size_t i;
+	int j;
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i) {
+		int selected = argc <= 1;
+		for (j = 1; j < argc; ++j) {
+			selected |= strcmp(argv[j], benches[i].name) == 0;
+		}
+		if (selected) {
+			benches[i].run();
+		}
+	}
+	return 0;
+}
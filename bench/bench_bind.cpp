@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "leptjson.h"
+#include "leptbind.hpp"
+
+/**
+ * bench_bind.cpp
+ * 比较两种读取固定结构消息的方式：
+ * lept_parse 建树之后按键线性查找、逐个字段拷贝，和 lept::parse_into 直接填结构体。
+ */
+
+#define BENCH_REPEAT 5
+
+struct bench_message {
+	std::int64_t id;
+	std::int64_t timestamp;
+	double price;
+	double quantity;
+	bool buy;
+	std::string symbol;
+	std::string venue;
+};
+LEPT_BIND(bench_message,
+	LEPT_REQUIRED_FIELD(bench_message, id),
+	LEPT_FIELD(bench_message, timestamp),
+	LEPT_FIELD(bench_message, price),
+	LEPT_FIELD(bench_message, quantity),
+	LEPT_FIELD(bench_message, buy),
+	LEPT_FIELD(bench_message, symbol),
+	LEPT_FIELD(bench_message, venue));
+
+static double bench_now_ms () {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const lept_value* bench_find (const lept_value* v, const char* key) {
+	size_t i = lept_find_object_index(v, key, std::strlen(key));
+	return i == LEPT_KEY_NOT_EXIST ? nullptr : lept_get_object_value(v, i);
+}
+
+/**
+ * 手写的拷贝，代表绑定层要替换的代码。
+ */
+static bool bench_copy (const lept_value* v, bench_message& m) {
+	const lept_value* f;
+	if ((f = bench_find(v, "id")) == nullptr) {
+		return false;
+	}
+	m.id = static_cast<std::int64_t>(lept_get_number(f));
+	if ((f = bench_find(v, "timestamp")) != nullptr) m.timestamp = static_cast<std::int64_t>(lept_get_number(f));
+	if ((f = bench_find(v, "price")) != nullptr) m.price = lept_get_number(f);
+	if ((f = bench_find(v, "quantity")) != nullptr) m.quantity = lept_get_number(f);
+	if ((f = bench_find(v, "buy")) != nullptr) m.buy = lept_get_boolean(f) != 0;
+	if ((f = bench_find(v, "symbol")) != nullptr) m.symbol.assign(lept_get_string(f), lept_get_string_length(f));
+	if ((f = bench_find(v, "venue")) != nullptr) m.venue.assign(lept_get_string(f), lept_get_string_length(f));
+	return true;
+}
+
+int main () {
+	const size_t n = 200000;
+	std::vector<std::string> messages;
+	size_t bytes = 0, i;
+	int k;
+
+	for (i = 0; i < n; ++i) {
+		char buf[256];
+		std::snprintf(buf, sizeof(buf),
+			"{\"id\":%zu,\"timestamp\":%zu,\"symbol\":\"SYM%zu\",\"venue\":\"XNAS\",\"price\":%zu.25,"
+			"\"quantity\":%zu,\"buy\":%s,\"trace\":{\"hop\":[1,2,3]}}",
+			i, 1700000000000 + i, i % 500, 100 + i % 1000, 1 + i % 50, i % 2 ? "true" : "false");
+		messages.push_back(buf);
+		bytes += messages.back().size();
+	}
+
+	double tree_ms = 1e30, bind_ms = 1e30, sum = 0;
+	for (k = 0; k < BENCH_REPEAT; ++k) {
+		bench_message m;
+		double t = bench_now_ms();
+		for (const std::string& s : messages) {
+			lept_value v;
+			lept_init(&v);
+			if (lept_parse(&v, s.c_str()) == LEPT_PARSE_OK && bench_copy(&v, m)) {
+				sum += m.price;
+			}
+			lept_free(&v);
+		}
+		t = bench_now_ms() - t;
+		tree_ms = t < tree_ms ? t : tree_ms;
+
+		t = bench_now_ms();
+		for (const std::string& s : messages) {
+			if (!lept::parse_into(s, m)) {
+				sum -= m.price;
+			}
+		}
+		t = bench_now_ms() - t;
+		bind_ms = t < bind_ms ? t : bind_ms;
+	}
+
+	std::printf("bind: %zu messages %zu bytes, lept_parse + copy %.1f ms (%.0f MB/s), lept::parse_into %.1f ms (%.0f MB/s)%s\n",
+		n, bytes, tree_ms, bytes / tree_ms / 1e3, bind_ms, bytes / bind_ms / 1e3, sum == 0 ? "" : " (mismatch)");
+	return 0;
+}
@@ -0,0 +1,603 @@
+#ifndef LEPTBIND_HPP__
+#define LEPTBIND_HPP__
+
+#include "leptjson.hpp"
+#include "leptscan.h"
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * 把 JSON 直接解析到 C++ 结构体，只有头文件，需要 C++17。
+ *
+ * 每个结构体在全局作用域用 LEPT_BIND 描述一次字段（最多 64 个），解析时不建 lept_value 树：
+ * 键在编译期生成的完美哈希表中查找，数字和字符串直接转换到字段里。
+ * 没有绑定的键的值默认用 lept_scan_value 完整检查语法，传入 LEPT_PARSE_TRUST_SKIPPED 时
+ * 才只认括号和字符串地跳过。必需的字段缺失时返回
+ * LEPT_PARSE_MISS_REQUIRED_FIELD，值的类型不符时返回 LEPT_PARSE_TYPE_MISMATCH。
+ *
+ * 字段支持 bool、整数、浮点数、std::string、std::optional（对应 null）、
+ * std::vector（对应数组）以及用 LEPT_BIND 描述过的结构体。
+ * 同一个键出现多次时以最后一次为准。
+ *
+ * 一般用法：
+ 		struct order { std::int64_t id; double price; std::string name; std::vector<std::string> tags; };
+ 		LEPT_BIND(order,
+ 			LEPT_REQUIRED_FIELD(order, id),
+ 			LEPT_FIELD(order, price),
+ 			LEPT_FIELD(order, name),
+ 			LEPT_FIELD(order, tags));
+
+ 		order o;
+ 		std::error_code ec = lept::parse_into(json, o);
+ */
+
+namespace lept {
+
+/**
+ * 一个字段：JSON 中的键和对应的成员指针。
+ */
+template <class T, class M>
+struct field {
+	std::string_view name;
+	M T::* member;
+	bool required;
+};
+
+template <class T, class M>
+constexpr field<T, M> make_field(std::string_view name, M T::* member, bool required = false) {
+	return field<T, M>{ name, member, required };
+}
+
+/**
+ * 结构体的字段表。特化时提供 static constexpr 的 fields，是 make_field 组成的 std::tuple，
+ * 一般用 LEPT_BIND 生成。
+ */
+template <class T>
+struct binding;
+
+/* 键和成员同名时用这两个宏，不同名时直接调用 lept::make_field */
+#define LEPT_FIELD(type, member) ::lept::make_field(#member, &type::member)
+#define LEPT_REQUIRED_FIELD(type, member) ::lept::make_field(#member, &type::member, true)
+
+#define LEPT_BIND(type, ...) \
+	template <> \
+	struct lept::binding<type> { \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
+	}
+
+namespace detail {
+
+template <class T, class = void>
+struct is_bound : std::false_type {};
+template <class T>
+struct is_bound<T, std::void_t<decltype(binding<T>::fields)>> : std::true_type {};
+
+template <class T>
+struct is_optional : std::false_type {};
+template <class T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <class T>
+struct is_vector : std::false_type {};
+template <class T, class A>
+struct is_vector<std::vector<T, A>> : std::true_type {};
+
+/**
+ * 带种子的 FNV-1a，编译期建表和运行时查找共用。
+ */
+constexpr std::uint32_t key_hash(const char* s, std::size_t len, std::uint32_t seed) {
+	std::uint32_t h = 2166136261u ^ seed;
+	for (std::size_t i = 0; i < len; ++i) {
+		h ^= static_cast<unsigned char>(s[i]);
+		h *= 16777619u;
+	}
+	return h ^ (h >> 16);
+}
+
+/**
+ * 完美哈希的参数：表大小是 2 的幂，至少为键数的两倍；
+ * 每个大小尝试 256 个种子，找不到没有冲突的种子时表扩大一倍。
+ */
+struct hash_plan {
+	std::uint32_t seed;
+	std::size_t size;
+};
+
+template <std::size_t N>
+constexpr bool has_collision(const std::array<std::string_view, N>& keys, std::uint32_t seed, std::size_t size) {
+	std::array<bool, (N == 0 ? 1 : N) * 64> used{};
+	for (std::size_t i = 0; i < N; ++i) {
+		std::size_t slot = key_hash(keys[i].data(), keys[i].size(), seed) & (size - 1);
+		if (used[slot]) {
+			return true;
+		}
+		used[slot] = true;
+	}
+	return false;
+}
+
+template <std::size_t N>
+constexpr hash_plan make_hash_plan(const std::array<std::string_view, N>& keys) {
+	std::size_t size = 1;
+	while (size < N * 2) {
+		size *= 2;
+	}
+	for (; size <= (N == 0 ? 1 : N) * 64; size *= 2) {
+		for (std::uint32_t seed = 0; seed < 256; ++seed) {
+			if (!has_collision(keys, seed, size)) {
+				return hash_plan{ seed, size };
+			}
+		}
+	}
+	return hash_plan{ 0, 0 };
+}
+
+/**
+ * 结构体 T 的字段名、哈希表和查找函数，全部在编译期确定。
+ */
+template <class T>
+struct object_binder {
+	static constexpr auto& fields = binding<T>::fields;
+	static constexpr std::size_t count = std::tuple_size<std::decay_t<decltype(binding<T>::fields)>>::value;
+	static constexpr std::size_t npos = count;
+	static_assert(count <= 64, "LEPT_BIND: at most 64 fields");
+
+	template <std::size_t... I>
+	static constexpr std::array<std::string_view, count> make_names(std::index_sequence<I...>) {
+		return { { std::get<I>(fields).name... } };
+	}
+	static constexpr std::array<std::string_view, count> names = make_names(std::make_index_sequence<count>());
+
+	static constexpr bool unique_names() {
+		for (std::size_t i = 0; i < count; ++i) {
+			for (std::size_t j = i + 1; j < count; ++j) {
+				if (names[i] == names[j]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	static_assert(unique_names(), "LEPT_BIND: duplicate field names");
+
+	static constexpr hash_plan plan = make_hash_plan(names);
+	static_assert(plan.size != 0, "LEPT_BIND: no perfect hash for these field names");
+
+	/* 空槽位为 npos */
+	static constexpr std::array<std::size_t, plan.size> make_slots() {
+		std::array<std::size_t, plan.size> slots{};
+		for (std::size_t i = 0; i < plan.size; ++i) {
+			slots[i] = npos;
+		}
+		for (std::size_t i = 0; i < count; ++i) {
+			slots[key_hash(names[i].data(), names[i].size(), plan.seed) & (plan.size - 1)] = i;
+		}
+		return slots;
+	}
+	static constexpr std::array<std::size_t, plan.size> slots = make_slots();
+
+	/**
+	 * 一次哈希和一次比较，不存在时返回 npos。
+	 */
+	static std::size_t find(const char* key, std::size_t len) noexcept {
+		std::size_t i = slots[key_hash(key, len, plan.seed) & (plan.size - 1)];
+		if (i != npos && names[i].size() == len && std::memcmp(names[i].data(), key, len) == 0) {
+			return i;
+		}
+		return npos;
+	}
+
+	template <std::size_t... I>
+	static constexpr std::uint64_t make_required(std::index_sequence<I...>) {
+		return ((std::get<I>(fields).required ? std::uint64_t(1) << I : 0) | ... | std::uint64_t(0));
+	}
+	static constexpr std::uint64_t required = make_required(std::make_index_sequence<count>());
+};
+
+/**
+ * 解析的状态：输入以 '\0' 结尾，end 只给跳过和 \u 转义的扫描用。
+ * scratch 存放带转义的键，在整个解析过程中复用。
+ */
+struct reader {
+	const char* p;
+	const char* end;
+	unsigned flags;
+	std::string scratch;
+
+	void skip_whitespace() noexcept {
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+			++p;
+		}
+	}
+
+	/**
+	 * 当前的值和字段类型不符。值本身不合法时返回它的语法错误，否则返回 LEPT_PARSE_TYPE_MISMATCH。
+	 */
+	int mismatch() noexcept {
+		int ret = lept_scan_value(&p, end);
+		return ret != LEPT_PARSE_OK ? ret : LEPT_PARSE_TYPE_MISMATCH;
+	}
+
+	int skip() noexcept {
+		return (flags & LEPT_PARSE_TRUST_SKIPPED) ? lept_skip_value(&p, end) : lept_scan_value(&p, end);
+	}
+
+	bool literal(const char* s, std::size_t len) noexcept {
+		if (std::strncmp(p, s, len) == 0) {
+			p += len;
+			return true;
+		}
+		return false;
+	}
+};
+
+inline void append_utf8(std::string& out, unsigned u) {
+	if (u <= 0x7F) {
+		out += static_cast<char>(u);
+	} else if (u <= 0x7FF) {
+		out += static_cast<char>(0xC0 | (u >> 6));
+		out += static_cast<char>(0x80 | (u & 0x3F));
+	} else if (u <= 0xFFFF) {
+		out += static_cast<char>(0xE0 | (u >> 12));
+		out += static_cast<char>(0x80 | ((u >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (u & 0x3F));
+	} else {
+		out += static_cast<char>(0xF0 | (u >> 18));
+		out += static_cast<char>(0x80 | ((u >> 12) & 0x3F));
+		out += static_cast<char>(0x80 | ((u >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (u & 0x3F));
+	}
+}
+
+/**
+ * 从 r.p 开始解析字符串的剩余部分追加到 out，r.p 在开头的 '"' 之后，返回时在结尾的 '"' 之后。
+ * 普通字符整段追加，和 lept_parse_string_raw 的规则相同。
+ */
+inline int read_string_tail(reader& r, std::string& out) {
+	const char* p = r.p;
+	for (;;) {
+		const char* run = p;
+		while (static_cast<unsigned char>(*p) >= 0x20 && *p != '"' && *p != '\\') {
+			++p;
+		}
+		if ((r.flags & LEPT_PARSE_VALIDATE_UTF8) && lept_scan_utf8(run, static_cast<std::size_t>(p - run)) != LEPT_PARSE_OK) {
+			return LEPT_PARSE_INVALID_UTF8;
+		}
+		out.append(run, static_cast<std::size_t>(p - run));
+
+		if (*p == '"') {
+			r.p = p + 1;
+			return LEPT_PARSE_OK;
+		}
+		if (*p != '\\') {
+			return *p == '\0' ? LEPT_PARSE_MISS_QUOTATION_MARK : LEPT_PARSE_INVALID_STRING_CHAR;
+		}
+		switch (p[1]) {
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				unsigned u;
+				p += 2;
+				int ret = lept_scan_unicode(&p, r.end, &u);
+				if (ret != LEPT_PARSE_OK) {
+					return ret;
+				}
+				append_utf8(out, u);
+				continue;
+			}
+			default:
+				return LEPT_PARSE_INVALID_STRING_ESCAPE;
+		}
+		p += 2;
+	}
+}
+
+/**
+ * 解析键。没有转义时直接指向输入，否则解码到 r.scratch。
+ */
+inline int read_key(reader& r, std::string_view& key) {
+	const char* start = ++r.p;
+	const char* p = start;
+	while (static_cast<unsigned char>(*p) >= 0x20 && *p != '"' && *p != '\\') {
+		++p;
+	}
+	if (*p == '"') {
+		if ((r.flags & LEPT_PARSE_VALIDATE_UTF8) && lept_scan_utf8(start, static_cast<std::size_t>(p - start)) != LEPT_PARSE_OK) {
+			return LEPT_PARSE_INVALID_UTF8;
+		}
+		key = std::string_view(start, static_cast<std::size_t>(p - start));
+		r.p = p + 1;
+		return LEPT_PARSE_OK;
+	}
+	r.scratch.clear();
+	int ret = read_string_tail(r, r.scratch);
+	key = r.scratch;
+	return ret;
+}
+
+/**
+ * 按 JSON 语法检查数字，同 lept_validate_number。
+ * @return 数字之后的位置，不合法时返回 nullptr；integral 表示没有小数和指数部分。
+ */
+inline const char* scan_number(const char* p, bool& integral) noexcept {
+	auto digit = [](char ch) { return ch >= '0' && ch <= '9'; };
+	if (*p == '-') {
+		++p;
+	}
+	if (*p == '0') {
+		++p;
+	} else if (digit(*p)) {
+		while (digit(*p)) ++p;
+	} else {
+		return nullptr;
+	}
+	integral = true;
+	if (*p == '.') {
+		++p;
+		if (!digit(*p)) {
+			return nullptr;
+		}
+		while (digit(*p)) ++p;
+		integral = false;
+	}
+	if (*p == 'e' || *p == 'E') {
+		++p;
+		if (*p == '+' || *p == '-') {
+			++p;
+		}
+		if (!digit(*p)) {
+			return nullptr;
+		}
+		while (digit(*p)) ++p;
+		integral = false;
+	}
+	return p;
+}
+
+template <class N>
+int read_number(reader& r, N& out) {
+	bool integral;
+	const char* e = scan_number(r.p, integral);
+	if (e == nullptr) {
+		return *r.p == '-' || (*r.p >= '0' && *r.p <= '9') ? LEPT_PARSE_INVALID_VALUE : r.mismatch();
+	}
+	if constexpr (std::is_integral<N>::value) {
+		if (integral) {
+			auto res = std::from_chars(r.p, e, out);
+			if (res.ec == std::errc::result_out_of_range) {
+				return LEPT_PARSE_NUMBER_TOO_BIG;
+			}
+			if (res.ec != std::errc() || res.ptr != e) {
+				return LEPT_PARSE_TYPE_MISMATCH;	// 无符号字段遇到负数
+			}
+			r.p = e;
+			return LEPT_PARSE_OK;
+		}
+	}
+
+	/* 和 lept_parse_number 一样用 strtod，整数字段接受 1e3 这样没有小数部分的值 */
+	double d = std::strtod(r.p, nullptr);
+	if (d == HUGE_VAL || d == -HUGE_VAL) {
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	}
+	if constexpr (std::is_integral<N>::value) {
+		if (d != std::trunc(d)) {
+			return LEPT_PARSE_TYPE_MISMATCH;
+		}
+		if (std::is_unsigned<N>::value && d < 0) {
+			return LEPT_PARSE_TYPE_MISMATCH;
+		}
+		/* max + 1.0 是 2 的幂，可以精确表示 */
+		if (d < static_cast<double>(std::numeric_limits<N>::min()) || d >= static_cast<double>(std::numeric_limits<N>::max()) + 1.0) {
+			return LEPT_PARSE_NUMBER_TOO_BIG;
+		}
+	} else {
+		if (std::fabs(d) > static_cast<double>(std::numeric_limits<N>::max())) {
+			return LEPT_PARSE_NUMBER_TOO_BIG;
+		}
+	}
+	out = static_cast<N>(d);
+	r.p = e;
+	return LEPT_PARSE_OK;
+}
+
+template <class T>
+int read_value(reader& r, T& out);
+
+template <class T, std::size_t... I>
+int read_field(reader& r, T& out, std::size_t i, std::index_sequence<I...>) {
+	int ret = LEPT_PARSE_OK;
+	/* 展开成对 I 的比较，编译器一般生成跳转表 */
+	(void)((i == I ? (ret = read_value(r, out.*(std::get<I>(binding<T>::fields).member)), true) : false) || ...);
+	return ret;
+}
+
+template <class T>
+int read_object(reader& r, T& out) {
+	using binder = object_binder<T>;
+	std::uint64_t seen = 0;	// 出现过的字段，用来检查必需的字段
+	int ret;
+
+	if (*r.p != '{') {
+		return r.mismatch();
+	}
+	++r.p;
+	r.skip_whitespace();
+	if (*r.p == '}') {
+		++r.p;
+	} else {
+		for (;;) {
+			std::string_view key;
+			if (*r.p != '"') {
+				return LEPT_PARSE_MISS_KEY;
+			}
+			if ((ret = read_key(r, key)) != LEPT_PARSE_OK) {
+				return ret;
+			}
+			r.skip_whitespace();
+			if (*r.p != ':') {
+				return LEPT_PARSE_MISS_COLON;
+			}
+			++r.p;
+			r.skip_whitespace();
+
+			std::size_t i = binder::find(key.data(), key.size());
+			if (i == binder::npos) {
+				ret = r.skip();
+			} else {
+				ret = read_field(r, out, i, std::make_index_sequence<binder::count>());
+				seen |= std::uint64_t(1) << i;
+			}
+			if (ret != LEPT_PARSE_OK) {
+				return ret;
+			}
+
+			r.skip_whitespace();
+			if (*r.p == ',') {
+				++r.p;
+				r.skip_whitespace();
+			} else if (*r.p == '}') {
+				++r.p;
+				break;
+			} else {
+				return LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+			}
+		}
+	}
+	return (binder::required & ~seen) != 0 ? LEPT_PARSE_MISS_REQUIRED_FIELD : LEPT_PARSE_OK;
+}
+
+template <class V>
+int read_array(reader& r, V& out) {
+	int ret;
+	if (*r.p != '[') {
+		return r.mismatch();
+	}
+	++r.p;
+	out.clear();
+	r.skip_whitespace();
+	if (*r.p == ']') {
+		++r.p;
+		return LEPT_PARSE_OK;
+	}
+	for (;;) {
+		out.emplace_back();
+		if ((ret = read_value(r, out.back())) != LEPT_PARSE_OK) {
+			return ret;
+		}
+		r.skip_whitespace();
+		if (*r.p == ',') {
+			++r.p;
+			r.skip_whitespace();
+		} else if (*r.p == ']') {
+			++r.p;
+			return LEPT_PARSE_OK;
+		} else {
+			return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+		}
+	}
+}
+
+template <class T>
+int read_value(reader& r, T& out) {
+	if constexpr (std::is_same<T, bool>::value) {
+		if (r.literal("true", 4)) {
+			out = true;
+		} else if (r.literal("false", 5)) {
+			out = false;
+		} else {
+			return r.mismatch();
+		}
+		return LEPT_PARSE_OK;
+	} else if constexpr (std::is_arithmetic<T>::value) {
+		return read_number(r, out);
+	} else if constexpr (std::is_same<T, std::string>::value) {
+		if (*r.p != '"') {
+			return r.mismatch();
+		}
+		++r.p;
+		out.clear();
+		return read_string_tail(r, out);
+	} else if constexpr (is_optional<T>::value) {
+		if (r.literal("null", 4)) {
+			out.reset();
+			return LEPT_PARSE_OK;
+		}
+		return read_value(r, out.emplace());
+	} else if constexpr (is_vector<T>::value) {
+		return read_array(r, out);
+	} else {
+		static_assert(is_bound<T>::value, "type has no lept::binding, see LEPT_BIND");
+		return read_object(r, out);
+	}
+}
+
+} // namespace detail
+
+/**
+ * 解析以 '\0' 结尾的 json 到 out，支持的类型见文件开头。
+ * 出错时 out 可能只填了一部分，但总是可以安全析构。
+ * @param flags 	LEPT_PARSE_VALIDATE_UTF8 检查字符串和键，LEPT_PARSE_TRUST_SKIPPED 跳过未绑定的键时不检查语法。
+ */
+template <class T>
+std::error_code parse_into(const char* json, std::size_t len, T& out, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) {
+	assert(json != nullptr && json[len] == '\0');
+	detail::reader r{ json, json + len, flags, std::string() };
+	r.skip_whitespace();
+	int ret = detail::read_value(r, out);
+	if (ret == LEPT_PARSE_OK) {
+		r.skip_whitespace();
+		if (*r.p != '\0') {
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+		}
+	}
+	return make_error_code(static_cast<parse_error>(ret));
+}
+
+template <class T>
+std::error_code parse_into(const char* json, T& out, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) {
+	return parse_into(json, std::strlen(json), out, flags);
+}
+
+template <class T>
+std::error_code parse_into(const std::string& json, T& out, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) {
+	return parse_into(json.c_str(), json.size(), out, flags);
+}
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+/**
+ * 解析 json 到一个新的 T，T 需要可以默认构造。
+ */
+template <class T>
+std::expected<T, std::error_code> parse_as(const std::string& json, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) {
+	T out{};
+	std::error_code ec = parse_into(json, out, flags);
+	if (ec) {
+		return std::unexpected(ec);
+	}
+	return out;
+}
+#endif
+
+} // namespace lept
+
+#endif
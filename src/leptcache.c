@@ -0,0 +1,250 @@
+#include "leptcache.h"
+#include "lepthash.h"
+#include <assert.h> /* assert() */
+#include <stdlib.h> /* NULL, malloc(), calloc(), free() */
+#include <string.h> /* memcpy(), memcmp(), strlen() */
+#include <pthread.h>
+
+#define LEPT_CACHE_MIN_BUCKETS 64
+
+/**
+ * 每个文档同时挂在两个链表上：哈希桶的单链表用于查找，
+ * 双向循环链表按使用时间排序，lru.next 是最近用过的，lru.prev 是最久没用的。
+ */
+typedef struct lept_cache_entry lept_cache_entry;
+struct lept_cache_entry {
+	uint64_t hash;
+	size_t len;
+	unsigned flags;
+	char* json;				// 输入的副本，命中时逐字节比较
+	lept_shared* doc;		// 缓存持有的一个引用
+	size_t bytes;			// 计入预算的字节数
+	lept_cache_entry* chain;
+	lept_cache_entry* prev;
+	lept_cache_entry* next;
+};
+
+struct lept_cache {
+	pthread_mutex_t lock;
+	lept_cache_entry** buckets;
+	size_t bucket_count;	// 2 的幂
+	lept_cache_entry lru;	// 哨兵
+	size_t budget;
+	lept_cache_stats stats;
+};
+
+/**
+ * 估算一棵树占用的堆内存。递归，深度与递归下降的解析相同。
+ */
+static size_t lept_cache_tree_bytes(const lept_value* v) {
+	size_t i, bytes = 0;
+
+	switch (v->type) {
+		case LEPT_NUMBER:
+			return v->flags & LEPT_VALUE_RAW_HEAP ? v->u.r.text.h.len + 1 : 0;
+		case LEPT_STRING:
+			return v->u.s.len + 1;
+		case LEPT_ARRAY:
+			if (v->flags & LEPT_VALUE_PACKED) {
+				return v->u.p.capacity * sizeof(double);
+			}
+			bytes = v->u.a.capacity * sizeof(lept_value);
+			for (i = 0; i < v->u.a.size; i++) {
+				bytes += lept_cache_tree_bytes(&v->u.a.e[i]);
+			}
+			return bytes;
+		case LEPT_OBJECT:
+			bytes = v->u.o.capacity * sizeof(lept_member);
+			for (i = 0; i < v->u.o.size; i++) {
+				bytes += v->u.o.m[i].klen + 1 + lept_cache_tree_bytes(&v->u.o.m[i].v);
+			}
+			return bytes;
+		default:
+			return 0;
+	}
+}
+
+static void lept_cache_unlink(lept_cache_entry* e) {
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+}
+
+static void lept_cache_link_front(lept_cache* c, lept_cache_entry* e) {
+	e->prev = &c->lru;
+	e->next = c->lru.next;
+	c->lru.next->prev = e;
+	c->lru.next = e;
+}
+
+static lept_cache_entry** lept_cache_bucket(lept_cache* c, uint64_t hash) {
+	return &c->buckets[hash & (c->bucket_count - 1)];
+}
+
+static lept_cache_entry* lept_cache_find(lept_cache* c, uint64_t hash, const char* json, size_t len, unsigned flags) {
+	lept_cache_entry* e;
+	for (e = *lept_cache_bucket(c, hash); e != NULL; e = e->chain) {
+		if (e->hash == hash && e->len == len && e->flags == flags && memcmp(e->json, json, len) == 0) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * 从哈希桶和 LRU 链表中摘下 e 并释放，返回时 e 已经无效。
+ */
+static void lept_cache_remove(lept_cache* c, lept_cache_entry* e) {
+	lept_cache_entry** pp = lept_cache_bucket(c, e->hash);
+
+	while (*pp != e) {
+		pp = &(*pp)->chain;
+	}
+	*pp = e->chain;
+	lept_cache_unlink(e);
+	c->stats.entries--;
+	c->stats.bytes -= e->bytes;
+	lept_shared_release(e->doc);
+	free(e->json);
+	free(e);
+}
+
+/**
+ * 文档个数超过桶数时桶数翻倍，平均每个桶不到一个文档。
+ */
+static void lept_cache_grow(lept_cache* c) {
+	size_t i, count = c->bucket_count * 2;
+	lept_cache_entry** buckets = (lept_cache_entry**)calloc(count, sizeof(lept_cache_entry*));
+	lept_cache_entry* e;
+
+	if (buckets == NULL) {
+		return;
+	}
+	for (i = 0; i < c->bucket_count; i++) {
+		while ((e = c->buckets[i]) != NULL) {
+			c->buckets[i] = e->chain;
+			e->chain = buckets[e->hash & (count - 1)];
+			buckets[e->hash & (count - 1)] = e;
+		}
+	}
+	free(c->buckets);
+	c->buckets = buckets;
+	c->bucket_count = count;
+}
+
+lept_cache* lept_cache_new(size_t budget) {
+	lept_cache* c = (lept_cache*)malloc(sizeof(lept_cache));
+
+	assert(c != NULL);
+	pthread_mutex_init(&c->lock, NULL);
+	c->bucket_count = LEPT_CACHE_MIN_BUCKETS;
+	c->buckets = (lept_cache_entry**)calloc(c->bucket_count, sizeof(lept_cache_entry*));
+	assert(c->buckets != NULL);
+	c->lru.prev = c->lru.next = &c->lru;
+	c->budget = budget;
+	memset(&c->stats, 0, sizeof(c->stats));
+	return c;
+}
+
+void lept_cache_clear(lept_cache* c) {
+	assert(c != NULL);
+	pthread_mutex_lock(&c->lock);
+	while (c->lru.next != &c->lru) {
+		lept_cache_remove(c, c->lru.next);
+	}
+	pthread_mutex_unlock(&c->lock);
+}
+
+void lept_cache_free(lept_cache* c) {
+	if (c == NULL) {
+		return;
+	}
+	lept_cache_clear(c);
+	pthread_mutex_destroy(&c->lock);
+	free(c->buckets);
+	free(c);
+}
+
+int lept_cache_parse(lept_cache* c, const char* json, unsigned flags, lept_shared** doc) {
+	size_t len;
+	uint64_t hash;
+	lept_cache_entry* e;
+	lept_shared* s;
+	lept_value v;
+	int ret;
+
+	assert(c != NULL && json != NULL && doc != NULL);
+	len = strlen(json);
+	hash = lept_hash_bytes(json, len, flags);
+
+	pthread_mutex_lock(&c->lock);
+	if ((e = lept_cache_find(c, hash, json, len, flags)) != NULL) {
+		lept_cache_unlink(e);
+		lept_cache_link_front(c, e);
+		c->stats.hits++;
+		*doc = lept_shared_retain(e->doc);
+		pthread_mutex_unlock(&c->lock);
+		return LEPT_PARSE_OK;
+	}
+	c->stats.misses++;
+	pthread_mutex_unlock(&c->lock);
+
+	/* 解析在锁外进行，不同文档的未命中互不阻塞 */
+	lept_init(&v);
+	if ((ret = lept_parse_ex(&v, json, flags)) != LEPT_PARSE_OK) {
+		lept_free(&v);
+		return ret;
+	}
+	s = lept_shared_new(&v);
+	*doc = s;
+
+	e = (lept_cache_entry*)malloc(sizeof(lept_cache_entry));
+	assert(e != NULL);
+	e->hash = hash;
+	e->len = len;
+	e->flags = flags;
+	e->bytes = sizeof(lept_cache_entry) + len + sizeof(lept_value) + lept_cache_tree_bytes(lept_shared_get(s));
+	if (e->bytes > c->budget) {
+		free(e);
+		return LEPT_PARSE_OK;
+	}
+	e->json = (char*)malloc(len + 1);
+	assert(e->json != NULL);
+	memcpy(e->json, json, len + 1);
+	e->doc = lept_shared_retain(s);
+
+	pthread_mutex_lock(&c->lock);
+	/* 其他线程可能同时解析了同一份输入，改用先放进去的那份 */
+	{
+		lept_cache_entry* found = lept_cache_find(c, hash, json, len, flags);
+		if (found != NULL) {
+			*doc = lept_shared_retain(found->doc);
+			pthread_mutex_unlock(&c->lock);
+			lept_shared_release(s);
+			lept_shared_release(e->doc);
+			free(e->json);
+			free(e);
+			return LEPT_PARSE_OK;
+		}
+	}
+	while (c->stats.bytes + e->bytes > c->budget) {
+		lept_cache_remove(c, c->lru.prev);
+		c->stats.evictions++;
+	}
+	e->chain = *lept_cache_bucket(c, hash);
+	*lept_cache_bucket(c, hash) = e;
+	lept_cache_link_front(c, e);
+	c->stats.entries++;
+	c->stats.bytes += e->bytes;
+	if (c->stats.entries > c->bucket_count) {
+		lept_cache_grow(c);
+	}
+	pthread_mutex_unlock(&c->lock);
+	return LEPT_PARSE_OK;
+}
+
+void lept_cache_get_stats(lept_cache* c, lept_cache_stats* stats) {
+	assert(c != NULL && stats != NULL);
+	pthread_mutex_lock(&c->lock);
+	*stats = c->stats;
+	pthread_mutex_unlock(&c->lock);
+}
@@ -0,0 +1,62 @@
+#ifndef LEPTCACHE_H__
+#define LEPTCACHE_H__
+
+#include "leptjson.h"
+#include "leptshared.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 按输入内容寻址的解析缓存。
+ *
+ * 同一份 JSON 文本（例如配置、schema）被反复解析时，第一次解析的结果以只读的
+ * lept_shared 句柄留在缓存里，之后相同的输入直接返回这棵树，不再解析。
+ * 键是输入字节的哈希、长度和解析选项；命中时还会逐字节比较输入，哈希冲突不会返回错的树。
+ *
+ * 缓存按最近最少使用（LRU）淘汰，总占用不超过创建时给定的预算。
+ * 被淘汰的树只是失去缓存持有的引用，调用方拿到的句柄仍然有效。
+ * 所有函数都可以在多个线程中同时调用。
+ */
+
+typedef struct lept_cache lept_cache;
+
+typedef struct {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t entries;		// 当前缓存的文档个数
+	size_t bytes;		// 当前占用的字节数（估算值），不超过预算
+} lept_cache_stats;
+
+/**
+ * @param budget 	内存预算（字节），包括输入文本的副本和解析出来的树。
+ * 					单个文档超过预算时照常解析，但不放入缓存。
+ */
+lept_cache* lept_cache_new(size_t budget);
+
+/**
+ * 释放缓存持有的所有引用。已经返回给调用方的句柄不受影响。
+ */
+void lept_cache_free(lept_cache* c);
+
+/**
+ * 解析以 '\0' 结尾的 json，相同的 json 和 flags 命中缓存时不再解析。
+ * @param doc 		成功时接收只读句柄，调用方用完后调用 lept_shared_release。
+ * @return 			同 lept_parse_ex，解析失败的输入不会被缓存。
+ */
+int lept_cache_parse(lept_cache* c, const char* json, unsigned flags, lept_shared** doc);
+
+/**
+ * 丢弃所有缓存的文档，计数器保持不变。
+ */
+void lept_cache_clear(lept_cache* c);
+
+void lept_cache_get_stats(lept_cache* c, lept_cache_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,6 +14,15 @@ typedef struct {
 	char* stack; 		// 栈
 	size_t top;			// 栈顶
 	size_t size;		// 栈容量
+	unsigned flags;		// 解析选项, lept_parse_flag
+	const char* end;	// 输入结尾，只有投影解析跳过成员时用到
+	size_t max_nodes;	// 资源上限，见 lept_parse_limits；不限制时为 SIZE_MAX，检查时不用再判断
+	size_t max_string;
+	size_t max_container;
+	size_t max_bytes;
+	size_t nodes;		// 已经解析的值的个数
+	size_t bytes;		// 已经计入的树的字节数
+	size_t moved;		// 组装容器时拷贝元素的字节数，用于性能测试
 } lept_context;
 
 /**
@@ -32,4 +41,25 @@ void* lept_context_pop(lept_context* c, size_t len);
  */
 void put_c(lept_context* c, char ch);
 
+/**
+ * 解析 c->json 处的一个值，不检查值之后的内容，返回时 c->json 指向值之后。
+ * 在 leptjson.c 中实现，供需要重复使用同一个上下文的模块调用；c->stack 在调用之间保留。
+ * @return LEPT_PARSE_OK 或 lept_error_type。
+ */
+struct lept_value;
+int lept_context_parse(lept_context* c, struct lept_value* v);
+
+/**
+ * 设置 c 的资源上限并清零计数，limits 为 NULL 时不限制。
+ * 用 lept_context_parse 解析的模块在第一次解析之前调用。
+ */
+struct lept_parse_limits;
+void lept_context_set_limits(lept_context* c, const struct lept_parse_limits* limits);
+
+/**
+ * 同 lept_free，并返回释放的堆内存字节数（按分配时请求的大小计算，包括键），
+ * 供需要统计释放量的模块调用。
+ */
+size_t lept_free_counted(struct lept_value* v);
+
 #endif
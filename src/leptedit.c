@@ -0,0 +1,426 @@
+#include "leptedit.h"
+#include "leptcontext.h"
+#include "leptscan.h"
+#include <assert.h> /* assert() */
+#include <stdlib.h> /* NULL, malloc(), free() */
+#include <string.h> /* memcpy() */
+
+/**
+ * 值在文本中的区间。begin 相对于父节点的开头（根节点为绝对偏移），
+ * 所以一次修改之后只需要移动路径上每一层后面的兄弟，不需要移动它们的整棵子树。
+ * 容器的 children 和数组元素（或对象成员的值）一一对应，标量的 children 为 NULL。
+ */
+typedef struct lept_span lept_span;
+struct lept_span {
+	size_t begin;
+	size_t len;
+	lept_span* children;
+	size_t count;
+};
+
+struct lept_editor {
+	char* text;
+	size_t len;
+	lept_value root;
+	lept_span span;
+	unsigned flags;
+	lept_editor_stats stats;
+};
+
+/**
+ * 解析时暂存在栈上的元素和成员。值和它在文本中的位置成对压栈，
+ * 容器结束时大小已知，一次分配元素（成员）块和 span 的 children，再逐个弹出拷贝到位。
+ */
+typedef struct {
+	lept_value v;
+	lept_span s;
+} lept_edit_element;
+
+typedef struct {
+	lept_member m;
+	lept_span s;
+} lept_edit_member;
+
+/**
+ * 从根到修改位置的路径上的一个容器。
+ */
+typedef struct {
+	lept_value* v;
+	lept_span* s;
+	size_t begin;		// 绝对偏移
+	size_t child;		// 路径的下一层在 s->children 中的下标，没有下一层时为 s->count
+} lept_edit_frame;
+
+static void lept_edit_free_span(lept_span* s) {
+	size_t i;
+	for (i = 0; i < s->count; ++i) {
+		lept_edit_free_span(&s->children[i]);
+	}
+	free(s->children);
+	s->children = NULL;
+	s->count = 0;
+}
+
+static void lept_edit_whitespace(lept_context* c) {
+	char ch = *c->json;
+	if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+		c->json = lept_skip_whitespace(c->json);
+	}
+}
+
+static int lept_edit_parse_value(lept_context* c, const char* base, lept_value* v, lept_span* s);
+
+/**
+ * 解析数组，同时记录每个元素的区间。
+ */
+static int lept_edit_parse_array(lept_context* c, const char* base, lept_value* v, lept_span* s) {
+	size_t i, size = 0;
+	int ret;
+	lept_edit_element e;
+
+	c->json++;
+	lept_edit_whitespace(c);
+	if (*c->json == ']') {
+		c->json++;
+		lept_set_array(v, 0);
+		return LEPT_PARSE_OK;
+	}
+	for (;;) {
+		if ((ret = lept_edit_parse_value(c, base, &e.v, &e.s)) != LEPT_PARSE_OK) {
+			break;
+		}
+		e.s.begin -= s->begin;
+		memcpy(lept_context_push(c, sizeof(e)), &e, sizeof(e));
+		size++;
+
+		lept_edit_whitespace(c);
+		if (*c->json == ',') {
+			c->json++;
+		} else if (*c->json == ']') {
+			c->json++;
+			lept_set_array(v, size);
+			v->u.a.size = size;
+			s->children = (lept_span*)malloc(size * sizeof(lept_span));
+			s->count = size;
+			for (i = size; i-- > 0;) {
+				lept_edit_element* pe = (lept_edit_element*)lept_context_pop(c, sizeof(e));
+				v->u.a.e[i] = pe->v;
+				s->children[i] = pe->s;
+			}
+			if (c->flags & LEPT_PARSE_PACKED_NUMBERS) {
+				lept_pack_array(v);
+			}
+			return LEPT_PARSE_OK;
+		} else {
+			ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+			break;
+		}
+	}
+	for (i = 0; i < size; ++i) {
+		lept_edit_element* pe = (lept_edit_element*)lept_context_pop(c, sizeof(e));
+		lept_free(&pe->v);
+		lept_edit_free_span(&pe->s);
+	}
+	return ret;
+}
+
+/**
+ * 解析对象，记录每个成员的值的区间；键不单独记录，修改键时重新解析整个对象。
+ */
+static int lept_edit_parse_object(lept_context* c, const char* base, lept_value* v, lept_span* s) {
+	size_t i, size = 0;
+	int ret;
+	lept_edit_member m;
+	lept_value key;
+
+	c->json++;
+	lept_edit_whitespace(c);
+	if (*c->json == '}') {
+		c->json++;
+		lept_set_object(v, 0);
+		return LEPT_PARSE_OK;
+	}
+	for (;;) {
+		lept_edit_whitespace(c);
+		if (*c->json != '"') {
+			ret = LEPT_PARSE_MISS_KEY;
+			break;
+		}
+		if ((ret = lept_context_parse(c, &key)) != LEPT_PARSE_OK) {
+			break;
+		}
+		/* 键的字符串直接转给成员，两者都是 malloc(len + 1) 并以 '\0' 结尾 */
+		m.m.k = key.u.s.s;
+		m.m.klen = key.u.s.len;
+		lept_edit_whitespace(c);
+		if (*c->json != ':') {
+			free(m.m.k);
+			ret = LEPT_PARSE_MISS_COLON;
+			break;
+		}
+		c->json++;
+		if ((ret = lept_edit_parse_value(c, base, &m.m.v, &m.s)) != LEPT_PARSE_OK) {
+			free(m.m.k);
+			break;
+		}
+		m.s.begin -= s->begin;
+		memcpy(lept_context_push(c, sizeof(m)), &m, sizeof(m));
+		size++;
+
+		lept_edit_whitespace(c);
+		if (*c->json == ',') {
+			c->json++;
+		} else if (*c->json == '}') {
+			c->json++;
+			lept_set_object(v, size);
+			v->u.o.size = size;
+			s->children = (lept_span*)malloc(size * sizeof(lept_span));
+			s->count = size;
+			for (i = size; i-- > 0;) {
+				lept_edit_member* pm = (lept_edit_member*)lept_context_pop(c, sizeof(m));
+				v->u.o.m[i] = pm->m;
+				s->children[i] = pm->s;
+			}
+			return LEPT_PARSE_OK;
+		} else {
+			ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+			break;
+		}
+	}
+	for (i = 0; i < size; ++i) {
+		lept_edit_member* pm = (lept_edit_member*)lept_context_pop(c, sizeof(m));
+		free(pm->m.k);
+		lept_free(&pm->m.v);
+		lept_edit_free_span(&pm->s);
+	}
+	return ret;
+}
+
+/**
+ * 解析一个值并记录它的区间，s->begin 是相对于 base 的绝对偏移，由调用方转成相对偏移。
+ * 标量直接交给 lept_context_parse，规则和 lept_parse 完全相同。
+ * 失败时 v 为 null，s 没有子节点。
+ */
+static int lept_edit_parse_value(lept_context* c, const char* base, lept_value* v, lept_span* s) {
+	int ret;
+
+	lept_edit_whitespace(c);
+	lept_init(v);
+	s->begin = (size_t)(c->json - base);
+	s->children = NULL;
+	s->count = 0;
+	switch (*c->json) {
+		case '[': ret = lept_edit_parse_array(c, base, v, s); break;
+		case '{': ret = lept_edit_parse_object(c, base, v, s); break;
+		default: ret = lept_context_parse(c, v); break;
+	}
+	s->len = (size_t)(c->json - base) - s->begin;
+	return ret;
+}
+
+/**
+ * 从 text + begin 开始解析一个值，不检查之后的内容。
+ */
+static int lept_edit_parse(lept_editor* e, const char* text, size_t begin, lept_value* v, lept_span* s) {
+	lept_context c;
+	int ret;
+
+	c.json = text + begin;
+	c.stack = NULL;
+	c.size = c.top = 0;
+	c.flags = e->flags;
+	c.end = NULL;
+	lept_context_set_limits(&c, NULL);
+	ret = lept_edit_parse_value(&c, text, v, s);
+	e->stats.reparsed_bytes += (size_t)(c.json - text) - begin;
+
+	assert(c.top == 0);
+	free(c.stack);
+	return ret;
+}
+
+/**
+ * 解析整个文本，值之后只能有空白。
+ */
+static int lept_edit_parse_all(lept_editor* e, const char* text, size_t len, lept_value* v, lept_span* s) {
+	int ret;
+
+	e->stats.full_parses++;
+	if ((ret = lept_edit_parse(e, text, 0, v, s)) == LEPT_PARSE_OK
+			&& lept_skip_whitespace(text + s->begin + s->len) != text + len) {
+		lept_free(v);
+		lept_edit_free_span(s);
+		ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+	}
+	return ret;
+}
+
+/**
+ * 二分查找 begin（相对偏移）不大于 offset 的最后一个子节点，没有时返回 s->count。
+ */
+static size_t lept_edit_find_child(const lept_span* s, size_t offset) {
+	size_t lo = 0, hi = s->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (s->children[mid].begin <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo == 0 ? s->count : lo - 1;
+}
+
+lept_editor* lept_editor_new(unsigned flags) {
+	lept_editor* e = (lept_editor*)calloc(1, sizeof(lept_editor));
+	e->text = (char*)calloc(1, 1);
+	e->flags = flags & ~(unsigned)LEPT_PARSE_TRUST_SKIPPED;
+	lept_init(&e->root);
+	return e;
+}
+
+void lept_editor_free(lept_editor* e) {
+	if (e == NULL) {
+		return;
+	}
+	lept_free(&e->root);
+	lept_edit_free_span(&e->span);
+	free(e->text);
+	free(e);
+}
+
+int lept_editor_load(lept_editor* e, const char* json, size_t len) {
+	assert(e != NULL && (json != NULL || len == 0));
+	lept_value v;
+	lept_span s;
+	int ret;
+	char* text = (char*)malloc(len + 1);
+
+	memcpy(text, json, len);
+	text[len] = '\0';
+	if ((ret = lept_edit_parse_all(e, text, len, &v, &s)) != LEPT_PARSE_OK) {
+		free(text);
+		return ret;
+	}
+	lept_free(&e->root);
+	lept_edit_free_span(&e->span);
+	free(e->text);
+	e->text = text;
+	e->len = len;
+	e->root = v;
+	e->span = s;
+	return LEPT_PARSE_OK;
+}
+
+/**
+ * 只重新解析包含修改的最深的容器。
+ *
+ * 修改之前的文本在容器开头之前完全相同，所以完整解析走到容器开头时，
+ * 和单独解析容器处在同样的状态：单独解析出错时完整解析一定也在同一处出错，直接返回错误；
+ * 单独解析成功但结束位置变了，说明括号或引号的配对变了，改为解析外一层的容器。
+ */
+int lept_editor_replace(lept_editor* e, size_t offset, size_t len, const char* text, size_t text_len) {
+	assert(e != NULL && offset <= e->len && len <= e->len - offset);
+	assert(text != NULL || text_len == 0);
+
+	size_t new_len = e->len - len + text_len;
+	size_t delta = text_len - len;	/* 按模运算，缩短时也能直接加 */
+	size_t i, k, depth = 0, begin = e->span.begin;
+	char* t = (char*)malloc(new_len + 1);
+	lept_value* v = &e->root;
+	lept_span* s = &e->span;
+	lept_edit_frame* f;
+	lept_context path;
+	lept_value nv;
+	lept_span ns;
+	int ret = LEPT_PARSE_OK;
+
+	memcpy(t, e->text, offset);
+	memcpy(t + offset, text, text_len);
+	memcpy(t + offset + text_len, e->text + offset + len, e->len - offset - len);
+	t[new_len] = '\0';
+
+	/* 记录修改完全落在其内部（括号之间）的容器 */
+	path.stack = NULL;
+	path.size = path.top = 0;
+	while ((v->type == LEPT_ARRAY || v->type == LEPT_OBJECT) && begin < offset && offset + len < begin + s->len) {
+		f = (lept_edit_frame*)lept_context_push(&path, sizeof(lept_edit_frame));
+		f->v = v;
+		f->s = s;
+		f->begin = begin;
+		f->child = i = lept_edit_find_child(s, offset - begin);
+		depth++;
+		if (i == s->count || (v->flags & LEPT_VALUE_PACKED)) {
+			break;
+		}
+		v = v->type == LEPT_ARRAY ? &v->u.a.e[i] : &v->u.o.m[i].v;
+		begin += s->children[i].begin;
+		s = &s->children[i];
+	}
+
+	for (k = depth; k-- > 0;) {
+		f = (lept_edit_frame*)path.stack + k;
+		if ((ret = lept_edit_parse(e, t, f->begin, &nv, &ns)) != LEPT_PARSE_OK) {
+			break;
+		}
+		if (ns.len == f->s->len + delta) {
+			lept_free(f->v);
+			*f->v = nv;
+			lept_edit_free_span(f->s);
+			f->s->len = ns.len;
+			f->s->children = ns.children;
+			f->s->count = ns.count;
+			/* 祖先变长，路径右侧的兄弟后移 */
+			while (k-- > 0) {
+				f = (lept_edit_frame*)path.stack + k;
+				f->s->len += delta;
+				for (i = f->child + 1; i < f->s->count; ++i) {
+					f->s->children[i].begin += delta;
+				}
+			}
+			break;
+		}
+		lept_free(&nv);
+		lept_edit_free_span(&ns);
+		if (k == 0) {
+			depth = 0;	/* 根也对不上，下面完整解析 */
+		}
+	}
+	free(path.stack);
+
+	if (ret == LEPT_PARSE_OK && depth == 0) {
+		if ((ret = lept_edit_parse_all(e, t, new_len, &nv, &ns)) == LEPT_PARSE_OK) {
+			lept_free(&e->root);
+			lept_edit_free_span(&e->span);
+			e->root = nv;
+			e->span = ns;
+		}
+	}
+	if (ret != LEPT_PARSE_OK) {
+		free(t);
+		return ret;
+	}
+	free(e->text);
+	e->text = t;
+	e->len = new_len;
+	e->stats.edits++;
+	return LEPT_PARSE_OK;
+}
+
+const lept_value* lept_editor_root(const lept_editor* e) {
+	assert(e != NULL);
+	return &e->root;
+}
+
+const char* lept_editor_text(const lept_editor* e, size_t* len) {
+	assert(e != NULL);
+	if (len != NULL) {
+		*len = e->len;
+	}
+	return e->text;
+}
+
+void lept_editor_get_stats(const lept_editor* e, lept_editor_stats* stats) {
+	assert(e != NULL && stats != NULL);
+	*stats = e->stats;
+}
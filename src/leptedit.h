@@ -0,0 +1,72 @@
+#ifndef LEPTEDIT_H__
+#define LEPTEDIT_H__
+
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 对打开的 JSON 文本做局部修改，只重新解析受影响的最小容器。
+ *
+ * 解析时记录每个值在文本中的区间。修改一段字节之后，从根往下找到完全包含
+ * 这段修改的最深的数组或对象，只重新解析它的新文本，把结果换进原来的树里；
+ * 祖先和兄弟节点不会被重新分配，指向它们的指针在修改之后仍然有效。
+ * 新文本在原来的位置解析不出一个完整的值时（例如修改了括号或引号），
+ * 依次改为解析外层的容器，最后退回到解析整个文本。
+ *
+ * 一般用法：
+ 		lept_editor* e = lept_editor_new(LEPT_PARSE_DEFAULT_FLAGS);
+ 		if (lept_editor_load(e, json, len) == LEPT_PARSE_OK) {
+ 			lept_editor_replace(e, offset, old_len, text, text_len);
+ 			... lept_editor_root(e) ...
+ 		}
+ 		lept_editor_free(e);
+ */
+
+typedef struct lept_editor lept_editor;
+
+typedef struct {
+	size_t edits;			// 成功的修改次数
+	size_t full_parses;		// 解析整个文本的次数，包括 lept_editor_load
+	size_t reparsed_bytes;	// 累计解析的字节数，包括失败后改为解析外层时的尝试
+} lept_editor_stats;
+
+/**
+ * @param flags 	lept_parse_flag 的按位组合，LEPT_PARSE_TRUST_SKIPPED 不起作用。
+ */
+lept_editor* lept_editor_new(unsigned flags);
+
+void lept_editor_free(lept_editor* e);
+
+/**
+ * 复制 json 的 len 个字节并完整解析，替换之前的文本和树。
+ * @return 			同 lept_parse，失败时之前的文本和树保持不变。
+ */
+int lept_editor_load(lept_editor* e, const char* json, size_t len);
+
+/**
+ * 把当前文本中 [offset, offset + len) 的字节换成 text 的 text_len 个字节，并更新树。
+ * @return 			新文本不合法时返回 lept_error_type，文本和树都保持修改之前的状态。
+ */
+int lept_editor_replace(lept_editor* e, size_t offset, size_t len, const char* text, size_t text_len);
+
+/**
+ * 当前的树，只读；在下一次成功的 load 或 replace 之后，被换掉的子树失效，其余部分不变。
+ */
+const lept_value* lept_editor_root(const lept_editor* e);
+
+/**
+ * 当前的文本，以 '\0' 结尾。
+ * @param len 		接收文本长度，可以为 NULL。
+ */
+const char* lept_editor_text(const lept_editor* e, size_t* len);
+
+void lept_editor_get_stats(const lept_editor* e, lept_editor_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,41 @@
+#include "lepthash.h"
+#include <string.h> /* memcpy */
+
+#define LEPT_HASH_P1 0x9E3779B185EBCA87ULL
+#define LEPT_HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define LEPT_HASH_P3 0x165667B19E3779F9ULL
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+uint64_t lept_hash_combine(uint64_t h, uint64_t v) {
+	h += v * LEPT_HASH_P2;
+	h = ROTL64(h, 31);
+	return h * LEPT_HASH_P1;
+}
+
+uint64_t lept_hash_finish(uint64_t h) {
+	h ^= h >> 33;
+	h *= LEPT_HASH_P2;
+	h ^= h >> 29;
+	h *= LEPT_HASH_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t lept_hash_bytes(const void* data, size_t len, uint64_t seed) {
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t h = seed + LEPT_HASH_P3 + (uint64_t)len;
+	uint64_t w;
+
+	/* memcpy 读取未对齐的 8 字节，编译器会优化成一次加载 */
+	while (len >= 8) {
+		memcpy(&w, p, 8);
+		h = lept_hash_combine(h, w);
+		p += 8;
+		len -= 8;
+	}
+	w = 0;
+	memcpy(&w, p, len);
+	h = lept_hash_combine(h, w ^ ((uint64_t)len << 56));
+	return lept_hash_finish(h);
+}
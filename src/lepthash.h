@@ -0,0 +1,27 @@
+#ifndef LEPTHASH_H__
+#define LEPTHASH_H__
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+/**
+ * 内部使用的 64 位哈希，结构与 xxHash64 类似：每次读 8 字节，乘法和循环移位混合，
+ * 最后做一次雪崩。不是加密哈希，只用于查找表和去重。
+ */
+
+/**
+ * 哈希一段字节，seed 不同得到的哈希互不相关。
+ */
+uint64_t lept_hash_bytes(const void* data, size_t len, uint64_t seed);
+
+/**
+ * 把 v 混入 h，用于按顺序组合多个哈希。
+ */
+uint64_t lept_hash_combine(uint64_t h, uint64_t v);
+
+/**
+ * 最终混合，让每个输入位都影响所有输出位。
+ */
+uint64_t lept_hash_finish(uint64_t h);
+
+#endif
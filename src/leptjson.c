@@ -1,75 +1,123 @@
 #include "leptjson.h"
 #include "leptcontext.h"
+#include "leptscan.h"
+#include "lepthash.h"
 #include <assert.h> /* assert() */
 #include <stdlib.h> /* NULL, malloc(), realloc(), free(), strtod() */
-#include <string.h> /* memcpy */
+#include <string.h> /* memcpy, memcmp */
 #include <math.h> /* HUGE_VALF, HUGE_VAL, HUGE_VALL */
 #include <stdio.h>
+#include <stdint.h> /* uint64_t */
 
 #define EXPECT(c, ch) do { assert(*c->json == (ch)); c->json++; } while(0)
 #define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
 #define ISHEX(ch) (ISDIGIT(ch) || ((ch) >= 'A' && (ch) <= ('F')))
 #define ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9') 
 #define ISTOOBIG(n) ((n) == HUGE_VAL || (n) == -HUGE_VAL)
-
-static int lept_parse_value(lept_context* c, lept_value* v);
-
-#define IS_UNICODE_HEX(p) (ISHEX(*p) && ISHEX(*(p + 1)) && ISHEX(*(p + 2)) && ISHEX(*(p + 3))) 
+#define ISWHITESPACE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+#ifndef LEPT_PARSE_ELEMENTS_INIT_SIZE
+#define LEPT_PARSE_ELEMENTS_INIT_SIZE 4	// 容器第一次分配的元素个数，之后按 2 倍扩充
+#endif
+#define LEPT_RAW_PENDING 0x7FF4C45505000000ULL	// 还没转换的 u.r.n 的位模式，是 NaN，合法的 JSON 数字转换不出来
+#define LEPT_CHARGE(c, n) (((c)->bytes += (n)) > (c)->max_bytes)	// 计入 n 字节的树内存，超过 max_bytes 时为真
 
 /**
- * 将 \Uxxxx 的十六进制数转换成码点 (code point)。
- *
- * @param p			待解析的十六进制序列。
- * @param u 		用于接收码点值。
- *
- * @return 			正确返回下一个需要解析的字符，错误则返回 NULL.
+ * 投影解析的字段树，根节点对应整个文档。
  */
-static const char* lept_parse_hex4(const char* p, unsigned* u) {
-	assert(p != NULL && u != NULL);	
-
-	int i;
-	char ch;
-	*u = 0;
-	for(i = 0; i <= 3; ++i) {
-		*u = *u << 4;
-		ch = *p++;
-		if (ch >= '0' && ch <= '9') {
-			*u |= (ch - '0');
-		} else if (ch >= 'A' && ch <= 'F') {
-			*u |= (10 + (ch - 'A'));
-		} else if (ch >= 'a' && ch <= 'f') {
-			*u |= (10 + (ch - 'a'));
-		} else {
-			return NULL;
-		}
-	}	
-	return p;
-}
+struct lept_projection {
+	char* key;
+	size_t klen;
+	int selected;					// 整个值都被选中，不再看子节点
+	lept_projection* members;		// 第一个子键
+	lept_projection* next;			// 同一个对象下的下一个键
+	lept_projection* elements;		// [*]
+};
+
+/* 值没有被选中，已经跳过，不放进结果 */
+#define LEPT_PARSE_SKIPPED (-1)
+
+static int lept_parse_value(lept_context* c, lept_value* v, const lept_projection* node);
+static double lept_number_of(const lept_value* v);
+static size_t lept_free_node(lept_value* v);
 
 /**
- * 将解析出的码点 code point 转存到 lept_context 中。
- * @param c			解析上下文
+ * 将码点编码成 UTF-8，直接写到 o，返回写入之后的位置。
+ * @param o 			输出位置，至少要有 4 字节的空间
  * @param u 		码点
- * @return			无返回值
+ * @return			写入之后的位置
  */
-static void lept_encode_utf8(lept_context* c, unsigned u) {
-	assert(u >= 0x0 && u <= 0x10FFFF);
-	
+static char* lept_encode_utf8(char* o, unsigned u) {
+	assert(u <= 0x10FFFF);
+
 	if (u <= 0x7F) {
-		put_c(c, u & 0xFF);
-	} else if (u >= 0x80 && u <= 0x7FF) {
-		put_c(c, 0xC0 | (u >> 6));
-		put_c(c, 0x80 | (u & 0x3F));
-	} else if (u >=0x800 && u <= 0xFFFF) {
-		put_c(c, 0xE0 | ((u >> 12) & 0xFF));	
-		put_c(c, 0x80 | ((u >>  6) & 0x3F));
-		put_c(c, 0x80 | (u & 0x3F));
+		*o++ = (char)u;
+	} else if (u <= 0x7FF) {
+		*o++ = (char)(0xC0 | (u >> 6));
+		*o++ = (char)(0x80 | (u & 0x3F));
+	} else if (u <= 0xFFFF) {
+		*o++ = (char)(0xE0 | (u >> 12));
+		*o++ = (char)(0x80 | ((u >>  6) & 0x3F));
+		*o++ = (char)(0x80 | (u & 0x3F));
 	} else {
-		put_c(c, 0xF0 | ((u >> 18) & 0xFF));
-		put_c(c, 0xE0 | ((u >> 12) & 0x3F));	
-		put_c(c, 0x80 | ((u >>  6) & 0x3F));
-		put_c(c, 0x80 | (u & 0x3F));
+		*o++ = (char)(0xF0 | (u >> 18));
+		*o++ = (char)(0x80 | ((u >> 12) & 0x3F));
+		*o++ = (char)(0x80 | ((u >>  6) & 0x3F));
+		*o++ = (char)(0x80 | (u & 0x3F));
 	}
+	return o;
+}
+
+/**
+ * 简单转义字符（\n 等）对应的字符，0 表示不是合法的转义。
+ */
+static const char lept_escape_table[256] = {
+	['\"'] = '\"', ['\\'] = '\\', ['/'] = '/', ['b'] = '\b',
+	['f'] = '\f', ['n'] = '\n', ['r'] = '\r', ['t'] = '\t'
+};
+
+#define LEPT_ESCAPE_RESERVE 64	// 每次为转义结果预留的字节数，一个转义最多输出 4 字节
+
+/**
+ * 解析一段连续的转义序列。
+ * 输出空间每次预留一块，转义结果直接写进去，不再逐字节 put_c，最后把栈顶调整到实际写入的位置。
+ * @param pp 		指向第一个 '\\'，成功后移到这段转义之后
+ * @param head 		字符串在栈中的起点，每预留一块之前检查 max_string，全是转义的长字符串也会及早停下
+ * @return			LEPT_PARSE_OK 或错误码，出错时由调用方恢复栈顶
+ */
+static int lept_parse_escapes(lept_context* c, const char** pp, size_t head) {
+	const char* p = *pp;
+	char* o = (char*)lept_context_push(c, LEPT_ESCAPE_RESERVE);
+	char* limit = o + LEPT_ESCAPE_RESERVE;
+	unsigned u;
+	int ret;
+	char ch;
+
+	do {
+		if (limit - o < 4) {
+			if ((size_t)(o - (c->stack + head)) > c->max_string) {
+				return LEPT_PARSE_STRING_TOO_LONG;
+			}
+			c->top = (size_t)(o - c->stack);
+			o = (char*)lept_context_push(c, LEPT_ESCAPE_RESERVE);
+			limit = o + LEPT_ESCAPE_RESERVE;
+		}
+		if (p[1] == 'u') {
+			p += 2;
+			if ((ret = lept_scan_unicode(&p, NULL, &u)) != LEPT_PARSE_OK) {
+				return ret;
+			}
+			o = lept_encode_utf8(o, u);
+		} else if ((ch = lept_escape_table[(unsigned char)p[1]]) != 0) {
+			*o++ = ch;
+			p += 2;
+		} else {
+			return LEPT_PARSE_INVALID_STRING_ESCAPE;
+		}
+	} while (*p == '\\');
+
+	c->top = (size_t)(o - c->stack);
+	*pp = p;
+	return LEPT_PARSE_OK;
 }
 
 #define STRING_ERROR(c, ret) do { (c)->top = head; return (ret); } while (0);
@@ -80,7 +128,8 @@ static void lept_encode_utf8(lept_context* c, unsigned u) {
 static int lept_parse_string_raw (lept_context* c, char **str, size_t* len) {
 	size_t head = c->top;
 	const char* p;
-	unsigned high, low, u;
+	const char* run;
+	int ret;
 	EXPECT(c, '\"');
 	
 	p = c->json;
@@ -89,44 +138,13 @@ static int lept_parse_string_raw (lept_context* c, char **str, size_t* len) {
 
 		switch (ch) {
 			case '\\':
-				switch (*p++) {
-					case '\"': put_c(c, '\"'); break;
-					case '\\': put_c(c, '\\'); break;
-					case '/': put_c(c, '/'); break;
-					case 'b': put_c(c, '\b'); break;
-					case 'f': put_c(c, '\f'); break;
-					case 'n': put_c(c, '\n'); break;
-					case 'r': put_c(c, '\r'); break;
-					case 't': put_c(c, '\t'); break;
-					case 'u':
-						if (!(p = lept_parse_hex4(p, &high))) {
-							STRING_ERROR(c, LEPT_PARSE_INVALID_UNICODE_HEX);
-						}
-						 
-						// Surrogate Check
-						if (high >= 0xD800 && high <= 0xDBFF) {
-							if (*p == '\\' && *(p + 1) == 'u') {
-								if (!(p = lept_parse_hex4(p, &low))) {
-									STRING_ERROR(c, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-								}
-								if (low >= 0xDC00 && low <= 0xDFFF) {
-									u = 0x10000 + (high - 0xD800) * 0x400 + (low - 0xDC00);
-								} else {
-									STRING_ERROR(c, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-								}
-							} else {
-								STRING_ERROR(c, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-							}	
-						} else if (high >= 0xDC00 && high <= 0xDFFF) {
-							STRING_ERROR(c, LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-						} else {
-							u = high; 	
-						}
-						lept_encode_utf8(c, u);
-						break;
-					default:
-						STRING_ERROR(c, LEPT_PARSE_INVALID_STRING_ESCAPE);
-				};
+				p--;
+				if ((ret = lept_parse_escapes(c, &p, head)) != LEPT_PARSE_OK) {
+					STRING_ERROR(c, ret);
+				}
+				if (c->top - head > c->max_string) {
+					STRING_ERROR(c, LEPT_PARSE_STRING_TOO_LONG);
+				}
 				break;
 			case '\"':
 				*len = c->top - head;
@@ -141,7 +159,19 @@ static int lept_parse_string_raw (lept_context* c, char **str, size_t* len) {
 					c->top = head;
 					STRING_ERROR(c, LEPT_PARSE_INVALID_STRING_CHAR);
 				}
-				put_c(c, ch);
+				/* 普通字符整段拷贝，UTF-8 检查也在这一段上做 */
+				run = p - 1;
+				while ((unsigned char)*p >= 0x20 && *p != '\"' && *p != '\\') {
+					p++;
+				}
+				if ((c->flags & LEPT_PARSE_VALIDATE_UTF8) && lept_scan_utf8(run, p - run) != LEPT_PARSE_OK) {
+					STRING_ERROR(c, LEPT_PARSE_INVALID_UTF8);
+				}
+				/* 在压栈之前检查，超长的字符串不会让栈继续扩大 */
+				if (c->top - head + (size_t)(p - run) > c->max_string) {
+					STRING_ERROR(c, LEPT_PARSE_STRING_TOO_LONG);
+				}
+				memcpy(lept_context_push(c, p - run), run, p - run);
 		}
 	}
 }
@@ -156,6 +186,9 @@ static int lept_parse_string (lept_context* c, lept_value* v) {
 	size_t len;
 	
 	if ((ret = lept_parse_string_raw(c, &str, &len)) == LEPT_PARSE_OK) {
+		if (LEPT_CHARGE(c, len + 1)) {
+			return LEPT_PARSE_TOO_MANY_BYTES;
+		}
 		lept_set_string(v, str, len);	
 	}
 	return ret;
@@ -163,13 +196,17 @@ static int lept_parse_string (lept_context* c, lept_value* v) {
 
 /**
  * 文本解析时过滤掉其中的空白, 将指针移动到非空白字符的位置。
+ * 最常见的是没有空白或者只有一个空格，这两种情况不调用 lept_skip_whitespace。
  */
 static void lept_parse_whitespace(lept_context* c) {
 	const char* p = c->json;
-	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+	if (ISWHITESPACE(*p)) {
 		p++;
+		if (ISWHITESPACE(*p)) {
+			p = lept_skip_whitespace(p);
+		}
+		c->json = p;
 	}
-	c->json = p;
 }
 
 /**
@@ -268,6 +305,87 @@ static int lept_validate_number(lept_context *c, const char** end) {
 	return LEPT_PARSE_OK;
 }
 
+/**
+ * 数字的十进制量级是否可能超出 double 的范围。去掉前导 0 之后整数部分的位数加上指数
+ * 不超过 308 时，绝对值小于 1e308，一定不会溢出，解析时不用转换。
+ * @param p 		已经检查过语法的数字
+ */
+static int lept_number_may_overflow(const char* p, const char* end) {
+	long digits = 0, exp = 0;
+	int neg = 0;
+
+	if (*p == '-') {
+		p++;
+	}
+	while (*p == '0') {
+		p++;
+	}
+	for (; ISDIGIT(*p); ++p) {
+		digits++;
+	}
+	while (p < end && *p != 'e' && *p != 'E') {
+		p++;
+	}
+	if (p < end) {
+		p++;
+		if (*p == '+' || *p == '-') {
+			neg = *p++ == '-';
+		}
+		/* 指数大到这里就一定溢出或者下溢，后面的位不用再看 */
+		while (p < end && exp < 100000) {
+			exp = exp * 10 + (*p++ - '0');
+		}
+	}
+	return digits + (neg ? -exp : exp) > 308;
+}
+
+/**
+ * 写入 u.r.n：converted 时是转换好的 d，否则是表示还没转换的 NaN。
+ */
+static void lept_set_raw_cache(lept_value* v, double d, int converted) {
+	uint64_t bits = LEPT_RAW_PENDING;
+	if (converted) {
+		memcpy(&bits, &d, sizeof(d));
+	}
+	memcpy(&v->u.r.n, &bits, sizeof(bits));
+}
+
+/**
+ * LEPT_PARSE_RAW_NUMBERS：保存 [c->json, end) 的原文，不转换。
+ * 只有可能溢出的数字在解析时转换，保持 LEPT_PARSE_NUMBER_TOO_BIG 的检查，结果同时缓存下来。
+ */
+static int lept_parse_raw_number(lept_context* c, lept_value* v, const char* end) {
+	size_t len = (size_t)(end - c->json);
+	int converted = 0;
+	double d = 0;
+
+	if (lept_number_may_overflow(c->json, end)) {
+		d = strtod(c->json, NULL);
+		if (ISTOOBIG(d)) {
+			return LEPT_PARSE_NUMBER_TOO_BIG;
+		}
+		converted = 1;
+	}
+	if (len < sizeof(v->u.r.text.t)) {
+		memcpy(v->u.r.text.t, c->json, len);
+		v->u.r.text.t[len] = '\0';
+		v->flags = LEPT_VALUE_RAW_NUMBER;
+	} else {
+		if (LEPT_CHARGE(c, len + 1)) {
+			return LEPT_PARSE_TOO_MANY_BYTES;
+		}
+		v->u.r.text.h.s = (char*)malloc(len + 1);
+		memcpy(v->u.r.text.h.s, c->json, len);
+		v->u.r.text.h.s[len] = '\0';
+		v->u.r.text.h.len = len;
+		v->flags = LEPT_VALUE_RAW_NUMBER | LEPT_VALUE_RAW_HEAP;
+	}
+	lept_set_raw_cache(v, d, converted);
+	c->json = end;
+	v->type = LEPT_NUMBER;
+	return LEPT_PARSE_OK;
+}
+
 /**
  * 解析数字
  */
@@ -277,6 +395,9 @@ static int lept_parse_number(lept_context *c, lept_value* v) {
 	if ((checkRet = lept_validate_number(c, &end)) != LEPT_PARSE_OK) {
 		return checkRet;
 	}
+	if (c->flags & LEPT_PARSE_RAW_NUMBERS) {
+		return lept_parse_raw_number(c, v, end);
+	}
 	
 	v->u.n = strtod(c->json, NULL);
 
@@ -288,33 +409,75 @@ static int lept_parse_number(lept_context *c, lept_value* v) {
 	return LEPT_PARSE_OK;
 }
 
+/**
+ * 容器压入第 size 个元素（或成员）之后检查 max_container 和 max_bytes。
+ * 元素已经在栈上，出错时由调用方和其它元素一起释放。
+ */
+static int lept_check_container(lept_context* c, size_t size, size_t elem) {
+	if (size > c->max_container) {
+		return LEPT_PARSE_CONTAINER_TOO_LARGE;
+	}
+	return LEPT_CHARGE(c, elem) ? LEPT_PARSE_TOO_MANY_BYTES : LEPT_PARSE_OK;
+}
+
+/**
+ * 容器的元素直接解析到最终的块里，不经过 lept_context 的栈，关闭时也不用再拷贝一次。
+ * 块放满 *capacity 个 elem 字节的元素之后按 2 倍扩充，c->moved 按 realloc 搬动全部元素计。
+ * @return 			扩充之后的块
+ */
+static void* lept_grow_elements(lept_context* c, void* p, size_t size, size_t* capacity, size_t elem) {
+	if (size < *capacity) {
+		return p;
+	}
+	c->moved += size * elem;
+	*capacity = *capacity == 0 ? LEPT_PARSE_ELEMENTS_INIT_SIZE : *capacity * 2;
+	return realloc(p, *capacity * elem);
+}
+
+/**
+ * 容器关闭时把块缩小到 len 字节，realloc 缩小时通常原地完成，不计入 c->moved。
+ * len 为 0 时（投影解析跳过了所有元素）释放块，返回 NULL。
+ */
+static void* lept_shrink_elements(void* p, size_t len, size_t old_len) {
+	if (len == 0) {
+		free(p);
+		return NULL;
+	}
+	return len < old_len ? realloc(p, len) : p;
+}
+
 /**
  * 解析数组
+ * @param node 		投影解析时每个元素对应的字段树，为 NULL 时保留全部元素。
  */
-static int lept_parse_array(lept_context* c, lept_value* v) {
+static int lept_parse_array(lept_context* c, lept_value* v, const lept_projection* node) {
 	assert(v != NULL);
 
 	int ret;
-	size_t i, size = 0;
+	size_t i, size = 0, capacity = 0, numbers = 0;
+	lept_value* e = NULL;
 	
 	EXPECT(c, '[');
 	lept_parse_whitespace(c);
 	if (*c->json == ']') {
 		c->json ++;
 		v->type = LEPT_ARRAY;
-		v->u.a.size = 0;
+		v->u.a.size = v->u.a.capacity = 0;
 		v->u.a.e = NULL;
 		return LEPT_PARSE_OK;
 	}
 
 	for (;;) {
-		lept_value e;
-		lept_init(&e);
+		e = (lept_value*)lept_grow_elements(c, e, size, &capacity, sizeof(lept_value));
+		lept_init(&e[size]);
 
-		if ((ret = lept_parse_value(c, &e)) == LEPT_PARSE_OK) {
+		if ((ret = lept_parse_value(c, &e[size], node)) == LEPT_PARSE_OK) {
+			numbers += (e[size].type == LEPT_NUMBER);
 			size ++;
-			memcpy((lept_value *)lept_context_push(c, sizeof(lept_value)), &e, sizeof(lept_value));
-		} else {
+			if ((ret = lept_check_container(c, size, sizeof(lept_value))) != LEPT_PARSE_OK) {
+				break;
+			}
+		} else if (ret != LEPT_PARSE_SKIPPED) {
 			break;
 		}
 
@@ -326,63 +489,109 @@ static int lept_parse_array(lept_context* c, lept_value* v) {
 		} else if (*c->json == ']') {
 			c->json ++;
 			v->type = LEPT_ARRAY;
-			v->u.a.size = size;
-			size *= sizeof(lept_value);
-			v->u.a.e = malloc(size);
-			memcpy(v->u.a.e, lept_context_pop(c, size), size);
+			if ((c->flags & LEPT_PARSE_PACKED_NUMBERS) && numbers == size && size > 0) {
+				/* 元素全部是数字，拷出 double，不再保留 lept_value；投影跳过了全部元素时按普通空数组处理 */
+				if (LEPT_CHARGE(c, size * sizeof(double))) {
+					ret = LEPT_PARSE_TOO_MANY_BYTES;
+					break;
+				}
+				v->flags |= LEPT_VALUE_PACKED;
+				v->u.p.size = v->u.p.capacity = size;
+				v->u.p.n = (double*)malloc(size * sizeof(double));
+				for (i = 0; i < size; ++i) {
+					v->u.p.n[i] = lept_number_of(&e[i]);
+					lept_free_node(&e[i]);
+				}
+				c->moved += size * sizeof(double);
+				free(e);
+				return LEPT_PARSE_OK;
+			}
+			v->u.a.size = v->u.a.capacity = size;
+			v->u.a.e = (lept_value*)lept_shrink_elements(e, size * sizeof(lept_value), capacity * sizeof(lept_value));
 			return LEPT_PARSE_OK;	
 		} else {
-			return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+			ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+			break;
 		}
 	}
 
-	/**
-	 * 对于从 break 退出 for 循环的情况，要依次弹出栈把之前已经分配的内存给释放掉.
-	 * 如果不释放的话会在	assert(c.top == 0); 失败。
-	 * Pop and free values on the stack.
-	 */
+	/* 出错时释放已经解析的元素和块 */
 	for (i = 0; i < size; ++i) {
-		lept_free((lept_value *)lept_context_pop(c, sizeof(lept_value)));	
+		lept_free(&e[i]);
 	}
+	free(e);
 	return ret;
 }
 
+/**
+ * 投影解析时在 node 的子键中查找 key。
+ */
+static const lept_projection* lept_projection_find(const lept_projection* node, const char* key, size_t klen) {
+	for (node = node->members; node != NULL; node = node->next) {
+		if (node->klen == klen && memcmp(node->key, key, klen) == 0) {
+			return node;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * 跳过一个没有选中的值，不建树。
+ */
+static int lept_parse_skip(lept_context* c) {
+	int ret = (c->flags & LEPT_PARSE_TRUST_SKIPPED)
+		? lept_skip_value(&c->json, c->end)
+		: lept_scan_value(&c->json, c->end);
+	return ret == LEPT_PARSE_OK ? LEPT_PARSE_SKIPPED : ret;
+}
+
 /**
  * 解析对象
+ * @param node 		投影解析时对象对应的字段树，为 NULL 时保留全部成员。
+ * 					没有选中的键不分配内存，值直接跳过。
  */
-static int lept_parse_object (lept_context* c, lept_value* v) {
+static int lept_parse_object (lept_context* c, lept_value* v, const lept_projection* node) {
 	EXPECT(c, '{');
 
 	int ret;
-	size_t i, size = 0;
-	lept_member* pm; 
-	lept_member m;
-	m.k = NULL;
+	size_t i, size = 0, capacity = 0;
+	lept_member* m = NULL;
+	lept_member* pm;
+	char* key = NULL;	// 还没有放进成员的键
+	const lept_projection* child = NULL;
 
 	lept_parse_whitespace(c);
 	if(*c->json == '}') {
 		c->json++;
 		v->type = LEPT_OBJECT;
-		v->u.o.size = 0;
+		v->u.o.size = v->u.o.capacity = 0;
 		v->u.o.m = NULL;
 		return LEPT_PARSE_OK;
 	}
 
 	for (;;) {
 		char* str;
-		lept_init(&m.v);
+		m = (lept_member*)lept_grow_elements(c, m, size, &capacity, sizeof(lept_member));
+		pm = &m[size];
+		lept_init(&pm->v);
 		lept_parse_whitespace(c);
 
 		if (*c->json != '"') {
 			ret = LEPT_PARSE_MISS_KEY;
 			break;
 		} 
-		if ((ret = lept_parse_string_raw(c, &str, &m.klen)) != LEPT_PARSE_OK) {
+		if ((ret = lept_parse_string_raw(c, &str, &pm->klen)) != LEPT_PARSE_OK) {
 			break;
 		}
-		m.k = (char*)malloc(m.klen + 1);
-		memcpy(m.k, str, m.klen);
-		m.k[m.klen] = '\0';
+		if (node == NULL || (child = lept_projection_find(node, str, pm->klen)) != NULL) {
+			if (LEPT_CHARGE(c, pm->klen + 1)) {
+				ret = LEPT_PARSE_TOO_MANY_BYTES;
+				break;
+			}
+			key = (char*)malloc(pm->klen + 1);
+			memcpy(key, str, pm->klen);
+			key[pm->klen] = '\0';
+		}
 		lept_parse_whitespace(c);
 
 		if (*c->json != ':') {
@@ -393,10 +602,17 @@ static int lept_parse_object (lept_context* c, lept_value* v) {
 		c->json++;
 		lept_parse_whitespace(c);
 		
-		if ((ret = lept_parse_value(c, &m.v)) == LEPT_PARSE_OK) {
+		ret = node != NULL && child == NULL ? lept_parse_skip(c) : lept_parse_value(c, &pm->v, child);
+		if (ret == LEPT_PARSE_OK) {
 			size ++;
-			memcpy(lept_context_push(c, sizeof(lept_member)), &m, sizeof(lept_member));
-			m.k = NULL; // ownership is transferred to member on stack.
+			pm->k = key;
+			key = NULL; // ownership is transferred to the member.
+			if ((ret = lept_check_container(c, size, sizeof(lept_member))) != LEPT_PARSE_OK) {
+				break;
+			}
+		} else if (ret == LEPT_PARSE_SKIPPED) {
+			free(key);
+			key = NULL;
 		} else {
 			break;
 		}
@@ -409,11 +625,8 @@ static int lept_parse_object (lept_context* c, lept_value* v) {
 			c->json++;
 
 			v->type = LEPT_OBJECT;
-			v->u.o.size = size;
-			size *= sizeof(lept_member);
-			v->u.o.m = (lept_member* )malloc(size);
-			memcpy(v->u.o.m, lept_context_pop(c, size), size);
-			
+			v->u.o.size = v->u.o.capacity = size;
+			v->u.o.m = (lept_member*)lept_shrink_elements(m, size * sizeof(lept_member), capacity * sizeof(lept_member));
 			return LEPT_PARSE_OK;
 		} else {
 			ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
@@ -421,26 +634,42 @@ static int lept_parse_object (lept_context* c, lept_value* v) {
 		}
 	}
 	
-	/* Pop and free members on the stack */
-	free(m.k);
+	/* 出错时释放已经解析的成员和块 */
+	free(key);
 	for (i = 0; i < size; ++i) {
-		pm = (lept_member*)lept_context_pop(c, sizeof(lept_member));
-		free(pm->k);
-		lept_free(&pm->v);
+		free(m[i].k);
+		lept_free(&m[i].v);
 	}
+	free(m);
 	v->type = LEPT_NULL;	
 	return ret;
 }	
 
 
-static int lept_parse_value(lept_context* c, lept_value* v) {
+/**
+ * @param node 		投影解析时这个值对应的字段树，为 NULL 或者整个值都被选中时解析整个值。
+ * 					值的形状和路径对不上时跳过，返回 LEPT_PARSE_SKIPPED。
+ */
+static int lept_parse_value(lept_context* c, lept_value* v, const lept_projection* node) {
+	if (node != NULL && !node->selected) {
+		if (*c->json == '{' && node->members != NULL) {
+			return lept_parse_object(c, v, node);
+		}
+		if (*c->json == '[' && node->elements != NULL) {
+			return lept_parse_array(c, v, node->elements);
+		}
+		return lept_parse_skip(c);
+	}
+	if (++c->nodes > c->max_nodes) {
+		return LEPT_PARSE_TOO_MANY_NODES;
+	}
 	switch (*c->json) {
 		case 'n': return lept_parse_literal(c, LEPT_NULL, v);
 		case 'f': return lept_parse_literal(c, LEPT_FALSE, v);
 		case 't': return lept_parse_literal(c, LEPT_TRUE, v);
 		case '"': return lept_parse_string(c, v);
-		case '[': return lept_parse_array(c, v);
-		case '{': return lept_parse_object(c, v);
+		case '[': return lept_parse_array(c, v, NULL);
+		case '{': return lept_parse_object(c, v, NULL);
 		default: return lept_parse_number(c, v);
 		case '\0': return LEPT_PARSE_EXPECT_VALUE;
 	}
@@ -450,6 +679,17 @@ static int lept_parse_value(lept_context* c, lept_value* v) {
  * 实现 API 函数 
  */
 int lept_parse (lept_value* v, const char* json) {
+	return lept_parse_ex(v, json, LEPT_PARSE_DEFAULT_FLAGS);
+}
+
+int lept_parse_ex (lept_value* v, const char* json, unsigned flags) {
+	return lept_parse_projected(v, json, NULL, flags);
+}
+
+/**
+ * lept_parse_projected 和 lept_parse_limited 的共同实现，proj 和 limits 都可以为 NULL。
+ */
+static int lept_parse_with (lept_value* v, const char* json, const lept_projection* proj, unsigned flags, const lept_parse_limits* limits) {
 	assert(v != NULL);
 
 	int ret;
@@ -459,15 +699,21 @@ int lept_parse (lept_value* v, const char* json) {
 	c.json = json;
 	c.stack = NULL;
 	c.size = c.top = 0;
+	c.flags = flags;
+	c.end = proj != NULL ? json + strlen(json) : NULL;
+	lept_context_set_limits(&c, limits);
 
 	lept_init(v);
 	lept_parse_whitespace(&c);
 
-	if ((ret = lept_parse_value(&c, v)) == LEPT_PARSE_OK) {
+	if ((ret = lept_parse_value(&c, v, proj)) == LEPT_PARSE_SKIPPED) {
+		ret = LEPT_PARSE_OK;
+	}
+	if (ret == LEPT_PARSE_OK) {
 		lept_parse_whitespace(&c);
 		if (*c.json != '\0') {
-			v->type = LEPT_NULL;
-			return LEPT_PARSE_ROOT_NOT_SINGULAR;
+			lept_free(v);
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
 		}
 	}
 	
@@ -478,6 +724,119 @@ int lept_parse (lept_value* v, const char* json) {
 	return ret; 
 }
 
+/**
+ * proj 为 NULL 时就是 lept_parse_ex。
+ */
+int lept_parse_projected (lept_value* v, const char* json, const lept_projection* proj, unsigned flags) {
+	return lept_parse_with(v, json, proj, flags, NULL);
+}
+
+int lept_parse_limited (lept_value* v, const char* json, unsigned flags, const lept_parse_limits* limits) {
+	assert(v != NULL && json != NULL);
+	/* 最多看 max_input + 1 个字节，超长的输入不用完整走一遍 */
+	if (limits != NULL && limits->max_input != 0 && strnlen(json, limits->max_input + 1) > limits->max_input) {
+		lept_init(v);
+		return LEPT_PARSE_INPUT_TOO_LARGE;
+	}
+	return lept_parse_with(v, json, NULL, flags, limits);
+}
+
+/**
+ * 0 表示不限制，换成 SIZE_MAX，解析时只需要比较。
+ */
+void lept_context_set_limits(lept_context* c, const lept_parse_limits* limits) {
+	assert(c != NULL);
+	c->max_nodes = limits != NULL && limits->max_nodes != 0 ? limits->max_nodes : SIZE_MAX;
+	c->max_string = limits != NULL && limits->max_string != 0 ? limits->max_string : SIZE_MAX;
+	c->max_container = limits != NULL && limits->max_container != 0 ? limits->max_container : SIZE_MAX;
+	c->max_bytes = limits != NULL && limits->max_bytes != 0 ? limits->max_bytes : SIZE_MAX;
+	c->nodes = c->bytes = c->moved = 0;
+}
+
+int lept_context_parse(lept_context* c, lept_value* v) {
+	assert(c != NULL && v != NULL);
+	lept_init(v);
+	lept_parse_whitespace(c);
+	return lept_parse_value(c, v, NULL);
+}
+
+static lept_projection* lept_projection_new(const char* key, size_t klen) {
+	lept_projection* node = (lept_projection*)calloc(1, sizeof(lept_projection));
+	if (key != NULL) {
+		node->key = (char*)malloc(klen + 1);
+		memcpy(node->key, key, klen);
+		node->key[klen] = '\0';
+		node->klen = klen;
+	}
+	return node;
+}
+
+/**
+ * 把一条路径加进字段树，语法错误时返回 0。
+ */
+static int lept_projection_add(lept_projection* node, const char* p) {
+	const char* q;
+	lept_projection* child;
+
+	while (*p != '\0') {
+		if (*p == '[') {
+			if (p[1] != '*' || p[2] != ']') {
+				return 0;
+			}
+			if (node->elements == NULL) {
+				node->elements = lept_projection_new(NULL, 0);
+			}
+			node = node->elements;
+			p += 3;
+		} else {
+			for (q = p; *q != '\0' && *q != '.' && *q != '['; q++) {
+			}
+			if (q == p) {
+				return 0;
+			}
+			if ((child = (lept_projection*)lept_projection_find(node, p, q - p)) == NULL) {
+				child = lept_projection_new(p, q - p);
+				child->next = node->members;
+				node->members = child;
+			}
+			node = child;
+			p = q;
+		}
+		if (*p == '.' && (*++p == '\0' || *p == '.' || *p == '[')) {
+			return 0;
+		}
+	}
+	node->selected = 1;
+	return 1;
+}
+
+lept_projection* lept_projection_compile(const char* const* paths, size_t count) {
+	lept_projection* root = lept_projection_new(NULL, 0);
+	size_t i;
+
+	assert(paths != NULL || count == 0);
+	for (i = 0; i < count; i++) {
+		if (!lept_projection_add(root, paths[i])) {
+			lept_projection_free(root);
+			return NULL;
+		}
+	}
+	return root;
+}
+
+void lept_projection_free(lept_projection* proj) {
+	lept_projection* next;
+
+	while (proj != NULL) {
+		lept_projection_free(proj->members);
+		lept_projection_free(proj->elements);
+		next = proj->next;
+		free(proj->key);
+		free(proj);
+		proj = next;
+	}
+}
+
 lept_type lept_get_type(const lept_value* v) {
 	assert(v != NULL);
 	return v->type;
@@ -491,42 +850,160 @@ void lept_set_number(lept_value* v, double d) {
 	v->u.n = d;
 }
 
+const char* lept_get_number_text(const lept_value* v, size_t* len) {
+	assert(v != NULL && v->type == LEPT_NUMBER);
+	const char* text;
+
+	if (!(v->flags & LEPT_VALUE_RAW_NUMBER)) {
+		return NULL;
+	}
+	text = v->flags & LEPT_VALUE_RAW_HEAP ? v->u.r.text.h.s : v->u.r.text.t;
+	if (len) {
+		*len = v->flags & LEPT_VALUE_RAW_HEAP ? v->u.r.text.h.len : strlen(text);
+	}
+	return text;
+}
+
+/**
+ * 保留原文的数字的值，第一次读取时转换并写回 u.r.n。
+ * 缓存只有 u.r.n 这 8 个字节，用原子操作读写，几个线程同时第一次读取同一个值也没有数据竞争，
+ * 它们算出的结果相同。
+ */
+static double lept_raw_number(const lept_value* v) {
+	uint64_t bits;
+	double d;
+
+	__atomic_load(&v->u.r.n, &d, __ATOMIC_RELAXED);
+	memcpy(&bits, &d, sizeof(d));
+	if (bits != LEPT_RAW_PENDING) {
+		return d;
+	}
+	d = strtod(lept_get_number_text(v, NULL), NULL);
+	__atomic_store(&((lept_value*)v)->u.r.n, &d, __ATOMIC_RELAXED);
+	return d;
+}
+
+/**
+ * 数字节点的值，两种存储都可以。
+ */
+static double lept_number_of(const lept_value* v) {
+	return v->flags & LEPT_VALUE_RAW_NUMBER ? lept_raw_number(v) : v->u.n;
+}
+
 double lept_get_number(const lept_value *v) {
 	assert(v != NULL && v->type == LEPT_NUMBER);
-	return v->u.n;
+	return lept_number_of(v);
 }
 
 /**
- * 释放元素所分配的内存。
- * 这些内存都是 lept_context 栈压入的。
+ * 释放节点自己的内存，容器的子节点必须已经释放。
+ * @return 			释放的字节数，按分配时请求的大小计算。
  */
-void lept_free (lept_value *v) {
-	assert(v != NULL);
-	size_t i;
+static size_t lept_free_node (lept_value* v) {
+	size_t bytes = 0;
 
 	switch (v->type) {
-		case LEPT_STRING: 
+		case LEPT_NUMBER:
+			if (v->flags & LEPT_VALUE_RAW_HEAP) {
+				bytes = v->u.r.text.h.len + 1;
+				free(v->u.r.text.h.s);
+			}
+			break;
+		case LEPT_STRING:
+			bytes = v->u.s.len + 1;
 			free(v->u.s.s);
 			break;
-		
 		case LEPT_ARRAY:
-			for (i = 0; i < v->u.a.size; ++i) {
-				lept_free(&v->u.a.e[i]);
-			}	
-			free(v->u.a.e);
-			break;
-		case LEPT_OBJECT: 
-			for (i = 0; i < v->u.o.size; ++i) {
-				lept_member *m = &v->u.o.m[i];
-				free(m->k);
-				lept_free(&m->v);
+			if (v->flags & LEPT_VALUE_PACKED) {
+				bytes = v->u.p.capacity * sizeof(double);
+				free(v->u.p.n);
+			} else {
+				bytes = v->u.a.capacity * sizeof(lept_value);
+				free(v->u.a.e);
 			}
+			break;
+		case LEPT_OBJECT:
+			bytes = v->u.o.capacity * sizeof(lept_member);
 			free(v->u.o.m);
 			break;
 		default: break;
 	}
-	
 	v->type = LEPT_NULL;
+	v->flags = 0;
+	return bytes;
+}
+
+/**
+ * 是否还有需要逐个释放的子节点，紧凑数组的元素是数字，不需要。
+ */
+static int lept_has_children (const lept_value* v) {
+	return (v->type == LEPT_ARRAY && !(v->flags & LEPT_VALUE_PACKED) && v->u.a.size > 0)
+		|| (v->type == LEPT_OBJECT && v->u.o.size > 0);
+}
+
+typedef struct {
+	lept_value* v;
+	size_t i;			// 下一个要释放的子节点
+} lept_free_frame;
+
+/**
+ * 深度优先地释放整棵树，栈里只放还有子节点没释放完的祖先，不会因为嵌套太深而栈溢出。
+ * 标量和空容器不用压栈，只有一层的容器不分配额外的内存。
+ */
+size_t lept_free_counted(struct lept_value* v) {
+	assert(v != NULL);
+	lept_context c;
+	lept_free_frame* f;
+	lept_value* child;
+	size_t i = 0, bytes = 0;
+
+	c.stack = NULL;
+	c.size = c.top = 0;
+	for (;;) {
+		child = NULL;
+		if (v->type == LEPT_ARRAY && !(v->flags & LEPT_VALUE_PACKED)) {
+			while (child == NULL && i < v->u.a.size) {
+				lept_value* e = &v->u.a.e[i++];
+				if (lept_has_children(e)) {
+					child = e;
+				} else {
+					bytes += lept_free_node(e);
+				}
+			}
+		} else if (v->type == LEPT_OBJECT) {
+			while (child == NULL && i < v->u.o.size) {
+				lept_member* m = &v->u.o.m[i++];
+				bytes += m->klen + 1;
+				free(m->k);
+				if (lept_has_children(&m->v)) {
+					child = &m->v;
+				} else {
+					bytes += lept_free_node(&m->v);
+				}
+			}
+		}
+		if (child != NULL) {
+			f = (lept_free_frame*)lept_context_push(&c, sizeof(lept_free_frame));
+			f->v = v;
+			f->i = i;
+			v = child;
+			i = 0;
+			continue;
+		}
+		bytes += lept_free_node(v);
+		if (c.top == 0) {
+			break;
+		}
+		f = (lept_free_frame*)lept_context_pop(&c, sizeof(lept_free_frame));
+		v = f->v;
+		i = f->i;
+	}
+	free(c.stack);
+	return bytes;
+}
+
+void lept_free (lept_value *v) {
+	lept_free_counted(v);
 }
 
 void lept_set_string (lept_value *v, const char *s, size_t len) {
@@ -578,19 +1055,110 @@ lept_type lept_get_null(const lept_value* v) {
  */
 size_t lept_get_array_size(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_ARRAY);
-	return v->u.a.size;
+	return (v->flags & LEPT_VALUE_PACKED) ? v->u.p.size : v->u.a.size;
 }
 
 /**
  * 获取 JSON 数组中的某个元素.
  */
 lept_value* lept_get_array_element(const lept_value* v, size_t index) {
-	assert(v != NULL && v->type == LEPT_ARRAY);
+	assert(v != NULL && v->type == LEPT_ARRAY && !(v->flags & LEPT_VALUE_PACKED));
 	assert(index < v->u.a.size);
 
 	return &(v->u.a.e[index]);
 }
 
+/**
+ * 紧凑数组没有 lept_value 可以返回，所以会先转换回普通存储。
+ */
+lept_value* lept_get_array_element_mutable(lept_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->flags & LEPT_VALUE_PACKED) {
+		lept_unpack_array(v);
+	}
+	return lept_get_array_element(v, index);
+}
+
+int lept_is_array_packed(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	return (v->flags & LEPT_VALUE_PACKED) != 0;
+}
+
+double* lept_get_array_numbers(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	return (v->flags & LEPT_VALUE_PACKED) ? v->u.p.n : NULL;
+}
+
+/**
+ * 读取数字元素，不会触发紧凑数组的转换。
+ */
+double lept_get_array_number(const lept_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->flags & LEPT_VALUE_PACKED) {
+		assert(index < v->u.p.size);
+		return v->u.p.n[index];
+	}
+	assert(index < v->u.a.size);
+	return lept_get_number(&v->u.a.e[index]);
+}
+
+/**
+ * 把元素全部是数字的数组转换成紧凑存储。
+ * @return 转换后（或本来就）是紧凑存储时返回 1，否则返回 0。
+ */
+int lept_pack_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	size_t i, size = v->u.a.size;
+	double* n;
+
+	if (v->flags & LEPT_VALUE_PACKED) {
+		return 1;
+	}
+	for (i = 0; i < size; ++i) {
+		if (v->u.a.e[i].type != LEPT_NUMBER) {
+			return 0;
+		}
+	}
+	n = size > 0 ? (double*)malloc(size * sizeof(double)) : NULL;
+	for (i = 0; i < size; ++i) {
+		n[i] = lept_number_of(&v->u.a.e[i]);
+		lept_free_node(&v->u.a.e[i]);
+	}
+	free(v->u.a.e);
+	v->u.p.n = n;
+	v->u.p.size = v->u.p.capacity = size;
+	v->flags |= LEPT_VALUE_PACKED;
+	return 1;
+}
+
+/**
+ * 紧凑数组转换回 lept_value 数组，容量保持不变。
+ */
+void lept_unpack_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	size_t i, size, capacity;
+	double* n;
+	lept_value* e;
+
+	if (!(v->flags & LEPT_VALUE_PACKED)) {
+		return;
+	}
+	n = v->u.p.n;
+	size = v->u.p.size;
+	capacity = v->u.p.capacity;
+	e = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
+	for (i = 0; i < size; ++i) {
+		lept_init(&e[i]);
+		e[i].type = LEPT_NUMBER;
+		e[i].u.n = n[i];
+	}
+	free(n);
+	v->flags &= ~LEPT_VALUE_PACKED;
+	v->u.a.e = e;
+	v->u.a.size = size;
+	v->u.a.capacity = capacity;
+}
+
 // Object 工具函数
 size_t lept_get_object_size(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
@@ -619,3 +1187,560 @@ lept_value* lept_get_object_value(const lept_value* v, size_t index) {
 	return &m->v;
 }
 
+
+
+/**
+ * 深拷贝 src 到 dst，dst 原有的内容会先被释放。
+ */
+void lept_copy(lept_value* dst, const lept_value* src) {
+	assert(src != NULL && dst != NULL && src != dst);
+	size_t i;
+
+	switch (src->type) {
+		case LEPT_NUMBER:
+			lept_free(dst);
+			dst->type = LEPT_NUMBER;
+			dst->flags = src->flags;
+			if (!(src->flags & LEPT_VALUE_RAW_NUMBER)) {
+				dst->u.n = src->u.n;
+				break;
+			}
+			/* 缓存可能正在被别的线程写入，原子地读 */
+			__atomic_load(&src->u.r.n, &dst->u.r.n, __ATOMIC_RELAXED);
+			dst->u.r.text = src->u.r.text;
+			if (src->flags & LEPT_VALUE_RAW_HEAP) {
+				size_t len = src->u.r.text.h.len;
+				dst->u.r.text.h.s = (char*)malloc(len + 1);
+				memcpy(dst->u.r.text.h.s, src->u.r.text.h.s, len + 1);
+			}
+			break;
+		case LEPT_STRING:
+			lept_set_string(dst, src->u.s.s, src->u.s.len);
+			break;
+		case LEPT_ARRAY:
+			if (src->flags & LEPT_VALUE_PACKED) {
+				lept_free(dst);
+				dst->type = LEPT_ARRAY;
+				dst->flags = LEPT_VALUE_PACKED;
+				dst->u.p.size = dst->u.p.capacity = src->u.p.size;
+				dst->u.p.n = src->u.p.size > 0 ? (double*)malloc(src->u.p.size * sizeof(double)) : NULL;
+				memcpy(dst->u.p.n, src->u.p.n, src->u.p.size * sizeof(double));
+				break;
+			}
+			lept_set_array(dst, src->u.a.size);
+			for (i = 0; i < src->u.a.size; ++i) {
+				lept_init(&dst->u.a.e[i]);
+				lept_copy(&dst->u.a.e[i], &src->u.a.e[i]);
+			}
+			dst->u.a.size = src->u.a.size;
+			break;
+		case LEPT_OBJECT:
+			/* 直接追加成员，不查找键：重复的键原样保留，也不用逐个比较 */
+			lept_set_object(dst, src->u.o.size);
+			for (i = 0; i < src->u.o.size; ++i) {
+				const lept_member* from = &src->u.o.m[i];
+				lept_member* m = &dst->u.o.m[i];
+				m->k = (char*)malloc(from->klen + 1);
+				memcpy(m->k, from->k, from->klen);
+				m->k[from->klen] = '\0';
+				m->klen = from->klen;
+				lept_init(&m->v);
+				lept_copy(&m->v, &from->v);
+			}
+			dst->u.o.size = src->u.o.size;
+			break;
+		default:
+			lept_free(dst);
+			memcpy(dst, src, sizeof(lept_value));
+			break;
+	}
+}
+
+void lept_move(lept_value* dst, lept_value* src) {
+	assert(dst != NULL && src != NULL && src != dst);
+	lept_free(dst);
+	memcpy(dst, src, sizeof(lept_value));
+	lept_init(src);
+}
+
+void lept_swap(lept_value* lhs, lept_value* rhs) {
+	assert(lhs != NULL && rhs != NULL);
+	if (lhs != rhs) {
+		lept_value temp;
+		memcpy(&temp, lhs, sizeof(lept_value));
+		memcpy(lhs, rhs, sizeof(lept_value));
+		memcpy(rhs, &temp, sizeof(lept_value));
+	}
+}
+
+/**
+ * lept_is_equal 和 lept_hash 用 lept_context 作为显式栈，不递归，嵌套再深也不会栈溢出。
+ */
+typedef struct {
+	const lept_value* a;
+	const lept_value* b;	// lept_hash 不使用
+	size_t i;				// 下一个要处理的子节点
+	uint64_t h;				// lept_hash 累积的哈希
+	size_t marks;			// lept_is_equal 比较对象时 b 的配对标记在标记栈中的位置
+} lept_walk_frame;
+
+#define LEPT_WALK_IN_ORDER ((size_t)-1)	// 目前为止成员顺序相同，还没有配对标记
+
+#define WALK_TOP(c) ((lept_walk_frame*)((c)->stack + (c)->top) - 1)
+
+static void lept_walk_push(lept_context* c, const lept_value* a, const lept_value* b, uint64_t h) {
+	lept_walk_frame* f = (lept_walk_frame*)lept_context_push(c, sizeof(lept_walk_frame));
+	f->a = a;
+	f->b = b;
+	f->i = 0;
+	f->h = h;
+	f->marks = LEPT_WALK_IN_ORDER;
+}
+
+/**
+ * 数组第 i 个元素的数字值，两种存储方式都可以；不是数字时返回 0。
+ */
+static int lept_array_number_at(const lept_value* a, size_t i, double* n) {
+	if (a->flags & LEPT_VALUE_PACKED) {
+		*n = a->u.p.n[i];
+		return 1;
+	}
+	if (a->u.a.e[i].type != LEPT_NUMBER) {
+		return 0;
+	}
+	*n = lept_number_of(&a->u.a.e[i]);
+	return 1;
+}
+
+/**
+ * 比较两个节点本身。容器的大小相同时压栈，由调用方继续比较子节点。
+ */
+static int lept_equal_node(lept_context* c, const lept_value* a, const lept_value* b) {
+	size_t i;
+	double x, y;
+
+	if (a->type != b->type) {
+		return 0;
+	}
+	switch (a->type) {
+		case LEPT_NUMBER:
+			return lept_number_of(a) == lept_number_of(b);
+		case LEPT_STRING:
+			return a->u.s.len == b->u.s.len && memcmp(a->u.s.s, b->u.s.s, a->u.s.len) == 0;
+		case LEPT_ARRAY:
+			if (lept_get_array_size(a) != lept_get_array_size(b)) {
+				return 0;
+			}
+			if ((a->flags | b->flags) & LEPT_VALUE_PACKED) {
+				/* 至少一边是紧凑数组，另一边的元素也必须都是数字 */
+				for (i = 0; i < lept_get_array_size(a); ++i) {
+					if (!lept_array_number_at(a, i, &x) || !lept_array_number_at(b, i, &y) || x != y) {
+						return 0;
+					}
+				}
+				return 1;
+			}
+			lept_walk_push(c, a, b, 0);
+			return 1;
+		case LEPT_OBJECT:
+			if (a->u.o.size != b->u.o.size) {
+				return 0;
+			}
+			lept_walk_push(c, a, b, 0);
+			return 1;
+		default:
+			return 1;
+	}
+}
+
+/**
+ * 对象 b 中第一个还没有配对、键为 key 的成员，没有时返回 LEPT_KEY_NOT_EXIST。
+ * 每个成员最多配对一次，所以重复的键按出现顺序一一对应。
+ */
+static size_t lept_equal_match(const lept_value* b, const char* matched, const char* key, size_t klen) {
+	size_t i;
+	for (i = 0; i < b->u.o.size; ++i) {
+		if (!matched[i] && b->u.o.m[i].klen == klen && memcmp(b->u.o.m[i].k, key, klen) == 0) {
+			return i;
+		}
+	}
+	return LEPT_KEY_NOT_EXIST;
+}
+
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
+	assert(lhs != NULL && rhs != NULL);
+	lept_context c, marks;
+	lept_walk_frame* f;
+	const lept_member* m;
+	const lept_value* a;
+	const lept_value* b;
+	size_t index;
+	char* matched;
+	int equal;
+
+	c.stack = marks.stack = NULL;
+	c.size = c.top = marks.size = marks.top = 0;
+	equal = lept_equal_node(&c, lhs, rhs);
+	while (equal && c.top > 0) {
+		f = WALK_TOP(&c);
+		if (f->a->type == LEPT_ARRAY) {
+			if (f->i == f->a->u.a.size) {
+				c.top -= sizeof(lept_walk_frame);
+				continue;
+			}
+			a = &f->a->u.a.e[f->i];
+			b = &f->b->u.a.e[f->i];
+		} else {
+			if (f->i == f->a->u.o.size) {
+				if (f->marks != LEPT_WALK_IN_ORDER) {
+					marks.top = f->marks;
+				}
+				c.top -= sizeof(lept_walk_frame);
+				continue;
+			}
+			m = &f->a->u.o.m[f->i];
+			index = f->i;
+			if (f->marks == LEPT_WALK_IN_ORDER
+					&& (m->klen != f->b->u.o.m[index].klen || memcmp(m->k, f->b->u.o.m[index].k, m->klen) != 0)) {
+				/* 成员顺序第一次不同，之前的成员都是按位置配对的 */
+				f->marks = marks.top;
+				matched = (char*)lept_context_push(&marks, f->b->u.o.size);
+				memset(matched, 1, f->i);
+				memset(matched + f->i, 0, f->b->u.o.size - f->i);
+			}
+			if (f->marks != LEPT_WALK_IN_ORDER) {
+				matched = marks.stack + f->marks;
+				if ((index = lept_equal_match(f->b, matched, m->k, m->klen)) == LEPT_KEY_NOT_EXIST) {
+					equal = 0;
+					break;
+				}
+				matched[index] = 1;
+			}
+			a = &m->v;
+			b = &f->b->u.o.m[index].v;
+		}
+		f->i++;
+		equal = lept_equal_node(&c, a, b);
+	}
+	free(c.stack);
+	free(marks.stack);
+	return equal;
+}
+
+#define LEPT_HASH_SEED_NULL		0x6e756c6cULL
+#define LEPT_HASH_SEED_FALSE	0x66616c73ULL
+#define LEPT_HASH_SEED_TRUE		0x74727565ULL
+#define LEPT_HASH_SEED_NUMBER	0x6e756d62ULL
+#define LEPT_HASH_SEED_STRING	0x73747269ULL
+#define LEPT_HASH_SEED_ARRAY	0x61727261ULL
+#define LEPT_HASH_SEED_OBJECT	0x6f626a65ULL
+#define LEPT_HASH_SEED_KEY		0x6b657973ULL
+
+static uint64_t lept_hash_number(double n) {
+	uint64_t bits;
+	if (n == 0) {
+		n = 0;	/* -0 == 0，哈希也要相同 */
+	}
+	memcpy(&bits, &n, sizeof(bits));
+	return lept_hash_finish(lept_hash_combine(LEPT_HASH_SEED_NUMBER, bits));
+}
+
+/**
+ * 标量直接返回哈希；容器压栈，返回 0，子节点处理完之后由 lept_hash 算出哈希。
+ */
+static int lept_hash_node(lept_context* c, const lept_value* v, uint64_t* h) {
+	size_t i;
+
+	switch (v->type) {
+		case LEPT_NULL:		*h = lept_hash_finish(LEPT_HASH_SEED_NULL); return 1;
+		case LEPT_FALSE:	*h = lept_hash_finish(LEPT_HASH_SEED_FALSE); return 1;
+		case LEPT_TRUE:		*h = lept_hash_finish(LEPT_HASH_SEED_TRUE); return 1;
+		case LEPT_NUMBER:	*h = lept_hash_number(lept_number_of(v)); return 1;
+		case LEPT_STRING:
+			*h = lept_hash_bytes(v->u.s.s, v->u.s.len, LEPT_HASH_SEED_STRING);
+			return 1;
+		case LEPT_ARRAY:
+			if (v->flags & LEPT_VALUE_PACKED) {
+				/* 和同样内容的普通数组哈希相同 */
+				*h = LEPT_HASH_SEED_ARRAY;
+				for (i = 0; i < v->u.p.size; ++i) {
+					*h = lept_hash_combine(*h, lept_hash_number(v->u.p.n[i]));
+				}
+				*h = lept_hash_finish(*h ^ v->u.p.size);
+				return 1;
+			}
+			lept_walk_push(c, v, NULL, LEPT_HASH_SEED_ARRAY);
+			return 0;
+		default:
+			/* 对象的成员哈希相加，与顺序无关；重复的键各算一次，和 lept_is_equal 的配对一致 */
+			lept_walk_push(c, v, NULL, 0);
+			return 0;
+	}
+}
+
+uint64_t lept_hash(const lept_value* v) {
+	assert(v != NULL);
+	lept_context c;
+	lept_walk_frame* f;
+	const lept_value* child;
+	uint64_t h;
+
+	c.stack = NULL;
+	c.size = c.top = 0;
+	if (lept_hash_node(&c, v, &h)) {
+		return h;
+	}
+	for (;;) {
+		f = WALK_TOP(&c);
+		if (f->i == (f->a->type == LEPT_ARRAY ? f->a->u.a.size : f->a->u.o.size)) {
+			/* 容器处理完，把哈希交给上一层 */
+			h = f->a->type == LEPT_ARRAY
+				? lept_hash_finish(f->h ^ f->a->u.a.size)
+				: lept_hash_finish(lept_hash_combine(LEPT_HASH_SEED_OBJECT, f->h) ^ f->a->u.o.size);
+			c.top -= sizeof(lept_walk_frame);
+			if (c.top == 0) {
+				break;
+			}
+		} else {
+			child = f->a->type == LEPT_ARRAY ? &f->a->u.a.e[f->i] : &f->a->u.o.m[f->i].v;
+			f->i++;
+			if (!lept_hash_node(&c, child, &h)) {
+				continue;
+			}
+		}
+		/* h 是栈顶容器第 i - 1 个子节点的哈希 */
+		f = WALK_TOP(&c);
+		if (f->a->type == LEPT_ARRAY) {
+			f->h = lept_hash_combine(f->h, h);
+		} else {
+			const lept_member* m = &f->a->u.o.m[f->i - 1];
+			f->h += lept_hash_finish(lept_hash_combine(lept_hash_bytes(m->k, m->klen, LEPT_HASH_SEED_KEY), h));
+		}
+	}
+	free(c.stack);
+	return h;
+}
+
+/**
+ * 数组 API
+ */
+void lept_set_array(lept_value* v, size_t capacity) {
+	assert(v != NULL);
+	lept_free(v);
+
+	v->type = LEPT_ARRAY;
+	v->u.a.size = 0;
+	v->u.a.capacity = capacity;
+	v->u.a.e = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
+}
+
+size_t lept_get_array_capacity(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	return (v->flags & LEPT_VALUE_PACKED) ? v->u.p.capacity : v->u.a.capacity;
+}
+
+void lept_reserve_array(lept_value* v, size_t capacity) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->flags & LEPT_VALUE_PACKED) {
+		if (v->u.p.capacity < capacity) {
+			v->u.p.capacity = capacity;
+			v->u.p.n = (double*)realloc(v->u.p.n, capacity * sizeof(double));
+		}
+		return;
+	}
+	if (v->u.a.capacity < capacity) {
+		v->u.a.capacity = capacity;
+		v->u.a.e = (lept_value*)realloc(v->u.a.e, capacity * sizeof(lept_value));
+	}
+}
+
+void lept_shrink_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->flags & LEPT_VALUE_PACKED) {
+		if (v->u.p.capacity > v->u.p.size) {
+			v->u.p.capacity = v->u.p.size;
+			if (v->u.p.size == 0) {
+				free(v->u.p.n);
+				v->u.p.n = NULL;
+			} else {
+				v->u.p.n = (double*)realloc(v->u.p.n, v->u.p.size * sizeof(double));
+			}
+		}
+		return;
+	}
+	if (v->u.a.capacity > v->u.a.size) {
+		v->u.a.capacity = v->u.a.size;
+		if (v->u.a.size == 0) {
+			free(v->u.a.e);
+			v->u.a.e = NULL;
+		} else {
+			v->u.a.e = (lept_value*)realloc(v->u.a.e, v->u.a.size * sizeof(lept_value));
+		}
+	}
+}
+
+void lept_clear_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	lept_erase_array_element(v, 0, lept_get_array_size(v));
+}
+
+/**
+ * 在数组末尾追加一个元素。容量不够时按 2 倍扩容，保证均摊 O(1)。
+ */
+lept_value* lept_pushback_array_element(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	lept_unpack_array(v);
+	if (v->u.a.size == v->u.a.capacity) {
+		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+	}
+	lept_init(&v->u.a.e[v->u.a.size]);
+	return &v->u.a.e[v->u.a.size++];
+}
+
+void lept_popback_array_element(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY && lept_get_array_size(v) > 0);
+	if (v->flags & LEPT_VALUE_PACKED) {
+		v->u.p.size--;
+		return;
+	}
+	lept_free(&v->u.a.e[--v->u.a.size]);
+}
+
+/**
+ * 在 index 处插入一个元素，index 等于 size 时相当于 pushback。
+ */
+lept_value* lept_insert_array_element(lept_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	lept_unpack_array(v);
+	assert(index <= v->u.a.size);
+	if (v->u.a.size == v->u.a.capacity) {
+		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+	}
+	memmove(&v->u.a.e[index + 1], &v->u.a.e[index], (v->u.a.size - index) * sizeof(lept_value));
+	v->u.a.size++;
+	lept_init(&v->u.a.e[index]);
+	return &v->u.a.e[index];
+}
+
+/**
+ * 删除从 index 开始的 count 个元素，后面的元素向前移动。
+ */
+void lept_erase_array_element(lept_value* v, size_t index, size_t count) {
+	assert(v != NULL && v->type == LEPT_ARRAY && index + count <= lept_get_array_size(v));
+	size_t i;
+
+	if (v->flags & LEPT_VALUE_PACKED) {
+		memmove(&v->u.p.n[index], &v->u.p.n[index + count], (v->u.p.size - index - count) * sizeof(double));
+		v->u.p.size -= count;
+		return;
+	}
+
+	for (i = index; i < index + count; ++i) {
+		lept_free(&v->u.a.e[i]);
+	}
+	memmove(&v->u.a.e[index], &v->u.a.e[index + count], (v->u.a.size - index - count) * sizeof(lept_value));
+	v->u.a.size -= count;
+}
+
+/**
+ * 对象 API
+ */
+void lept_set_object(lept_value* v, size_t capacity) {
+	assert(v != NULL);
+	lept_free(v);
+
+	v->type = LEPT_OBJECT;
+	v->u.o.size = 0;
+	v->u.o.capacity = capacity;
+	v->u.o.m = capacity > 0 ? (lept_member*)malloc(capacity * sizeof(lept_member)) : NULL;
+}
+
+size_t lept_get_object_capacity(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	return v->u.o.capacity;
+}
+
+void lept_reserve_object(lept_value* v, size_t capacity) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	if (v->u.o.capacity < capacity) {
+		v->u.o.capacity = capacity;
+		v->u.o.m = (lept_member*)realloc(v->u.o.m, capacity * sizeof(lept_member));
+	}
+}
+
+void lept_shrink_object(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	if (v->u.o.capacity > v->u.o.size) {
+		v->u.o.capacity = v->u.o.size;
+		if (v->u.o.size == 0) {
+			free(v->u.o.m);
+			v->u.o.m = NULL;
+		} else {
+			v->u.o.m = (lept_member*)realloc(v->u.o.m, v->u.o.size * sizeof(lept_member));
+		}
+	}
+}
+
+void lept_clear_object(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	size_t i;
+
+	for (i = 0; i < v->u.o.size; ++i) {
+		free(v->u.o.m[i].k);
+		lept_free(&v->u.o.m[i].v);
+	}
+	v->u.o.size = 0;
+}
+
+/**
+ * 线性查找键，找不到时返回 LEPT_KEY_NOT_EXIST。
+ */
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
+	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	size_t i;
+
+	for (i = 0; i < v->u.o.size; ++i) {
+		if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0) {
+			return i;
+		}
+	}
+	return LEPT_KEY_NOT_EXIST;
+}
+
+lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen) {
+	size_t index = lept_find_object_index(v, key, klen);
+	return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
+
+/**
+ * 键已存在时返回原有的值，否则追加一个新成员（值为 null）。
+ * 容量不够时按 2 倍扩容。
+ */
+lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
+	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	lept_member* m;
+	lept_value* found;
+
+	if ((found = lept_find_object_value(v, key, klen)) != NULL) {
+		return found;
+	}
+	if (v->u.o.size == v->u.o.capacity) {
+		lept_reserve_object(v, v->u.o.capacity == 0 ? 1 : v->u.o.capacity * 2);
+	}
+	m = &v->u.o.m[v->u.o.size++];
+	m->k = (char*)malloc(klen + 1);
+	memcpy(m->k, key, klen);
+	m->k[klen] = '\0';
+	m->klen = klen;
+	lept_init(&m->v);
+	return &m->v;
+}
+
+void lept_remove_object_value(lept_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_OBJECT && index < v->u.o.size);
+
+	free(v->u.o.m[index].k);
+	lept_free(&v->u.o.m[index].v);
+	memmove(&v->u.o.m[index], &v->u.o.m[index + 1], (v->u.o.size - index - 1) * sizeof(lept_member));
+	v->u.o.size--;
+}
@@ -5,6 +5,11 @@
 #define LEPTJSON_H__
 
 #include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
  * JSON 数据类型。其中 true, false 分别当作一种类型。
@@ -36,20 +41,47 @@ struct lept_value {
 			size_t len;
 		} s;
 
+		struct {
+			double n;			// 转换之后的值，和 u.n 在同一位置；还没转换时是一个特定的 NaN
+			union {
+				char t[16];		// 不超过 15 字节的原文，以 '\0' 结尾
+				struct {
+					char* s;	// 更长的原文，单独分配，以 '\0' 结尾（LEPT_VALUE_RAW_HEAP）
+					size_t len;
+				} h;
+			} text;
+		} r;			// 保留原文的数字（LEPT_VALUE_RAW_NUMBER），第一次读取时转换
+
 		struct {
 			lept_value* e;
 			size_t size;
+			size_t capacity;	// 已分配的元素个数，size <= capacity
 		} a;
 
+		struct {
+			double* n;
+			size_t size;
+			size_t capacity;
+		} p;			// 紧凑数组（LEPT_VALUE_PACKED），元素全部是数字，连续存放
+
 		struct {
 			lept_member* m;
 			size_t size;
+			size_t capacity;
 		} o;
 	} u;
 
 	lept_type type;
+	unsigned flags;		// 内部表示标记，见 LEPT_VALUE_*
 };
 
+/**
+ * lept_value.flags 的取值。只影响内部存储方式，不影响 lept_get_type。
+ */
+#define LEPT_VALUE_PACKED 0x1	// LEPT_ARRAY 以 u.p 的 double 块存储
+#define LEPT_VALUE_RAW_NUMBER 0x2	// LEPT_NUMBER 以 u.r 保存原文
+#define LEPT_VALUE_RAW_HEAP 0x4	// u.r 的原文在 u.r.text.h
+
 struct lept_member {
 	char* k;			// member key string.
 	size_t klen; 	// member key string length. 我们也需要保存字符串的长度，因为字符串本身可能包含空字符 \u0000 
@@ -75,12 +107,38 @@ typedef enum {
 	LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
 	LEPT_PARSE_MISS_KEY,
 	LEPT_PARSE_MISS_COLON,
-	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+	LEPT_PARSE_INVALID_MSGPACK,		// MessagePack 数据格式错误或不支持的类型。
+	LEPT_PARSE_DEPTH_EXCEEDED,		// 嵌套超过 LEPT_SCAN_MAX_DEPTH。
+	LEPT_PARSE_INVALID_UTF8,		// 字符串中有非法的 UTF-8 序列，见 LEPT_PARSE_VALIDATE_UTF8。
+	LEPT_PARSE_TYPE_MISMATCH,		// 值的类型和绑定的 C++ 字段不符，见 leptbind.hpp。
+	LEPT_PARSE_MISS_REQUIRED_FIELD,	// 对象缺少必需的字段，见 leptbind.hpp。
+	LEPT_PARSE_INPUT_TOO_LARGE,		// 以下是超过 lept_parse_limits 中对应上限时的错误。
+	LEPT_PARSE_TOO_MANY_NODES,
+	LEPT_PARSE_STRING_TOO_LONG,
+	LEPT_PARSE_CONTAINER_TOO_LARGE,
+	LEPT_PARSE_TOO_MANY_BYTES
 } lept_error_type;
 
-#define lept_init(v) do { (v)->type = LEPT_NULL; } while(0)
+/**
+ * lept_parse_ex 的解析选项，可以按位组合。
+ */
+typedef enum {
+	LEPT_PARSE_DEFAULT_FLAGS = 0,
+	LEPT_PARSE_PACKED_NUMBERS = 1 << 0,	// 全部是数字的数组存成紧凑的 double 块
+	LEPT_PARSE_VALIDATE_UTF8 = 1 << 1,	// 检查字符串和键中的 UTF-8，不合法时返回 LEPT_PARSE_INVALID_UTF8
+	LEPT_PARSE_TRUST_SKIPPED = 1 << 2,	// lept_parse_projected 跳过的部分只匹配字符串和括号，不按 JSON 语法检查
+	LEPT_PARSE_RAW_NUMBERS = 1 << 3	// 数字只检查语法并保存原文，第一次 lept_get_number 时才转换，输出时照原文写出
+} lept_parse_flag;
+
+#define lept_init(v) do { (v)->type = LEPT_NULL; (v)->flags = 0; } while(0)
 #define lept_set_null(v) lept_free(v)
 
+/**
+ * lept_find_object_index 找不到键时的返回值。
+ */
+#define LEPT_KEY_NOT_EXIST ((size_t)-1)
+
 /*
  * lept_parse - parse json 
  * @param lept_value* v : 接收解析后的树变量，由调用方传入。
@@ -93,10 +151,97 @@ typedef enum {
 int lept_parse (lept_value* v, const char* json);
 
 /*
- * 释放内存
+ * lept_parse_ex - 带解析选项的 lept_parse
+ * @param flags: lept_parse_flag 的按位组合。
+ */
+int lept_parse_ex (lept_value* v, const char* json, unsigned flags);
+
+/**
+ * 编译好的字段集合，用于 lept_parse_projected。
+ */
+typedef struct lept_projection lept_projection;
+
+/**
+ * 编译字段路径。路径由键和 [*] 组成，键之间用 '.' 分隔，[*] 表示数组的每个元素，
+ * 例如 "id"、"user.name"、"items[*].price"、"[*].id"。空路径表示整个文档。
+ * 键按原样匹配，不能包含 '.' 和 '['。
+ * @return 			语法错误时返回 NULL。
+ */
+lept_projection* lept_projection_compile(const char* const* paths, size_t count);
+void lept_projection_free(lept_projection* proj);
+
+/**
+ * 只建出 proj 选中的部分。
+ * 没选中的成员和路径形状对不上的值（例如路径要求对象而实际是数字）不分配内存，
+ * 直接跳过，也不出现在结果中；数组只有 [*] 之下的元素被保留，对不上的元素同样略去。
+ * 选中的值一定是完整的子树，路径经过的对象和数组保留选中的部分。
+ * 跳过的部分默认仍按 JSON 语法检查，错误码与 lept_parse 相同；
+ * 加上 LEPT_PARSE_TRUST_SKIPPED 时只匹配字符串和括号，速度更快。
+ * LEPT_PARSE_VALIDATE_UTF8 只检查建出来的字符串。
+ * @param flags: lept_parse_flag 的按位组合。
+ */
+int lept_parse_projected (lept_value* v, const char* json, const lept_projection* proj, unsigned flags);
+
+/**
+ * 一次解析可以使用的资源上限，用于不可信的输入。字段为 0 表示不限制。
+ * 超过上限时解析马上停止，返回对应的错误码，已经建出的部分全部释放。
+ * 数字字面值的长度只受 max_input 限制。
+ */
+typedef struct lept_parse_limits {
+	size_t max_input;		// 输入字节数，超过时不开始解析，LEPT_PARSE_INPUT_TOO_LARGE
+	size_t max_nodes;		// 值的总数，包括容器本身，LEPT_PARSE_TOO_MANY_NODES
+	size_t max_string;		// 单个字符串或键转义之后的字节数，LEPT_PARSE_STRING_TOO_LONG
+	size_t max_container;	// 单个数组的元素数或对象的成员数，LEPT_PARSE_CONTAINER_TOO_LARGE
+	size_t max_bytes;		// 树占用的堆内存总量，按 lept_value、lept_member 和字符串的大小估算，LEPT_PARSE_TOO_MANY_BYTES
+} lept_parse_limits;
+
+/**
+ * 带资源上限的 lept_parse_ex，limits 为 NULL 时不限制。
+ * 各项检查都放在本来就要分配内存或者计数的地方，不限制时的开销可以忽略。
+ */
+int lept_parse_limited (lept_value* v, const char* json, unsigned flags, const lept_parse_limits* limits);
+
+/*
+ * lept_minify - 去掉字符串以外的空白，同时按 JSON 语法检查输入。
+ * 不建树，不分配内存。输出不会比输入长，所以 out 至少要有 len 字节，
+ * 也可以和 in 是同一块内存（原地压缩）。
+ * @param in, len: 输入文本，不要求以 '\0' 结尾。
+ * @param out_len: 接收输出长度。
+ * @return LEPT_PARSE_OK 或 lept_error_type，出错时 out 的内容无意义。
+ */
+int lept_minify(const char* in, size_t len, char* out, size_t* out_len);
+
+/*
+ * lept_validate - 只检查 json 是否合法，语法和错误码都和 lept_parse 相同。
+ * 不建树，不分配内存，嵌套深度受 LEPT_SCAN_MAX_DEPTH 限制。
+ * @param error_offset: 出错时接收第一个错误的字节偏移，可以为 NULL。
+ * @return LEPT_PARSE_OK 或 lept_error_type。
+ */
+int lept_validate(const char* json, size_t len, size_t* error_offset);
+
+/*
+ * 释放内存，不递归，任意深的树都可以释放。
+ * 需要马上返回的线程可以用 leptreclaim.h 中的 lept_free_deferred。
  */
 void lept_free(lept_value* v);
 
+/**
+ * 深拷贝、移动和交换。
+ * lept_move 之后 src 变为 null，所有权转移到 dst。
+ */
+void lept_copy(lept_value* dst, const lept_value* src);
+void lept_move(lept_value* dst, lept_value* src);
+void lept_swap(lept_value* lhs, lept_value* rhs);
+
+/**
+ * 结构相等：类型和值都相同，对象成员与顺序无关，紧凑数组与同样内容的普通数组相等。
+ * 对象有重复的键时，同一个键的第 n 次出现和另一边的第 n 次出现配对，
+ * 例如 {"x":1,"x":1} 与 {"x":1,"y":2} 不相等，{"x":1,"x":2} 与 {"x":2,"x":1} 也不相等。
+ * lept_hash 与之一致：相等的值哈希相同。两者都不递归，可以处理任意深的树。
+ */
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs);
+uint64_t lept_hash(const lept_value* v);
+
 /**
  * lept_get_type
  * 获取 json value 的值。
@@ -111,6 +256,14 @@ lept_type lept_get_type(const lept_value* v);
 double lept_get_number (const lept_value* v);
 void lept_set_number(lept_value *v, double n);
 
+/**
+ * 用 LEPT_PARSE_RAW_NUMBERS 解析的数字的原文，在值被修改或释放之前有效。
+ * 只有这种数字可以按原样拿到原文，例如超过 2^53 的整数或者有效数字很多的小数。
+ * @param len 		接收原文长度，可以为 NULL。
+ * @return 			以 '\0' 结尾的原文；不是这样解析的数字（包括 lept_set_number 设置的）返回 NULL。
+ */
+const char* lept_get_number_text(const lept_value* v, size_t* len);
+
 int lept_get_boolean(const lept_value* v);
 void lept_set_boolean(lept_value *v, int b);
 
@@ -121,11 +274,69 @@ size_t lept_get_string_length(const lept_value* v);
 lept_type lept_get_null(const lept_value* v);
 
 size_t lept_get_array_size(const lept_value* v);
-lept_value* lept_get_array_element(const lept_value* v, size_t size);
+
+/**
+ * 获取元素，不会修改数组，多个线程可以同时调用。
+ * 紧凑数组（LEPT_PARSE_PACKED_NUMBERS）没有 lept_value 可以返回，调用前用 lept_is_array_packed 判断，
+ * 紧凑数组用 lept_get_array_number 读取，或者用 lept_get_array_element_mutable。
+ */
+lept_value* lept_get_array_element(const lept_value* v, size_t index);
+
+/**
+ * 同 lept_get_array_element，但紧凑数组会先转换回普通存储，所以需要可修改的 v。
+ */
+lept_value* lept_get_array_element_mutable(lept_value* v, size_t index);
+
+/**
+ * 紧凑数字数组。
+ * lept_get_array_numbers 返回连续的 double 缓冲区，数组不是紧凑存储时返回 NULL。
+ * lept_get_array_number 对两种存储方式都可用，只读，不会转换存储。
+ * lept_get_array_element_mutable 以及 pushback / insert 需要返回可修改的 lept_value*，
+ * 会先把数组透明地转换回普通存储，之后就可以放入任意类型的值；
+ * 转换之后之前 lept_get_array_numbers 返回的指针失效。
+ */
+int lept_is_array_packed(const lept_value* v);
+double* lept_get_array_numbers(const lept_value* v);
+double lept_get_array_number(const lept_value* v, size_t index);
+int lept_pack_array(lept_value* v);
+void lept_unpack_array(lept_value* v);
+
+/**
+ * 动态数组。容量按 2 倍增长，pushback 均摊 O(1)。
+ * pushback / insert 返回的新元素已初始化为 null，由调用方赋值。
+ * 注意：扩容后之前取得的元素指针会失效。
+ */
+void lept_set_array(lept_value* v, size_t capacity);
+size_t lept_get_array_capacity(const lept_value* v);
+void lept_reserve_array(lept_value* v, size_t capacity);
+void lept_shrink_array(lept_value* v);
+void lept_clear_array(lept_value* v);
+lept_value* lept_pushback_array_element(lept_value* v);
+void lept_popback_array_element(lept_value* v);
+lept_value* lept_insert_array_element(lept_value* v, size_t index);
+void lept_erase_array_element(lept_value* v, size_t index, size_t count);
 
 size_t lept_get_object_size(const lept_value* v);
 const char* lept_get_object_key(const lept_value* v, size_t index);
 size_t lept_get_object_key_length(const lept_value* v, size_t index);
 lept_value* lept_get_object_value(const lept_value* v, size_t index);
 
+/**
+ * 动态对象。lept_set_object_value 在键不存在时追加一个 null 成员，
+ * 存在时返回原有的值，调用方再用 lept_set_* 赋值即可。
+ */
+void lept_set_object(lept_value* v, size_t capacity);
+size_t lept_get_object_capacity(const lept_value* v);
+void lept_reserve_object(lept_value* v, size_t capacity);
+void lept_shrink_object(lept_value* v);
+void lept_clear_object(lept_value* v);
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen);
+lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen);
+lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen);
+void lept_remove_object_value(lept_value* v, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,401 @@
+#ifndef LEPTJSON_HPP__
+#define LEPTJSON_HPP__
+
+#include "leptjson.h"
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+/**
+ * leptjson 的 C++ 封装，只有头文件，需要 C++17。
+ *
+ * lept::document 拥有一棵 lept_value 树，只能移动，析构时调用 lept_free。
+ * lept::value_ref、array_view、object_view 是不拥有内存的只读视图，
+ * 大小相当于一两个指针，按值传递；它们在 document 被修改或销毁之后失效。
+ * 访问函数直接读 lept_value 的字段，get_string 返回指向 u.s.s 的 std::string_view，
+ * 都不分配内存。
+ *
+ * 一般用法：
+ 		auto doc = lept::parse(json);		// C++23，返回 std::expected<document, std::error_code>
+ 		if (!doc) { ... doc.error() ... }
+ 		for (lept::value_ref item : doc->root()["items"].get_array()) {
+ 			double price = item["price"].get_number();
+ 		}
+ */
+
+namespace lept {
+
+/**
+ * lept_error_type 对应的 std::error_code。
+ */
+enum class parse_error {
+	ok = LEPT_PARSE_OK,
+	expect_value = LEPT_PARSE_EXPECT_VALUE,
+	invalid_value = LEPT_PARSE_INVALID_VALUE,
+	root_not_singular = LEPT_PARSE_ROOT_NOT_SINGULAR,
+	number_too_big = LEPT_PARSE_NUMBER_TOO_BIG,
+	miss_quotation_mark = LEPT_PARSE_MISS_QUOTATION_MARK,
+	invalid_string_escape = LEPT_PARSE_INVALID_STRING_ESCAPE,
+	invalid_string_char = LEPT_PARSE_INVALID_STRING_CHAR,
+	invalid_unicode_hex = LEPT_PARSE_INVALID_UNICODE_HEX,
+	invalid_unicode_surrogate = LEPT_PARSE_INVALID_UNICODE_SURROGATE,
+	miss_comma_or_square_bracket = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+	miss_key = LEPT_PARSE_MISS_KEY,
+	miss_colon = LEPT_PARSE_MISS_COLON,
+	miss_comma_or_curly_bracket = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+	invalid_msgpack = LEPT_PARSE_INVALID_MSGPACK,
+	depth_exceeded = LEPT_PARSE_DEPTH_EXCEEDED,
+	invalid_utf8 = LEPT_PARSE_INVALID_UTF8,
+	type_mismatch = LEPT_PARSE_TYPE_MISMATCH,
+	miss_required_field = LEPT_PARSE_MISS_REQUIRED_FIELD,
+	input_too_large = LEPT_PARSE_INPUT_TOO_LARGE,
+	too_many_nodes = LEPT_PARSE_TOO_MANY_NODES,
+	string_too_long = LEPT_PARSE_STRING_TOO_LONG,
+	container_too_large = LEPT_PARSE_CONTAINER_TOO_LARGE,
+	too_many_bytes = LEPT_PARSE_TOO_MANY_BYTES
+};
+
+class parse_error_category : public std::error_category {
+public:
+	const char* name() const noexcept override { return "leptjson"; }
+
+	std::string message(int ev) const override {
+		static const char* const names[] = {
+			"LEPT_PARSE_OK", "LEPT_PARSE_EXPECT_VALUE", "LEPT_PARSE_INVALID_VALUE",
+			"LEPT_PARSE_ROOT_NOT_SINGULAR", "LEPT_PARSE_NUMBER_TOO_BIG", "LEPT_PARSE_MISS_QUOTATION_MARK",
+			"LEPT_PARSE_INVALID_STRING_ESCAPE", "LEPT_PARSE_INVALID_STRING_CHAR", "LEPT_PARSE_INVALID_UNICODE_HEX",
+			"LEPT_PARSE_INVALID_UNICODE_SURROGATE", "LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET", "LEPT_PARSE_MISS_KEY",
+			"LEPT_PARSE_MISS_COLON", "LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET", "LEPT_PARSE_INVALID_MSGPACK",
+			"LEPT_PARSE_DEPTH_EXCEEDED", "LEPT_PARSE_INVALID_UTF8", "LEPT_PARSE_TYPE_MISMATCH",
+			"LEPT_PARSE_MISS_REQUIRED_FIELD", "LEPT_PARSE_INPUT_TOO_LARGE", "LEPT_PARSE_TOO_MANY_NODES",
+			"LEPT_PARSE_STRING_TOO_LONG", "LEPT_PARSE_CONTAINER_TOO_LARGE", "LEPT_PARSE_TOO_MANY_BYTES"
+		};
+		if (ev >= 0 && static_cast<std::size_t>(ev) < sizeof(names) / sizeof(names[0])) {
+			return names[ev];
+		}
+		return "unknown leptjson error";
+	}
+};
+
+inline const std::error_category& parse_category() noexcept {
+	static const parse_error_category category;
+	return category;
+}
+
+inline std::error_code make_error_code(parse_error e) noexcept {
+	return std::error_code(static_cast<int>(e), parse_category());
+}
+
+class array_view;
+class object_view;
+
+/**
+ * 指向一个值的只读视图。紧凑数组的元素没有 lept_value，这时视图直接指向 double。
+ */
+class value_ref {
+public:
+	explicit value_ref(const lept_value* v) noexcept : v_(v), n_(nullptr) { assert(v != nullptr); }
+	explicit value_ref(const double* n) noexcept : v_(nullptr), n_(n) { assert(n != nullptr); }
+
+	lept_type type() const noexcept { return v_ != nullptr ? v_->type : LEPT_NUMBER; }
+	bool is_null() const noexcept { return type() == LEPT_NULL; }
+	bool is_boolean() const noexcept { return type() == LEPT_TRUE || type() == LEPT_FALSE; }
+	bool is_number() const noexcept { return type() == LEPT_NUMBER; }
+	bool is_string() const noexcept { return type() == LEPT_STRING; }
+	bool is_array() const noexcept { return type() == LEPT_ARRAY; }
+	bool is_object() const noexcept { return type() == LEPT_OBJECT; }
+
+	bool get_boolean() const noexcept {
+		assert(is_boolean());
+		return v_->type == LEPT_TRUE;
+	}
+
+	double get_number() const noexcept {
+		assert(is_number());
+		return n_ != nullptr ? *n_ : lept_get_number(v_);
+	}
+
+	std::string_view get_string() const noexcept {
+		assert(is_string());
+		return std::string_view(v_->u.s.s, v_->u.s.len);
+	}
+
+	array_view get_array() const noexcept;
+	object_view get_object() const noexcept;
+
+	/**
+	 * 数组元素，下标必须有效。
+	 */
+	value_ref operator[](std::size_t index) const noexcept;
+
+	/**
+	 * 对象成员，键必须存在；不确定时用 find。
+	 */
+	value_ref operator[](std::string_view key) const noexcept;
+
+	/**
+	 * 查找对象成员，找不到时返回 false，不修改 out。
+	 */
+	bool find(std::string_view key, value_ref& out) const noexcept;
+
+	/**
+	 * 对应的 lept_value，紧凑数组的元素返回 nullptr。
+	 */
+	const lept_value* c_value() const noexcept { return v_; }
+
+	bool operator==(const value_ref& rhs) const noexcept {
+		if (v_ != nullptr && rhs.v_ != nullptr) {
+			return lept_is_equal(v_, rhs.v_) != 0;
+		}
+		return is_number() && rhs.is_number() && get_number() == rhs.get_number();
+	}
+	bool operator!=(const value_ref& rhs) const noexcept { return !(*this == rhs); }
+
+private:
+	const lept_value* v_;
+	const double* n_;
+};
+
+/**
+ * 对象成员的视图，键可能包含 '\0'。
+ */
+struct member_ref {
+	std::string_view key;
+	value_ref value;
+};
+
+/**
+ * 数组和对象共用的随机访问迭代器，解引用时现场构造视图，所以 reference 不是引用类型。
+ */
+template <class Derived, class Ref>
+class index_iterator {
+public:
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = Ref;
+	using difference_type = std::ptrdiff_t;
+	using reference = Ref;
+	using pointer = void;
+
+	Derived& operator++() noexcept { ++i_; return self(); }
+	Derived operator++(int) noexcept { Derived t = self(); ++i_; return t; }
+	Derived& operator--() noexcept { --i_; return self(); }
+	Derived operator--(int) noexcept { Derived t = self(); --i_; return t; }
+	Derived& operator+=(difference_type n) noexcept { i_ += n; return self(); }
+	Derived& operator-=(difference_type n) noexcept { i_ -= n; return self(); }
+	Derived operator+(difference_type n) const noexcept { Derived t = self(); t.i_ += n; return t; }
+	Derived operator-(difference_type n) const noexcept { Derived t = self(); t.i_ -= n; return t; }
+	friend Derived operator+(difference_type n, const Derived& it) noexcept { return it + n; }
+	difference_type operator-(const Derived& rhs) const noexcept { return i_ - rhs.i_; }
+	Ref operator[](difference_type n) const noexcept { return (self() + n).deref(); }
+	Ref operator*() const noexcept { return self().deref(); }
+
+	bool operator==(const Derived& rhs) const noexcept { return i_ == rhs.i_; }
+	bool operator!=(const Derived& rhs) const noexcept { return i_ != rhs.i_; }
+	bool operator<(const Derived& rhs) const noexcept { return i_ < rhs.i_; }
+	bool operator>(const Derived& rhs) const noexcept { return i_ > rhs.i_; }
+	bool operator<=(const Derived& rhs) const noexcept { return i_ <= rhs.i_; }
+	bool operator>=(const Derived& rhs) const noexcept { return i_ >= rhs.i_; }
+
+protected:
+	explicit index_iterator(difference_type i = 0) noexcept : i_(i) {}
+	difference_type i_;
+
+private:
+	Derived& self() noexcept { return static_cast<Derived&>(*this); }
+	const Derived& self() const noexcept { return static_cast<const Derived&>(*this); }
+};
+
+class array_view {
+public:
+	class iterator : public index_iterator<iterator, value_ref> {
+	public:
+		iterator() noexcept : index_iterator(0), a_(nullptr) {}
+	private:
+		friend class array_view;
+		friend class index_iterator<iterator, value_ref>;
+		iterator(const lept_value* a, std::ptrdiff_t i) noexcept : index_iterator(i), a_(a) {}
+		value_ref deref() const noexcept {
+			return a_->flags & LEPT_VALUE_PACKED ? value_ref(a_->u.p.n + i_) : value_ref(a_->u.a.e + i_);
+		}
+		const lept_value* a_;
+	};
+	using const_iterator = iterator;
+
+	explicit array_view(const lept_value* a) noexcept : a_(a) { assert(a != nullptr && a->type == LEPT_ARRAY); }
+
+	/* u.a.size 和 u.p.size 位置相同，但分开读更清楚 */
+	std::size_t size() const noexcept { return a_->flags & LEPT_VALUE_PACKED ? a_->u.p.size : a_->u.a.size; }
+	bool empty() const noexcept { return size() == 0; }
+	value_ref operator[](std::size_t index) const noexcept {
+		assert(index < size());
+		return *(begin() + static_cast<std::ptrdiff_t>(index));
+	}
+	iterator begin() const noexcept { return iterator(a_, 0); }
+	iterator end() const noexcept { return iterator(a_, static_cast<std::ptrdiff_t>(size())); }
+
+	/**
+	 * 紧凑数组的 double 块，不是紧凑存储时返回 nullptr。
+	 */
+	const double* numbers() const noexcept { return a_->flags & LEPT_VALUE_PACKED ? a_->u.p.n : nullptr; }
+
+private:
+	const lept_value* a_;
+};
+
+class object_view {
+public:
+	class iterator : public index_iterator<iterator, member_ref> {
+	public:
+		iterator() noexcept : index_iterator(0), m_(nullptr) {}
+	private:
+		friend class object_view;
+		friend class index_iterator<iterator, member_ref>;
+		iterator(const lept_member* m, std::ptrdiff_t i) noexcept : index_iterator(i), m_(m) {}
+		member_ref deref() const noexcept {
+			return member_ref{ std::string_view(m_[i_].k, m_[i_].klen), value_ref(&m_[i_].v) };
+		}
+		const lept_member* m_;
+	};
+	using const_iterator = iterator;
+
+	explicit object_view(const lept_value* o) noexcept : o_(o) { assert(o != nullptr && o->type == LEPT_OBJECT); }
+
+	std::size_t size() const noexcept { return o_->u.o.size; }
+	bool empty() const noexcept { return size() == 0; }
+	member_ref operator[](std::size_t index) const noexcept {
+		assert(index < size());
+		return *(begin() + static_cast<std::ptrdiff_t>(index));
+	}
+	iterator begin() const noexcept { return iterator(o_->u.o.m, 0); }
+	iterator end() const noexcept { return iterator(o_->u.o.m, static_cast<std::ptrdiff_t>(size())); }
+
+	bool find(std::string_view key, value_ref& out) const noexcept {
+		std::size_t i = lept_find_object_index(o_, key.data(), key.size());
+		if (i == LEPT_KEY_NOT_EXIST) {
+			return false;
+		}
+		out = value_ref(&o_->u.o.m[i].v);
+		return true;
+	}
+
+private:
+	const lept_value* o_;
+};
+
+inline array_view value_ref::get_array() const noexcept {
+	assert(is_array());
+	return array_view(v_);
+}
+
+inline object_view value_ref::get_object() const noexcept {
+	assert(is_object());
+	return object_view(v_);
+}
+
+inline value_ref value_ref::operator[](std::size_t index) const noexcept {
+	return get_array()[index];
+}
+
+inline bool value_ref::find(std::string_view key, value_ref& out) const noexcept {
+	return get_object().find(key, out);
+}
+
+inline value_ref value_ref::operator[](std::string_view key) const noexcept {
+	value_ref out(*this);
+	bool found = find(key, out);
+	assert(found);
+	(void)found;
+	return out;
+}
+
+/**
+ * 拥有一棵 lept_value 树。只能移动，移动之后原对象为 null。
+ */
+class document {
+public:
+	document() noexcept { lept_init(&v_); }
+
+	/**
+	 * 接管 v 的内容，v 变为 null。
+	 */
+	explicit document(lept_value* v) noexcept {
+		assert(v != nullptr);
+		v_ = *v;
+		lept_init(v);
+	}
+
+	~document() { lept_free(&v_); }
+
+	document(const document&) = delete;
+	document& operator=(const document&) = delete;
+
+	document(document&& rhs) noexcept : v_(rhs.v_) { lept_init(&rhs.v_); }
+	document& operator=(document&& rhs) noexcept {
+		lept_swap(&v_, &rhs.v_);
+		return *this;
+	}
+
+	/**
+	 * json 必须以 '\0' 结尾，所以只接受 const char* 和 std::string。
+	 * 失败时 *this 为 null，ec 为对应的 parse_error。
+	 */
+	std::error_code parse(const char* json, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) noexcept {
+		lept_free(&v_);
+		int ret = lept_parse_ex(&v_, json, flags);
+		return make_error_code(static_cast<parse_error>(ret));
+	}
+	std::error_code parse(const std::string& json, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) noexcept {
+		return parse(json.c_str(), flags);
+	}
+
+	value_ref root() const noexcept { return value_ref(&v_); }
+
+	const lept_value* c_value() const noexcept { return &v_; }
+	lept_value* c_value() noexcept { return &v_; }
+
+	/**
+	 * 把树交给调用方，之后由调用方调用 lept_free。
+	 */
+	lept_value release() noexcept {
+		lept_value v = v_;
+		lept_init(&v_);
+		return v;
+	}
+
+private:
+	lept_value v_;
+};
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+/**
+ * 解析 json，成功时返回 document，失败时返回 parse_error 对应的 std::error_code。
+ */
+inline std::expected<document, std::error_code> parse(const char* json, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) {
+	document doc;
+	std::error_code ec = doc.parse(json, flags);
+	if (ec) {
+		return std::unexpected(ec);
+	}
+	return doc;
+}
+
+inline std::expected<document, std::error_code> parse(const std::string& json, unsigned flags = LEPT_PARSE_DEFAULT_FLAGS) {
+	return parse(json.c_str(), flags);
+}
+#endif
+
+} // namespace lept
+
+namespace std {
+template <>
+struct is_error_code_enum<lept::parse_error> : true_type {};
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "leptmsgpack.h"
+#include "leptcontext.h"
+#include "leptscan.h"
+#include <assert.h> /* assert() */
+#include <stdint.h> /* uint8_t, uint64_t, int64_t */
+#include <stdlib.h> /* NULL, malloc(), free() */
+#include <string.h> /* memcpy */
+#include <math.h> /* signbit */
+
+/**
+ * 编码时用 lept_context 的栈作为可增长的输出缓冲区。
+ */
+static void lept_msgpack_put(lept_context* c, const void* data, size_t len) {
+	memcpy(lept_context_push(c, len), data, len);
+}
+
+/**
+ * 写入类型字节和 n 字节的大端整数。
+ */
+static void lept_msgpack_put_be(lept_context* c, unsigned char tag, uint64_t u, int n) {
+	unsigned char* p = (unsigned char*)lept_context_push(c, n + 1);
+	int i;
+	p[0] = tag;
+	for (i = n; i >= 1; --i) {
+		p[i] = (unsigned char)(u & 0xFF);
+		u >>= 8;
+	}
+}
+
+/**
+ * 数字能无损表示为 int64 时用最短的整数格式，否则用 float 64。
+ * -0.0 保留为 float 64，避免丢掉符号。
+ */
+static void lept_msgpack_put_number(lept_context* c, double d) {
+	uint64_t bits;
+
+	if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == (double)(int64_t)d
+			&& !(d == 0.0 && signbit(d))) {
+		int64_t i = (int64_t)d;
+		if (i >= 0) {
+			if (i < 0x80)					put_c(c, (char)i);
+			else if (i <= 0xFF)				lept_msgpack_put_be(c, 0xcc, (uint64_t)i, 1);
+			else if (i <= 0xFFFF)			lept_msgpack_put_be(c, 0xcd, (uint64_t)i, 2);
+			else if (i <= 0xFFFFFFFFLL)		lept_msgpack_put_be(c, 0xce, (uint64_t)i, 4);
+			else							lept_msgpack_put_be(c, 0xcf, (uint64_t)i, 8);
+		} else {
+			if (i >= -32)					put_c(c, (char)(0xe0 | (i + 32)));
+			else if (i >= -0x80)			lept_msgpack_put_be(c, 0xd0, (uint64_t)i, 1);
+			else if (i >= -0x8000)			lept_msgpack_put_be(c, 0xd1, (uint64_t)i, 2);
+			else if (i >= -0x80000000LL)	lept_msgpack_put_be(c, 0xd2, (uint64_t)i, 4);
+			else							lept_msgpack_put_be(c, 0xd3, (uint64_t)i, 8);
+		}
+		return;
+	}
+	memcpy(&bits, &d, sizeof(bits));
+	lept_msgpack_put_be(c, 0xcb, bits, 8);
+}
+
+#define LEPT_MSGPACK_MAX_LENGTH 0xFFFFFFFFu	// 32 位格式能表示的最大长度和元素个数
+
+/**
+ * @return 			长度超过 32 位格式的上限时返回 -1，什么也不写。
+ */
+static int lept_msgpack_put_string(lept_context* c, const char* s, size_t len) {
+	if (len < 32)					put_c(c, (char)(0xa0 | len));
+	else if (len <= 0xFF)			lept_msgpack_put_be(c, 0xd9, len, 1);
+	else if (len <= 0xFFFF)			lept_msgpack_put_be(c, 0xda, len, 2);
+	else if (len <= LEPT_MSGPACK_MAX_LENGTH)	lept_msgpack_put_be(c, 0xdb, len, 4);
+	else							return -1;
+	lept_msgpack_put(c, s, len);
+	return 0;
+}
+
+/**
+ * 写入容器头。fix_tag 是 fixarray / fixmap 的前缀，tag16 之后紧跟着是 32 位格式。
+ * @return 			元素个数超过 32 位格式的上限时返回 -1。
+ */
+static int lept_msgpack_put_header(lept_context* c, unsigned char fix_tag, unsigned char tag16, size_t n) {
+	if (n < 16)						put_c(c, (char)(fix_tag | n));
+	else if (n <= 0xFFFF)			lept_msgpack_put_be(c, tag16, n, 2);
+	else if (n <= LEPT_MSGPACK_MAX_LENGTH)	lept_msgpack_put_be(c, tag16 + 1, n, 4);
+	else							return -1;
+	return 0;
+}
+
+/**
+ * @return 			0，或者 -1（有长度超出 MessagePack 格式的字符串或容器）。
+ */
+static int lept_msgpack_encode_value(lept_context* c, const lept_value* v) {
+	size_t i;
+
+	switch (v->type) {
+		case LEPT_NULL:		put_c(c, (char)0xc0); return 0;
+		case LEPT_FALSE:	put_c(c, (char)0xc2); return 0;
+		case LEPT_TRUE:		put_c(c, (char)0xc3); return 0;
+		case LEPT_NUMBER:	lept_msgpack_put_number(c, lept_get_number(v)); return 0;
+		case LEPT_STRING:	return lept_msgpack_put_string(c, v->u.s.s, v->u.s.len);
+		case LEPT_ARRAY:
+			if (v->flags & LEPT_VALUE_PACKED) {
+				if (lept_msgpack_put_header(c, 0x90, 0xdc, v->u.p.size) != 0) {
+					return -1;
+				}
+				for (i = 0; i < v->u.p.size; ++i) {
+					lept_msgpack_put_number(c, v->u.p.n[i]);
+				}
+				return 0;
+			}
+			if (lept_msgpack_put_header(c, 0x90, 0xdc, v->u.a.size) != 0) {
+				return -1;
+			}
+			for (i = 0; i < v->u.a.size; ++i) {
+				if (lept_msgpack_encode_value(c, &v->u.a.e[i]) != 0) {
+					return -1;
+				}
+			}
+			return 0;
+		case LEPT_OBJECT:
+			if (lept_msgpack_put_header(c, 0x80, 0xde, v->u.o.size) != 0) {
+				return -1;
+			}
+			for (i = 0; i < v->u.o.size; ++i) {
+				if (lept_msgpack_put_string(c, v->u.o.m[i].k, v->u.o.m[i].klen) != 0
+						|| lept_msgpack_encode_value(c, &v->u.o.m[i].v) != 0) {
+					return -1;
+				}
+			}
+			return 0;
+		default:
+			assert(0 && "invalid type");
+			return -1;
+	}
+}
+
+char* lept_encode_msgpack(const lept_value* v, size_t* length) {
+	assert(v != NULL);
+	lept_context c;
+	c.json = NULL;
+	c.stack = NULL;
+	c.size = c.top = 0;
+	c.flags = 0;
+
+	if (lept_msgpack_encode_value(&c, v) != 0) {
+		free(c.stack);
+		if (length) {
+			*length = 0;
+		}
+		return NULL;
+	}
+	if (length) {
+		*length = c.top;
+	}
+	if (c.stack == NULL) {
+		c.stack = (char*)malloc(1);
+	}
+	return c.stack;
+}
+
+/**
+ * 解码上下文。p 为当前位置，end 为输入结尾。
+ */
+typedef struct {
+	const unsigned char* p;
+	const unsigned char* end;
+	unsigned flags;
+	int depth;
+} lept_msgpack_reader;
+
+#define MSGPACK_NEED(r, n) do { if ((size_t)((r)->end - (r)->p) < (size_t)(n)) return LEPT_PARSE_INVALID_MSGPACK; } while(0)
+
+static uint64_t lept_msgpack_get_be(lept_msgpack_reader* r, int n) {
+	uint64_t u = 0;
+	int i;
+	for (i = 0; i < n; ++i) {
+		u = (u << 8) | r->p[i];
+	}
+	r->p += n;
+	return u;
+}
+
+/**
+ * 读取字符串长度前缀，成功后 r->p 指向字符串内容。
+ */
+static int lept_msgpack_get_string(lept_msgpack_reader* r, const char** s, size_t* len) {
+	unsigned char tag;
+	MSGPACK_NEED(r, 1);
+	tag = *r->p++;
+
+	if ((tag & 0xe0) == 0xa0) {
+		*len = tag & 0x1f;
+	} else if (tag >= 0xd9 && tag <= 0xdb) {
+		int n = 1 << (tag - 0xd9);
+		MSGPACK_NEED(r, n);
+		*len = (size_t)lept_msgpack_get_be(r, n);
+	} else {
+		return LEPT_PARSE_INVALID_MSGPACK;
+	}
+	MSGPACK_NEED(r, *len);
+	if ((r->flags & LEPT_PARSE_VALIDATE_UTF8) && lept_scan_utf8((const char*)r->p, *len) != LEPT_PARSE_OK) {
+		return LEPT_PARSE_INVALID_UTF8;
+	}
+	*s = (const char*)r->p;
+	r->p += *len;
+	return LEPT_PARSE_OK;
+}
+
+static int lept_msgpack_decode_value(lept_msgpack_reader* r, lept_value* v);
+
+static int lept_msgpack_decode_array(lept_msgpack_reader* r, lept_value* v, size_t n) {
+	size_t i;
+	int ret;
+
+	/* 每个元素至少 1 字节，先检查长度再分配，避免恶意的超大长度前缀 */
+	MSGPACK_NEED(r, n);
+	lept_set_array(v, n);
+	for (i = 0; i < n; ++i) {
+		lept_value* e = &v->u.a.e[i];
+		lept_init(e);
+		if ((ret = lept_msgpack_decode_value(r, e)) != LEPT_PARSE_OK) {
+			v->u.a.size = i;
+			lept_free(v);
+			return ret;
+		}
+		v->u.a.size = i + 1;
+	}
+	if (r->flags & LEPT_PARSE_PACKED_NUMBERS) {
+		lept_pack_array(v);
+	}
+	return LEPT_PARSE_OK;
+}
+
+static int lept_msgpack_decode_map(lept_msgpack_reader* r, lept_value* v, size_t n) {
+	size_t i;
+	int ret;
+
+	/* 每个成员至少有 1 字节的键和 1 字节的值 */
+	MSGPACK_NEED(r, n * 2);
+	lept_set_object(v, n);
+	for (i = 0; i < n; ++i) {
+		lept_member* m = &v->u.o.m[i];
+		const char* k;
+		if ((ret = lept_msgpack_get_string(r, &k, &m->klen)) != LEPT_PARSE_OK) {
+			break;
+		}
+		m->k = (char*)malloc(m->klen + 1);
+		memcpy(m->k, k, m->klen);
+		m->k[m->klen] = '\0';
+		lept_init(&m->v);
+		v->u.o.size = i + 1;
+		if ((ret = lept_msgpack_decode_value(r, &m->v)) != LEPT_PARSE_OK) {
+			break;
+		}
+	}
+	if (i < n) {
+		lept_free(v);
+		return ret;
+	}
+	return LEPT_PARSE_OK;
+}
+
+static int lept_msgpack_decode_value(lept_msgpack_reader* r, lept_value* v) {
+	unsigned char tag;
+	uint64_t u;
+	const char* s;
+	size_t len;
+	int ret, n;
+
+	MSGPACK_NEED(r, 1);
+	tag = *r->p;
+
+	/* positive fixint / negative fixint */
+	if (tag < 0x80 || tag >= 0xe0) {
+		r->p++;
+		lept_set_number(v, (double)(signed char)tag);
+		return LEPT_PARSE_OK;
+	}
+	/* fixstr 以及 str 8/16/32 */
+	if ((tag & 0xe0) == 0xa0 || (tag >= 0xd9 && tag <= 0xdb)) {
+		if ((ret = lept_msgpack_get_string(r, &s, &len)) == LEPT_PARSE_OK) {
+			lept_set_string(v, s, len);
+		}
+		return ret;
+	}
+
+	r->p++;
+	if ((tag & 0xf0) == 0x90 || (tag & 0xf0) == 0x80) {
+		len = tag & 0x0f;
+	} else if (tag == 0xdc || tag == 0xdd || tag == 0xde || tag == 0xdf) {
+		n = (tag == 0xdc || tag == 0xde) ? 2 : 4;
+		MSGPACK_NEED(r, n);
+		len = (size_t)lept_msgpack_get_be(r, n);
+	} else {
+		switch (tag) {
+			case 0xc0: v->type = LEPT_NULL; return LEPT_PARSE_OK;
+			case 0xc2: v->type = LEPT_FALSE; return LEPT_PARSE_OK;
+			case 0xc3: v->type = LEPT_TRUE; return LEPT_PARSE_OK;
+			case 0xca: {
+				uint32_t bits;
+				float f;
+				MSGPACK_NEED(r, 4);
+				bits = (uint32_t)lept_msgpack_get_be(r, 4);
+				memcpy(&f, &bits, sizeof(f));
+				lept_set_number(v, f);
+				return LEPT_PARSE_OK;
+			}
+			case 0xcb: {
+				double d;
+				MSGPACK_NEED(r, 8);
+				u = lept_msgpack_get_be(r, 8);
+				memcpy(&d, &u, sizeof(d));
+				lept_set_number(v, d);
+				return LEPT_PARSE_OK;
+			}
+			case 0xcc: case 0xcd: case 0xce: case 0xcf:
+				n = 1 << (tag - 0xcc);
+				MSGPACK_NEED(r, n);
+				lept_set_number(v, (double)lept_msgpack_get_be(r, n));
+				return LEPT_PARSE_OK;
+			case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+				n = 1 << (tag - 0xd0);
+				MSGPACK_NEED(r, n);
+				u = lept_msgpack_get_be(r, n);
+				/* 符号扩展 */
+				if (n < 8 && (u >> (n * 8 - 1))) {
+					u |= ~(uint64_t)0 << (n * 8);
+				}
+				lept_set_number(v, (double)(int64_t)u);
+				return LEPT_PARSE_OK;
+			default:
+				return LEPT_PARSE_INVALID_MSGPACK;
+		}
+	}
+
+	/* 只有容器计入深度，标量在最深一层也可以解码 */
+	if (r->depth >= LEPT_MSGPACK_MAX_DEPTH) {
+		return LEPT_PARSE_DEPTH_EXCEEDED;
+	}
+	r->depth++;
+	ret = ((tag & 0xf0) == 0x90 || tag == 0xdc || tag == 0xdd)
+		? lept_msgpack_decode_array(r, v, len)
+		: lept_msgpack_decode_map(r, v, len);
+	r->depth--;
+	return ret;
+}
+
+int lept_decode_msgpack(lept_value* v, const char* data, size_t len) {
+	return lept_decode_msgpack_ex(v, data, len, LEPT_PARSE_DEFAULT_FLAGS);
+}
+
+int lept_decode_msgpack_ex(lept_value* v, const char* data, size_t len, unsigned flags) {
+	assert(v != NULL && (data != NULL || len == 0));
+	lept_msgpack_reader r;
+	int ret;
+
+	lept_init(v);
+	if (len == 0) {
+		return LEPT_PARSE_EXPECT_VALUE;
+	}
+	r.p = (const unsigned char*)data;
+	r.end = r.p + len;
+	r.flags = flags;
+	r.depth = 0;
+
+	if ((ret = lept_msgpack_decode_value(&r, v)) == LEPT_PARSE_OK && r.p != r.end) {
+		lept_free(v);
+		ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+	}
+	return ret;
+}
@@ -0,0 +1,53 @@
+#ifndef LEPTMSGPACK_H__
+#define LEPTMSGPACK_H__
+
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * MessagePack 编解码，直接在 lept_value 树和二进制之间转换，不经过 JSON 文本。
+ *
+ * 映射关系：
+ * 		null / false / true 	-> nil / false / true
+ * 		number 				-> 能无损表示为整数时用最短的 int 格式，否则用 float 64
+ * 		string 				-> str 8/16/32 或 fixstr
+ * 		array / object 		-> array 16/32 / map 16/32 或 fix 格式
+ * 解码时 bin、ext 以及非字符串的 map 键都视为错误。
+ */
+
+/**
+ * 容器嵌套深度上限，防止恶意输入耗尽调用栈，超过时解码返回 LEPT_PARSE_DEPTH_EXCEEDED。
+ */
+#ifndef LEPT_MSGPACK_MAX_DEPTH
+#define LEPT_MSGPACK_MAX_DEPTH 1024
+#endif
+
+/**
+ * 编码 v，返回 malloc 分配的缓冲区，由调用方 free。
+ * @param length 	接收编码后的字节数，可以为 NULL。
+ * @return 			有长度超过 0xFFFFFFFF 的字符串、键、数组或对象时返回 NULL，
+ * 					MessagePack 没有能表示它们的格式。
+ */
+char* lept_encode_msgpack(const lept_value* v, size_t* length);
+
+/**
+ * 解码 data 中的一个 MessagePack 值到 v。
+ * 容器按长度前缀一次分配到准确的大小。
+ * @return 	LEPT_PARSE_OK，或者 LEPT_PARSE_EXPECT_VALUE（空输入）、
+ * 			LEPT_PARSE_INVALID_MSGPACK、LEPT_PARSE_DEPTH_EXCEEDED、LEPT_PARSE_ROOT_NOT_SINGULAR（有多余字节）。
+ */
+int lept_decode_msgpack(lept_value* v, const char* data, size_t len);
+
+/**
+ * 带选项的解码。目前支持 LEPT_PARSE_PACKED_NUMBERS。
+ */
+int lept_decode_msgpack_ex(lept_value* v, const char* data, size_t len, unsigned flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,442 @@
+#include "leptpatch.h"
+#include <assert.h> /* assert() */
+#include <stdlib.h> /* NULL, malloc(), free() */
+#include <string.h> /* memcmp, memmove */
+
+void lept_merge_patch(lept_value* target, const lept_value* patch) {
+	assert(target != NULL && patch != NULL);
+	size_t i, index;
+	const lept_value* pv;
+
+	if (lept_get_type(patch) != LEPT_OBJECT) {
+		lept_free(target);
+		lept_copy(target, patch);
+		return;
+	}
+	if (lept_get_type(target) != LEPT_OBJECT) {
+		lept_free(target);
+		lept_set_object(target, lept_get_object_size(patch));
+	}
+	for (i = 0; i < lept_get_object_size(patch); i++) {
+		const char* key = lept_get_object_key(patch, i);
+		size_t klen = lept_get_object_key_length(patch, i);
+		pv = lept_get_object_value(patch, i);
+		if (lept_get_type(pv) == LEPT_NULL) {
+			if ((index = lept_find_object_index(target, key, klen)) != LEPT_KEY_NOT_EXIST) {
+				lept_remove_object_value(target, index);
+			}
+		} else {
+			lept_merge_patch(lept_set_object_value(target, key, klen), pv);
+		}
+	}
+}
+
+/**
+ * 撤销记录。每个修改树的步骤记一条，撤销时按 path 重新定位，
+ * 因为之后的操作可能让数组重新分配，之前取得的指针已经失效。
+ */
+enum {
+	LEPT_UNDO_REMOVE,		// 把新加的成员或元素移到 carry，再删掉位置
+	LEPT_UNDO_RESTORE,		// 把当前值移到 carry，saved 放回原位置
+	LEPT_UNDO_INSERT,		// 把删掉的 saved 重新插入
+	LEPT_UNDO_INSERT_CARRY	// move 的来源：把 carry 重新插入
+};
+
+typedef struct {
+	int kind;
+	const char* path;
+	size_t len;
+	size_t index;		// 数组元素或对象成员的下标（"-" 已经换成实际下标）
+	lept_value saved;
+} lept_patch_undo;
+
+typedef struct {
+	lept_value* root;
+	char* buf;			// 解开 ~0、~1 之后的键，和最长的 path 一样长
+	lept_patch_undo* undo;
+	size_t nundo;
+	lept_value carry;	// 撤销 move 时，从目标位置取回、等待放回来源的值
+} lept_patch_context;
+
+/**
+ * 取 JSON Pointer 的下一段放到 buf 里，*pp 指向这一段前面的 '/'，返回后指向下一个 '/' 或结尾。
+ */
+static int lept_pointer_next(const char** pp, const char* end, char* buf, size_t* len) {
+	const char* p = *pp + 1;
+	size_t n = 0;
+
+	while (p < end && *p != '/') {
+		if (*p == '~') {
+			if (p + 1 < end && (p[1] == '0' || p[1] == '1')) {
+				buf[n++] = p[1] == '0' ? '~' : '/';
+				p += 2;
+			} else {
+				return LEPT_PATCH_INVALID_POINTER;
+			}
+		} else {
+			buf[n++] = *p++;
+		}
+	}
+	*pp = p;
+	*len = n;
+	return LEPT_PATCH_OK;
+}
+
+/**
+ * 数组下标：十进制数字，不能有前导 0。
+ */
+static int lept_pointer_index(const char* tok, size_t n, size_t* index) {
+	size_t i, x = 0;
+
+	if (n == 0 || (n > 1 && tok[0] == '0')) {
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		if (tok[i] < '0' || tok[i] > '9' || x > ((size_t)-1 - 9) / 10) {
+			return 0;
+		}
+		x = x * 10 + (size_t)(tok[i] - '0');
+	}
+	*index = x;
+	return 1;
+}
+
+static lept_value* lept_pointer_child(lept_value* v, const char* tok, size_t n) {
+	size_t index;
+
+	if (lept_get_type(v) == LEPT_OBJECT) {
+		return lept_find_object_value(v, tok, n);
+	}
+	if (lept_get_type(v) == LEPT_ARRAY && lept_pointer_index(tok, n, &index) && index < lept_get_array_size(v)) {
+		return lept_get_array_element_mutable(v, index);
+	}
+	return NULL;
+}
+
+/**
+ * 找到 path 最后一段所在的容器，最后一段放在 c->buf 里。path 为空（整个文档）时 *parent 为 NULL。
+ */
+static int lept_pointer_parent(lept_patch_context* c, const char* path, size_t len,
+		lept_value** parent, size_t* tlen) {
+	const char* p = path;
+	const char* end = path + len;
+	lept_value* v = c->root;
+	int ret;
+
+	if (len == 0) {
+		*parent = NULL;
+		return LEPT_PATCH_OK;
+	}
+	if (*p != '/') {
+		return LEPT_PATCH_INVALID_POINTER;
+	}
+	for (;;) {
+		if ((ret = lept_pointer_next(&p, end, c->buf, tlen)) != LEPT_PATCH_OK) {
+			return ret;
+		}
+		if (p == end) {
+			*parent = v;
+			return LEPT_PATCH_OK;
+		}
+		if ((v = lept_pointer_child(v, c->buf, *tlen)) == NULL) {
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		}
+	}
+}
+
+/**
+ * path 指向的值，不存在时返回 LEPT_PATCH_PATH_NOT_FOUND。
+ */
+static int lept_pointer_get(lept_patch_context* c, const char* path, size_t len, lept_value** v) {
+	lept_value* parent;
+	size_t tlen;
+	int ret;
+
+	if ((ret = lept_pointer_parent(c, path, len, &parent, &tlen)) != LEPT_PATCH_OK) {
+		return ret;
+	}
+	*v = parent == NULL ? c->root : lept_pointer_child(parent, c->buf, tlen);
+	return *v == NULL ? LEPT_PATCH_PATH_NOT_FOUND : LEPT_PATCH_OK;
+}
+
+static lept_patch_undo* lept_patch_log(lept_patch_context* c, int kind, const char* path, size_t len, size_t index) {
+	lept_patch_undo* u = &c->undo[c->nundo++];
+	u->kind = kind;
+	u->path = path;
+	u->len = len;
+	u->index = index;
+	lept_init(&u->saved);
+	return u;
+}
+
+/**
+ * 把 value 移动到 path，value 变为 null。
+ */
+static int lept_patch_add(lept_patch_context* c, const char* path, size_t len, lept_value* value) {
+	lept_value* parent;
+	lept_value* slot;
+	size_t tlen, index;
+	int ret;
+
+	if ((ret = lept_pointer_parent(c, path, len, &parent, &tlen)) != LEPT_PATCH_OK) {
+		return ret;
+	}
+	if (parent == NULL) {
+		lept_move(&lept_patch_log(c, LEPT_UNDO_RESTORE, path, len, 0)->saved, c->root);
+		lept_move(c->root, value);
+	} else if (lept_get_type(parent) == LEPT_OBJECT) {
+		if ((slot = lept_find_object_value(parent, c->buf, tlen)) != NULL) {
+			lept_move(&lept_patch_log(c, LEPT_UNDO_RESTORE, path, len, 0)->saved, slot);
+		} else {
+			slot = lept_set_object_value(parent, c->buf, tlen);
+			lept_patch_log(c, LEPT_UNDO_REMOVE, path, len, lept_get_object_size(parent) - 1);
+		}
+		lept_move(slot, value);
+	} else if (lept_get_type(parent) == LEPT_ARRAY) {
+		if (tlen == 1 && c->buf[0] == '-') {
+			index = lept_get_array_size(parent);
+		} else if (!lept_pointer_index(c->buf, tlen, &index) || index > lept_get_array_size(parent)) {
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		}
+		lept_move(lept_insert_array_element(parent, index), value);
+		lept_patch_log(c, LEPT_UNDO_REMOVE, path, len, index);
+	} else {
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	}
+	return LEPT_PATCH_OK;
+}
+
+/**
+ * 从 path 删除。out 为 NULL 时被删除的值保存在撤销记录里，否则移动到 out（move 操作）。
+ */
+static int lept_patch_remove(lept_patch_context* c, const char* path, size_t len, lept_value* out) {
+	lept_value* parent;
+	lept_value* v;
+	lept_patch_undo* u;
+	size_t tlen, index;
+	int ret, kind = out == NULL ? LEPT_UNDO_INSERT : LEPT_UNDO_INSERT_CARRY;
+
+	if ((ret = lept_pointer_parent(c, path, len, &parent, &tlen)) != LEPT_PATCH_OK) {
+		return ret;
+	}
+	if (parent != NULL && lept_get_type(parent) == LEPT_OBJECT) {
+		if ((index = lept_find_object_index(parent, c->buf, tlen)) == LEPT_KEY_NOT_EXIST) {
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		}
+		v = lept_get_object_value(parent, index);
+		u = lept_patch_log(c, kind, path, len, index);
+		lept_move(out == NULL ? &u->saved : out, v);
+		lept_remove_object_value(parent, index);
+	} else if (parent != NULL && lept_get_type(parent) == LEPT_ARRAY) {
+		if (!lept_pointer_index(c->buf, tlen, &index) || index >= lept_get_array_size(parent)) {
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		}
+		v = lept_get_array_element_mutable(parent, index);
+		u = lept_patch_log(c, kind, path, len, index);
+		lept_move(out == NULL ? &u->saved : out, v);
+		lept_erase_array_element(parent, index, 1);
+	} else {
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	}
+	return LEPT_PATCH_OK;
+}
+
+/**
+ * 在对象的第 index 个位置插入一个新成员，不查找同名的键：
+ * 对象可以有重复的键，撤销时必须放回被删掉的那一个，而不是覆盖留下的同名成员。
+ */
+static lept_value* lept_patch_insert_member(lept_value* parent, const char* key, size_t klen, size_t index) {
+	lept_member m;
+	size_t size = parent->u.o.size;
+
+	if (size == parent->u.o.capacity) {
+		lept_reserve_object(parent, size == 0 ? 1 : size * 2);
+	}
+	m.k = (char*)malloc(klen + 1);
+	memcpy(m.k, key, klen);
+	m.k[klen] = '\0';
+	m.klen = klen;
+	lept_init(&m.v);
+	memmove(&parent->u.o.m[index + 1], &parent->u.o.m[index], (size - index) * sizeof(lept_member));
+	parent->u.o.m[index] = m;
+	parent->u.o.size++;
+	return &parent->u.o.m[index].v;
+}
+
+static void lept_patch_undo_one(lept_patch_context* c, lept_patch_undo* u) {
+	lept_value* parent;
+	lept_value* v;
+	size_t tlen;
+
+	if (u->kind == LEPT_UNDO_RESTORE) {
+		lept_pointer_get(c, u->path, u->len, &v);
+		lept_move(&c->carry, v);
+		lept_move(v, &u->saved);
+		return;
+	}
+	lept_pointer_parent(c, u->path, u->len, &parent, &tlen);
+	if (u->kind == LEPT_UNDO_REMOVE) {
+		if (lept_get_type(parent) == LEPT_OBJECT) {
+			lept_move(&c->carry, lept_get_object_value(parent, u->index));
+			lept_remove_object_value(parent, u->index);
+		} else {
+			lept_move(&c->carry, lept_get_array_element_mutable(parent, u->index));
+			lept_erase_array_element(parent, u->index, 1);
+		}
+		return;
+	}
+	if (lept_get_type(parent) == LEPT_OBJECT) {
+		v = lept_patch_insert_member(parent, c->buf, tlen, u->index);
+		lept_move(v, u->kind == LEPT_UNDO_INSERT ? &u->saved : &c->carry);
+	} else {
+		v = lept_insert_array_element(parent, u->index);
+		lept_move(v, u->kind == LEPT_UNDO_INSERT ? &u->saved : &c->carry);
+	}
+}
+
+/**
+ * 操作对象中的字符串成员，不存在或不是字符串时返回 NULL。
+ */
+static const char* lept_patch_member(const lept_value* op, const char* key, size_t* len) {
+	lept_value* v = lept_find_object_value((lept_value*)op, key, strlen(key));
+	if (v == NULL || lept_get_type(v) != LEPT_STRING) {
+		return NULL;
+	}
+	*len = lept_get_string_length(v);
+	return lept_get_string(v);
+}
+
+static int lept_patch_apply_op(lept_patch_context* c, const lept_value* op) {
+	const char* name;
+	const char* path;
+	const char* from;
+	size_t nlen, len, flen = 0;
+	lept_value* value = lept_find_object_value((lept_value*)op, "value", 5);
+	lept_value* src;
+	lept_value tmp;
+	int ret;
+
+	name = lept_patch_member(op, "op", &nlen);
+	path = lept_patch_member(op, "path", &len);
+	from = lept_patch_member(op, "from", &flen);
+
+	lept_init(&tmp);
+	if (nlen == 3 && memcmp(name, "add", 3) == 0) {
+		lept_copy(&tmp, value);
+		ret = lept_patch_add(c, path, len, &tmp);
+	} else if (nlen == 6 && memcmp(name, "remove", 6) == 0) {
+		ret = lept_patch_remove(c, path, len, NULL);
+	} else if (nlen == 7 && memcmp(name, "replace", 7) == 0) {
+		if ((ret = lept_pointer_get(c, path, len, &src)) == LEPT_PATCH_OK) {
+			lept_move(&lept_patch_log(c, LEPT_UNDO_RESTORE, path, len, 0)->saved, src);
+			lept_copy(src, value);
+		}
+	} else if (nlen == 4 && memcmp(name, "move", 4) == 0) {
+		if (flen == len && memcmp(from, path, len) == 0) {
+			ret = LEPT_PATCH_OK;
+		} else if (flen < len && memcmp(from, path, flen) == 0 && path[flen] == '/') {
+			ret = LEPT_PATCH_MOVE_INTO_CHILD;
+		} else if ((ret = lept_patch_remove(c, from, flen, &tmp)) == LEPT_PATCH_OK
+				&& (ret = lept_patch_add(c, path, len, &tmp)) != LEPT_PATCH_OK) {
+			/* 撤销时由 LEPT_UNDO_INSERT_CARRY 放回来源 */
+			lept_move(&c->carry, &tmp);
+		}
+	} else if (nlen == 4 && memcmp(name, "copy", 4) == 0) {
+		if ((ret = lept_pointer_get(c, from, flen, &src)) == LEPT_PATCH_OK) {
+			lept_copy(&tmp, src);
+			ret = lept_patch_add(c, path, len, &tmp);
+		}
+	} else {
+		if ((ret = lept_pointer_get(c, path, len, &src)) == LEPT_PATCH_OK && !lept_is_equal(src, value)) {
+			ret = LEPT_PATCH_TEST_FAILED;
+		}
+	}
+	lept_free(&tmp);
+	return ret;
+}
+
+/**
+ * 检查操作的结构，并算出最长的 path / from，用来分配 c->buf。
+ */
+static int lept_patch_check(const lept_value* ops, size_t* maxlen) {
+	static const char* names[] = { "add", "remove", "replace", "move", "copy", "test" };
+	const lept_value* op;
+	const char* name;
+	size_t i, k, len, nlen;
+
+	if (lept_get_type(ops) != LEPT_ARRAY) {
+		return LEPT_PATCH_INVALID_OPERATION;
+	}
+	if (lept_is_array_packed(ops)) {
+		return lept_get_array_size(ops) == 0 ? LEPT_PATCH_OK : LEPT_PATCH_INVALID_OPERATION;
+	}
+	*maxlen = 0;
+	for (i = 0; i < lept_get_array_size(ops); i++) {
+		op = lept_get_array_element(ops, i);
+		if (lept_get_type(op) != LEPT_OBJECT
+				|| (name = lept_patch_member(op, "op", &nlen)) == NULL
+				|| lept_patch_member(op, "path", &len) == NULL) {
+			return LEPT_PATCH_INVALID_OPERATION;
+		}
+		*maxlen = len > *maxlen ? len : *maxlen;
+		for (k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+			if (strlen(names[k]) == nlen && memcmp(names[k], name, nlen) == 0) {
+				break;
+			}
+		}
+		switch (k) {
+			case 0: case 2: case 5:	/* add, replace, test */
+				if (lept_find_object_value((lept_value*)op, "value", 5) == NULL) {
+					return LEPT_PATCH_INVALID_OPERATION;
+				}
+				break;
+			case 1:
+				break;
+			case 3: case 4:			/* move, copy */
+				if (lept_patch_member(op, "from", &len) == NULL) {
+					return LEPT_PATCH_INVALID_OPERATION;
+				}
+				*maxlen = len > *maxlen ? len : *maxlen;
+				break;
+			default:
+				return LEPT_PATCH_INVALID_OPERATION;
+		}
+	}
+	return LEPT_PATCH_OK;
+}
+
+int lept_apply_patch(lept_value* target, const lept_value* ops) {
+	assert(target != NULL && ops != NULL);
+	lept_patch_context c;
+	size_t i, n, maxlen = 0;
+	int ret;
+
+	if ((ret = lept_patch_check(ops, &maxlen)) != LEPT_PATCH_OK) {
+		return ret;
+	}
+	if ((n = lept_get_array_size(ops)) == 0) {
+		return LEPT_PATCH_OK;
+	}
+	c.root = target;
+	c.buf = (char*)malloc(maxlen + 1);
+	/* move 最多记两条，其它操作最多一条 */
+	c.undo = (lept_patch_undo*)malloc(n * 2 * sizeof(lept_patch_undo));
+	c.nundo = 0;
+	lept_init(&c.carry);
+
+	for (i = 0; i < n && ret == LEPT_PATCH_OK; i++) {
+		ret = lept_patch_apply_op(&c, lept_get_array_element(ops, i));
+	}
+	if (ret != LEPT_PATCH_OK) {
+		while (c.nundo > 0) {
+			lept_patch_undo_one(&c, &c.undo[--c.nundo]);
+		}
+	}
+	for (i = 0; i < c.nundo; i++) {
+		lept_free(&c.undo[i].saved);
+	}
+	lept_free(&c.carry);
+	free(c.undo);
+	free(c.buf);
+	return ret;
+}
@@ -0,0 +1,41 @@
+#ifndef LEPTPATCH_H__
+#define LEPTPATCH_H__
+
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 直接修改 lept_value 树的 JSON Merge Patch（RFC 7386）和 JSON Patch（RFC 6902）。
+ * 只触及补丁涉及的成员和数组元素，代价与补丁大小成正比，与文档大小无关。
+ */
+
+typedef enum {
+	LEPT_PATCH_OK = 0,
+	LEPT_PATCH_INVALID_OPERATION,	// ops 不是数组，某个操作不是对象、op 未知或缺少 path / from / value。
+	LEPT_PATCH_INVALID_POINTER,		// path 或 from 不是合法的 JSON Pointer（RFC 6901）。
+	LEPT_PATCH_PATH_NOT_FOUND,		// 指向的位置不存在，或者数组下标越界。
+	LEPT_PATCH_TEST_FAILED,			// test 操作的值不相等。
+	LEPT_PATCH_MOVE_INTO_CHILD		// move 的目标位于 from 之内。
+} lept_patch_error;
+
+/**
+ * 把 merge patch 应用到 target。
+ * patch 是对象时逐个成员合并，值为 null 的成员表示删除；否则用 patch 整个替换 target。
+ */
+void lept_merge_patch(lept_value* target, const lept_value* patch);
+
+/**
+ * 按顺序执行 ops 数组中的 add / remove / replace / move / copy / test 操作。
+ * 任何一个操作失败时，已经执行的操作会按相反的顺序撤销，target 恢复原样。
+ * @return LEPT_PATCH_OK 或 lept_patch_error。
+ */
+int lept_apply_patch(lept_value* target, const lept_value* ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
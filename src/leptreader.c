@@ -0,0 +1,241 @@
+#include "leptreader.h"
+#include "leptcontext.h"
+#include "leptscan.h"
+#include <assert.h> /* assert() */
+#include <errno.h> /* errno, EINTR */
+#include <stdlib.h> /* NULL, malloc(), realloc(), free() */
+#include <string.h> /* memmove() */
+#include <unistd.h> /* read() */
+
+/**
+ * 读取器在数组中的位置。
+ */
+enum {
+	LEPT_READER_BEFORE_ARRAY,	// 还没读到 '['
+	LEPT_READER_FIRST,			// 刚读过 '['，下一个是元素或 ']'
+	LEPT_READER_ELEMENT,		// 刚读过 ','，下一个必须是元素
+	LEPT_READER_AFTER_ELEMENT,	// 下一个是 ',' 或 ']'
+	LEPT_READER_AFTER_ARRAY		// 读过 ']'，之后只能有空白
+};
+
+/**
+ * buffer[pos, len) 是还没消耗的输入，buffer[len] 总是 '\0'。
+ * 元素跨过缓冲区结尾时把剩下的部分移到开头再读，一个元素放不下时缓冲区扩大一倍。
+ */
+struct lept_array_reader {
+	FILE* fp;
+	int fd;
+	char* buffer;
+	size_t size;
+	size_t len;
+	size_t pos;
+	size_t offset;		// buffer[0] 在输入中的偏移
+	int eof;
+	int state;
+	int error;
+	lept_context c;		// 所有元素共用，栈在元素之间保留
+};
+
+static lept_array_reader* lept_array_reader_new(FILE* fp, int fd, unsigned flags) {
+	lept_array_reader* r = (lept_array_reader*)malloc(sizeof(lept_array_reader));
+
+	assert(r != NULL);
+	r->fp = fp;
+	r->fd = fd;
+	r->size = LEPT_READER_BUFFER_SIZE;
+	r->buffer = (char*)malloc(r->size);
+	assert(r->buffer != NULL);
+	r->buffer[0] = '\0';
+	r->len = r->pos = r->offset = 0;
+	r->eof = 0;
+	r->state = LEPT_READER_BEFORE_ARRAY;
+	r->error = LEPT_PARSE_OK;
+	r->c.json = NULL;
+	r->c.stack = NULL;
+	r->c.size = r->c.top = 0;
+	r->c.flags = flags;
+	r->c.end = NULL;
+	lept_context_set_limits(&r->c, NULL);
+	return r;
+}
+
+lept_array_reader* lept_array_reader_open_file(FILE* fp, unsigned flags) {
+	assert(fp != NULL);
+	return lept_array_reader_new(fp, -1, flags);
+}
+
+lept_array_reader* lept_array_reader_open_fd(int fd, unsigned flags) {
+	assert(fd >= 0);
+	return lept_array_reader_new(NULL, fd, flags);
+}
+
+void lept_array_reader_close(lept_array_reader* r) {
+	if (r == NULL) {
+		return;
+	}
+	free(r->c.stack);
+	free(r->buffer);
+	free(r);
+}
+
+size_t lept_array_reader_offset(const lept_array_reader* r) {
+	assert(r != NULL);
+	return r->offset + r->pos;
+}
+
+/**
+ * 丢掉已经消耗的输入，然后把缓冲区读满或者读到输入结尾。
+ * 只有未消耗的部分占满缓冲区时才扩大，所以重新扫描一个长元素的总代价是线性的。
+ */
+static int lept_array_reader_fill(lept_array_reader* r) {
+	size_t want;
+
+	if (r->pos > 0) {
+		memmove(r->buffer, r->buffer + r->pos, r->len - r->pos);
+		r->offset += r->pos;
+		r->len -= r->pos;
+		r->pos = 0;
+	}
+	if (r->len + 1 == r->size) {
+		r->size *= 2;
+		r->buffer = (char*)realloc(r->buffer, r->size);
+		assert(r->buffer != NULL);
+	}
+	while (!r->eof && r->len + 1 < r->size) {
+		want = r->size - r->len - 1;
+		if (r->fp != NULL) {
+			size_t n = fread(r->buffer + r->len, 1, want, r->fp);
+			r->len += n;
+			if (n < want) {
+				if (ferror(r->fp)) {
+					r->buffer[r->len] = '\0';
+					return LEPT_READER_IO_ERROR;
+				}
+				r->eof = 1;
+			}
+		} else {
+			ssize_t n = read(r->fd, r->buffer + r->len, want);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				r->buffer[r->len] = '\0';
+				return LEPT_READER_IO_ERROR;
+			}
+			r->len += (size_t)n;
+			r->eof = n == 0;
+		}
+	}
+	r->buffer[r->len] = '\0';
+	return LEPT_PARSE_OK;
+}
+
+/**
+ * 解析 buffer + pos 处的元素。先用 lept_skip_value 找到元素的结尾，
+ * 停在缓冲区末尾时元素可能还没读完（例如数字或字符串被截断），要继续读；
+ * 在中途就出错的元素不再读取，直接交给解析器报错。
+ * 找到之后临时在结尾放一个 '\0'，解析器就不会越过这个元素。lept_skip_value 报错时不放：
+ * 它停在出错的字符上（例如 [1,] 的 ']'），换成 '\0' 会改变解析器报告的错误。
+ */
+static int lept_array_reader_element(lept_array_reader* r, lept_value* out) {
+	const char* p;
+	const char* end;
+	char* q;
+	char saved;
+	int ret, skip;
+
+	for (;;) {
+		p = r->buffer + r->pos;
+		end = r->buffer + r->len;
+		skip = lept_skip_value(&p, end);
+		if (p == end && !r->eof) {
+			if ((ret = lept_array_reader_fill(r)) != LEPT_PARSE_OK) {
+				return ret;
+			}
+			continue;
+		}
+		break;
+	}
+
+	/* 截断或不合法的元素也交给解析器，错误码和 lept_parse 一致 */
+	q = r->buffer + (p - r->buffer);
+	saved = *q;
+	if (skip == LEPT_PARSE_OK) {
+		*q = '\0';
+	}
+	r->c.json = r->buffer + r->pos;
+	ret = lept_context_parse(&r->c, out);
+	*q = saved;
+	assert(r->c.top == 0);
+	if (ret == LEPT_PARSE_OK && (skip != LEPT_PARSE_OK || r->c.json != q)) {
+		lept_free(out);
+		ret = skip != LEPT_PARSE_OK ? skip : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+	}
+	if (ret == LEPT_PARSE_OK) {
+		r->pos = (size_t)(q - r->buffer);
+	}
+	return ret;
+}
+
+int lept_array_reader_next(lept_array_reader* r, lept_value* out) {
+	const char* p;
+	int ret;
+
+	assert(r != NULL && out != NULL);
+	lept_init(out);
+	while (r->error == LEPT_PARSE_OK) {
+		p = lept_skip_whitespace(r->buffer + r->pos);
+		r->pos = (size_t)(p - r->buffer);
+		if (r->pos == r->len) {
+			if (!r->eof) {
+				r->error = lept_array_reader_fill(r);
+				continue;
+			}
+			switch (r->state) {
+				case LEPT_READER_AFTER_ARRAY: return LEPT_READER_END;
+				case LEPT_READER_AFTER_ELEMENT: r->error = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET; break;
+				default: r->error = LEPT_PARSE_EXPECT_VALUE; break;
+			}
+			break;
+		}
+		switch (r->state) {
+			case LEPT_READER_BEFORE_ARRAY:
+				if (*p != '[') {
+					r->error = LEPT_PARSE_INVALID_VALUE;
+					break;
+				}
+				r->pos++;
+				r->state = LEPT_READER_FIRST;
+				continue;
+			case LEPT_READER_AFTER_ELEMENT:
+				if (*p == ',') {
+					r->pos++;
+					r->state = LEPT_READER_ELEMENT;
+				} else if (*p == ']') {
+					r->pos++;
+					r->state = LEPT_READER_AFTER_ARRAY;
+				} else {
+					r->error = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+				}
+				continue;
+			case LEPT_READER_AFTER_ARRAY:
+				r->error = LEPT_PARSE_ROOT_NOT_SINGULAR;
+				continue;
+			case LEPT_READER_FIRST:
+				if (*p == ']') {
+					r->pos++;
+					r->state = LEPT_READER_AFTER_ARRAY;
+					continue;
+				}
+				/* fall through */
+			default:
+				if ((ret = lept_array_reader_element(r, out)) != LEPT_PARSE_OK) {
+					r->error = ret;
+					continue;
+				}
+				r->state = LEPT_READER_AFTER_ELEMENT;
+				return LEPT_PARSE_OK;
+		}
+	}
+	return r->error;
+}
@@ -0,0 +1,67 @@
+#ifndef LEPTREADER_H__
+#define LEPTREADER_H__
+
+#include <stdio.h> /* FILE */
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 逐个读取顶层数组的元素。
+ * 输入通过一个滑动缓冲区从 FILE* 或文件描述符读入，每次只解析出一个元素，
+ * 所以占用的内存取决于最大的元素，而不是整个输入。
+ *
+ * 一般用法：
+ 		lept_array_reader* r = lept_array_reader_open_file(fp, LEPT_PARSE_DEFAULT_FLAGS);
+ 		lept_value e;
+ 		int ret;
+ 		while ((ret = lept_array_reader_next(r, &e)) == LEPT_PARSE_OK) {
+ 			...
+ 			lept_free(&e);
+ 		}
+ 		lept_array_reader_close(r);
+ */
+
+#ifndef LEPT_READER_BUFFER_SIZE
+#define LEPT_READER_BUFFER_SIZE 65536	// 缓冲区的初始大小，元素更大时按两倍扩大
+#endif
+
+/**
+ * lept_array_reader_next 在 lept_error_type 之外的返回值。
+ */
+typedef enum {
+	LEPT_READER_END = -1,			// 数组已经结束，之后只有空白
+	LEPT_READER_IO_ERROR = -2		// 读取输入失败
+} lept_reader_status;
+
+typedef struct lept_array_reader lept_array_reader;
+
+/**
+ * 从 fp 或者 fd 的当前位置开始读，关闭读取器时不会关闭它们。
+ * @param flags 	lept_parse_flag 的按位组合，用于解析每个元素。
+ */
+lept_array_reader* lept_array_reader_open_file(FILE* fp, unsigned flags);
+lept_array_reader* lept_array_reader_open_fd(int fd, unsigned flags);
+
+/**
+ * 解析下一个元素放到 out，out 的旧内容不会被释放，和 lept_parse 一样。
+ * 输入不是数组、元素不合法或者数组之后还有内容时返回 lept_error_type，
+ * 出错之后再调用都返回同一个错误。
+ * @return 			LEPT_PARSE_OK，LEPT_READER_END，LEPT_READER_IO_ERROR 或 lept_error_type。
+ */
+int lept_array_reader_next(lept_array_reader* r, lept_value* out);
+
+/**
+ * 已经消耗的输入字节数，出错时大致指向出错的元素。
+ */
+size_t lept_array_reader_offset(const lept_array_reader* r);
+
+void lept_array_reader_close(lept_array_reader* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
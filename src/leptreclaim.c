@@ -0,0 +1,133 @@
+#include "leptreclaim.h"
+#include "leptcontext.h"
+#include <assert.h> /* assert() */
+#include <stdlib.h> /* NULL, malloc(), free() */
+#include <pthread.h>
+
+typedef struct lept_reclaim_node lept_reclaim_node;
+struct lept_reclaim_node {
+	lept_value v;
+	lept_reclaim_node* next;
+};
+
+/**
+ * 整个进程共用一个队列和一个后台线程。
+ * queued 包括后台线程正在释放的树，降到 0 时通知 lept_reclaim_drain。
+ */
+static pthread_mutex_t lept_reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t lept_reclaim_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t lept_reclaim_idle = PTHREAD_COND_INITIALIZER;
+static lept_reclaim_node* lept_reclaim_head;
+static lept_reclaim_node* lept_reclaim_tail;
+static pthread_t lept_reclaim_thread;
+static int lept_reclaim_running;
+static int lept_reclaim_stopping;
+static lept_reclaim_stats lept_reclaim_counters;
+
+static void* lept_reclaim_main(void* arg) {
+	lept_reclaim_node* batch;
+	lept_reclaim_node* n;
+	size_t bytes;
+
+	(void)arg;
+	pthread_mutex_lock(&lept_reclaim_lock);
+	for (;;) {
+		while (lept_reclaim_head == NULL && !lept_reclaim_stopping) {
+			pthread_cond_wait(&lept_reclaim_work, &lept_reclaim_lock);
+		}
+		if (lept_reclaim_head == NULL) {
+			break;
+		}
+		/* 一次取走整个队列，释放时不持有锁，入队的线程不会被阻塞 */
+		batch = lept_reclaim_head;
+		lept_reclaim_head = lept_reclaim_tail = NULL;
+		while (batch != NULL) {
+			pthread_mutex_unlock(&lept_reclaim_lock);
+			n = batch;
+			batch = n->next;
+			bytes = lept_free_counted(&n->v);
+			pthread_mutex_lock(&lept_reclaim_lock);
+			lept_reclaim_counters.queued--;
+			lept_reclaim_counters.freed++;
+			lept_reclaim_counters.freed_bytes += bytes;
+			free(n);
+		}
+		if (lept_reclaim_counters.queued == 0) {
+			pthread_cond_broadcast(&lept_reclaim_idle);
+		}
+	}
+	pthread_mutex_unlock(&lept_reclaim_lock);
+	return NULL;
+}
+
+void lept_free_deferred(lept_value* v) {
+	lept_reclaim_node* n;
+
+	assert(v != NULL);
+	if (!(v->type == LEPT_ARRAY && !(v->flags & LEPT_VALUE_PACKED) && lept_get_array_size(v) > 0)
+		&& !(v->type == LEPT_OBJECT && lept_get_object_size(v) > 0)) {
+		lept_free(v);
+		return;
+	}
+	if ((n = (lept_reclaim_node*)malloc(sizeof(lept_reclaim_node))) == NULL) {
+		lept_free(v);
+		return;
+	}
+	lept_init(&n->v);
+	lept_move(&n->v, v);
+	n->next = NULL;
+
+	pthread_mutex_lock(&lept_reclaim_lock);
+	if (!lept_reclaim_running && !lept_reclaim_stopping) {
+		lept_reclaim_running = pthread_create(&lept_reclaim_thread, NULL, lept_reclaim_main, NULL) == 0;
+	}
+	if (!lept_reclaim_running || lept_reclaim_stopping) {
+		pthread_mutex_unlock(&lept_reclaim_lock);
+		lept_free(&n->v);
+		free(n);
+		return;
+	}
+	if (lept_reclaim_tail != NULL) {
+		lept_reclaim_tail->next = n;
+	} else {
+		lept_reclaim_head = n;
+	}
+	lept_reclaim_tail = n;
+	lept_reclaim_counters.queued++;
+	pthread_cond_signal(&lept_reclaim_work);
+	pthread_mutex_unlock(&lept_reclaim_lock);
+}
+
+void lept_reclaim_drain(void) {
+	pthread_mutex_lock(&lept_reclaim_lock);
+	while (lept_reclaim_counters.queued > 0) {
+		pthread_cond_wait(&lept_reclaim_idle, &lept_reclaim_lock);
+	}
+	pthread_mutex_unlock(&lept_reclaim_lock);
+}
+
+void lept_reclaim_shutdown(void) {
+	pthread_mutex_lock(&lept_reclaim_lock);
+	if (!lept_reclaim_running || lept_reclaim_stopping) {
+		pthread_mutex_unlock(&lept_reclaim_lock);
+		return;
+	}
+	/* 后台线程把队列释放完才退出 */
+	lept_reclaim_stopping = 1;
+	pthread_cond_signal(&lept_reclaim_work);
+	pthread_mutex_unlock(&lept_reclaim_lock);
+
+	pthread_join(lept_reclaim_thread, NULL);
+
+	pthread_mutex_lock(&lept_reclaim_lock);
+	lept_reclaim_running = 0;
+	lept_reclaim_stopping = 0;
+	pthread_mutex_unlock(&lept_reclaim_lock);
+}
+
+void lept_reclaim_get_stats(lept_reclaim_stats* stats) {
+	assert(stats != NULL);
+	pthread_mutex_lock(&lept_reclaim_lock);
+	*stats = lept_reclaim_counters;
+	pthread_mutex_unlock(&lept_reclaim_lock);
+}
@@ -0,0 +1,47 @@
+#ifndef LEPTRECLAIM_H__
+#define LEPTRECLAIM_H__
+
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 在后台线程中释放 lept_value 树。
+ *
+ * 释放一棵很大的树要逐个 free 数百万块内存，lept_free_deferred 把树交给后台线程，
+ * 调用线程只付出一次 O(1) 的移动和入队。后台线程在第一次调用时启动，
+ * 用 lept_free 逐棵释放队列中的树。
+ */
+
+typedef struct {
+	size_t queued;			// 已入队但还没释放完的树
+	size_t freed;			// 累计释放的树
+	size_t freed_bytes;		// 后台线程累计释放的字节数，释放时逐块统计，包括所有子节点
+} lept_reclaim_stats;
+
+/**
+ * 接管 v 的内容（v 变为 null）并交给后台线程释放。
+ * 标量和空容器没有需要释放的子节点，直接在当前线程释放。
+ * 后台线程无法启动时退回到同步的 lept_free。
+ */
+void lept_free_deferred(lept_value* v);
+
+/**
+ * 等待在此之前入队的树全部释放完。
+ */
+void lept_reclaim_drain(void);
+
+/**
+ * 释放所有排队的树并结束后台线程，用于程序退出前。之后再调用 lept_free_deferred 会重新启动后台线程。
+ */
+void lept_reclaim_shutdown(void);
+
+void lept_reclaim_get_stats(lept_reclaim_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
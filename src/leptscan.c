@@ -0,0 +1,810 @@
+#include "leptscan.h"
+#include "leptjson.h"
+#include <assert.h> /* assert() */
+#include <stdlib.h> /* NULL, strtod() */
+#include <stdio.h> /* snprintf() */
+#include <string.h> /* memcpy, memmove, memcmp */
+#include <math.h> /* HUGE_VAL */
+#include <stdint.h> /* uint64_t, uintptr_t */
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define LEPT_SCAN_SSE2 1
+#endif
+
+/* SSSE3 不在 x86-64 的基线里，按函数开启，运行时再检查 CPU 是否支持 */
+#if defined(LEPT_SCAN_SSE2) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define LEPT_SCAN_SSSE3 1
+#endif
+
+#define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
+#define ISWHITESPACE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+
+/* 最小的页大小，以 '\0' 结尾的输入按块读取时不能越过页边界 */
+#define LEPT_SCAN_PAGE_SIZE 4096
+
+/**
+ * 输出一个字符，out 为 NULL（只检查）时什么也不做。
+ * 输出总是落后于输入，所以原地压缩是安全的。
+ */
+#define EMIT(o, ch) do { if (o) *(o)++ = (ch); } while(0)
+
+/**
+ * 十六进制数字的值，其它字符为 -1（包括 '\0'）。
+ */
+static const signed char lept_hex_table[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+const char* lept_parse_hex4(const char* p, unsigned* u) {
+	assert(p != NULL && u != NULL);
+	int a, b, c, d;
+
+	/* 按顺序检查，遇到 '\0' 就停下，不会读到输入之外 */
+	if ((a = lept_hex_table[(unsigned char)p[0]]) < 0 || (b = lept_hex_table[(unsigned char)p[1]]) < 0
+			|| (c = lept_hex_table[(unsigned char)p[2]]) < 0 || (d = lept_hex_table[(unsigned char)p[3]]) < 0) {
+		return NULL;
+	}
+	*u = (unsigned)(a << 12 | b << 8 | c << 4 | d);
+	return p + 4;
+}
+
+int lept_scan_unicode(const char** pp, const char* end, unsigned* u) {
+	assert(pp != NULL && *pp != NULL && u != NULL);
+	const char* p = *pp;
+	const char* q;
+	unsigned high, low;
+
+	if ((end != NULL && end - p < 4) || !(p = lept_parse_hex4(p, &high))) {
+		return LEPT_PARSE_INVALID_UNICODE_HEX;
+	}
+
+	// Surrogate Check
+	if (high >= 0xD800 && high <= 0xDBFF) {
+		if ((end == NULL || end - p >= 6) && p[0] == '\\' && p[1] == 'u'
+				&& (q = lept_parse_hex4(p + 2, &low)) != NULL && low >= 0xDC00 && low <= 0xDFFF) {
+			*u = 0x10000 + (high - 0xD800) * 0x400 + (low - 0xDC00);
+			*pp = q;
+			return LEPT_PARSE_OK;
+		}
+		return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+	} else if (high >= 0xDC00 && high <= 0xDFFF) {
+		return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+	}
+	*u = high;
+	*pp = p;
+	return LEPT_PARSE_OK;
+}
+
+/**
+ * 逐字节检查 UTF-8（RFC 3629），拒绝过长编码、代理区码点和超过 U+10FFFF 的码点。
+ * 每次先按 8 字节检查是否全是 ASCII。
+ */
+static int lept_scan_utf8_scalar(const unsigned char* p, const unsigned char* end) {
+	unsigned char c;
+	while (p < end) {
+		if (end - p >= 8) {
+			uint64_t x;
+			memcpy(&x, p, sizeof(x));
+			if ((x & 0x8080808080808080ULL) == 0) {
+				p += 8;
+				continue;
+			}
+		}
+		c = *p;
+		if (c < 0x80) {
+			p++;
+		} else if (c >= 0xC2 && c <= 0xDF) {
+			if (end - p < 2 || (p[1] & 0xC0) != 0x80)
+				return LEPT_PARSE_INVALID_UTF8;
+			p += 2;
+		} else if (c >= 0xE0 && c <= 0xEF) {
+			if (end - p < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80
+					|| (c == 0xE0 && p[1] < 0xA0)	/* 过长编码 */
+					|| (c == 0xED && p[1] > 0x9F))	/* 代理区 */
+				return LEPT_PARSE_INVALID_UTF8;
+			p += 3;
+		} else if (c >= 0xF0 && c <= 0xF4) {
+			if (end - p < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80
+					|| (c == 0xF0 && p[1] < 0x90)	/* 过长编码 */
+					|| (c == 0xF4 && p[1] > 0x8F))	/* 大于 U+10FFFF */
+				return LEPT_PARSE_INVALID_UTF8;
+			p += 4;
+		} else {
+			return LEPT_PARSE_INVALID_UTF8;
+		}
+	}
+	return LEPT_PARSE_OK;
+}
+
+#ifdef LEPT_SCAN_SSSE3
+/**
+ * 查表法（Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"）。
+ * 用前一个字节的高低 4 位和当前字节的高 4 位查三张表，三个结果按位与之后非 0 就是错误；
+ * 3、4 字节序列的后续字节另外用前 2、3 个字节判断。每个错误类别占一位。
+ */
+#define U8_TOO_SHORT	(1 << 0)
+#define U8_TOO_LONG		(1 << 1)
+#define U8_OVERLONG_3	(1 << 2)
+#define U8_TOO_LARGE	(1 << 3)
+#define U8_SURROGATE	(1 << 4)
+#define U8_OVERLONG_2	(1 << 5)
+#define U8_TOO_LARGE_1000	(1 << 6)
+#define U8_OVERLONG_4	(1 << 6)
+#define U8_TWO_CONTS	(1 << 7)
+#define U8_CARRY		(U8_TOO_SHORT | U8_TOO_LONG | U8_TWO_CONTS)
+
+__attribute__((target("ssse3")))
+static __m128i lept_scan_utf8_block(__m128i input, __m128i prev_input) {
+	const __m128i byte_1_high_table = _mm_setr_epi8(
+		U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+		U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+		U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS,
+		U8_TOO_SHORT | U8_OVERLONG_2,
+		U8_TOO_SHORT,
+		U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE,
+		U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4);
+	const __m128i byte_1_low_table = _mm_setr_epi8(
+		U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4,
+		U8_CARRY | U8_OVERLONG_2,
+		U8_CARRY,
+		U8_CARRY,
+		U8_CARRY | U8_TOO_LARGE,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+		U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000);
+	const __m128i byte_2_high_table = _mm_setr_epi8(
+		U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+		U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE_1000 | U8_OVERLONG_4,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+		U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+		U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT);
+	const __m128i low4 = _mm_set1_epi8(0x0F);
+	__m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+	__m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+	__m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+	__m128i sc = _mm_and_si128(
+		_mm_and_si128(
+			_mm_shuffle_epi8(byte_1_high_table, _mm_and_si128(_mm_srli_epi16(prev1, 4), low4)),
+			_mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, low4))),
+		_mm_shuffle_epi8(byte_2_high_table, _mm_and_si128(_mm_srli_epi16(input, 4), low4)));
+	/* 前 2 个字节是 3 字节序列的开头，或前 3 个字节是 4 字节序列的开头时，当前字节必须是后续字节 */
+	__m128i must23 = _mm_or_si128(
+		_mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80))),
+		_mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80))));
+	return _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char)0x80)), sc);
+}
+
+__attribute__((target("ssse3")))
+static int lept_scan_utf8_ssse3(const unsigned char* p, const unsigned char* end) {
+	/* 块的最后 3 个字节里是否有还没结束的多字节序列 */
+	const __m128i max_value = _mm_setr_epi8(
+		(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF,
+		(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF,
+		(char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+	__m128i error = _mm_setzero_si128();
+	__m128i prev_input = _mm_setzero_si128();
+	__m128i prev_incomplete = _mm_setzero_si128();
+	__m128i input;
+	unsigned char tail[16];
+
+	while (p < end) {
+		if (end - p >= 16) {
+			input = _mm_loadu_si128((const __m128i*)p);
+			p += 16;
+		} else {
+			/* 最后不足 16 字节补 0，0 是 ASCII，没结束的序列会被当成 TOO_SHORT */
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, p, (size_t)(end - p));
+			input = _mm_loadu_si128((const __m128i*)tail);
+			p = end;
+		}
+		if (_mm_movemask_epi8(input) == 0) {
+			/* 全是 ASCII：只需要上一块没有留下未结束的序列 */
+			error = _mm_or_si128(error, prev_incomplete);
+			prev_incomplete = _mm_setzero_si128();
+		} else {
+			error = _mm_or_si128(error, lept_scan_utf8_block(input, prev_input));
+			prev_incomplete = _mm_subs_epu8(input, max_value);
+		}
+		prev_input = input;
+	}
+	error = _mm_or_si128(error, prev_incomplete);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF
+		? LEPT_PARSE_OK : LEPT_PARSE_INVALID_UTF8;
+}
+#endif
+
+int lept_scan_utf8(const char* s, size_t len) {
+	const unsigned char* p = (const unsigned char*)s;
+#ifdef LEPT_SCAN_SSSE3
+	if (len >= 16 && __builtin_cpu_supports("ssse3")) {
+		return lept_scan_utf8_ssse3(p, p + len);
+	}
+#endif
+	return lept_scan_utf8_scalar(p, p + len);
+}
+
+/* 越过 '\0' 读取同一页内的字节是安全的，但 AddressSanitizer 会把它当成越界 */
+#if defined(__SANITIZE_ADDRESS__)
+#define LEPT_SCAN_NO_ASAN __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LEPT_SCAN_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef LEPT_SCAN_NO_ASAN
+#define LEPT_SCAN_NO_ASAN
+#endif
+
+#ifdef LEPT_SCAN_SSE2
+/**
+ * 16 字节中不是空白的字节对应的位。
+ */
+LEPT_SCAN_NO_ASAN
+static inline unsigned lept_scan_nonspace_mask(const char* p) {
+	__m128i x = _mm_loadu_si128((const __m128i*)p);
+	__m128i ws = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+		_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+	return (unsigned)_mm_movemask_epi8(ws) ^ 0xFFFF;
+}
+#endif
+
+/**
+ * 跳过空白。第一个字符不是空白时直接返回，长段的缩进用 SSE2 每次检查 16 字节。
+ */
+static const char* lept_scan_whitespace(const char* p, const char* end) {
+	if (p == end || !ISWHITESPACE(*p)) {
+		return p;
+	}
+#ifdef LEPT_SCAN_SSE2
+	while (end - p >= 16) {
+		unsigned mask = lept_scan_nonspace_mask(p);
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && ISWHITESPACE(*p)) {
+		p++;
+	}
+	return p;
+}
+
+LEPT_SCAN_NO_ASAN
+const char* lept_skip_whitespace(const char* p) {
+#ifdef LEPT_SCAN_SSE2
+	for (;;) {
+		if (((uintptr_t)p & (LEPT_SCAN_PAGE_SIZE - 1)) <= LEPT_SCAN_PAGE_SIZE - 32) {
+			unsigned mask = lept_scan_nonspace_mask(p) | (lept_scan_nonspace_mask(p + 16) << 16);
+			if (mask != 0) {
+				return p + __builtin_ctz(mask);
+			}
+			p += 32;
+		} else if (ISWHITESPACE(*p)) {
+			/* 靠近页尾，逐字节走到下一页 */
+			p++;
+		} else {
+			return p;
+		}
+	}
+#else
+	while (ISWHITESPACE(*p)) {
+		p++;
+	}
+	return p;
+#endif
+}
+
+/**
+ * 拷贝字符串中不需要特殊处理的一段，返回第一个 '"'、'\\' 或控制字符的位置。
+ * 原地压缩时输出可能和还没读到的输入重叠，所以只有整块 16 字节都是普通字符才整块写出。
+ */
+static const char* lept_scan_string_run(const char* p, const char* end, char** po) {
+	const char* start = p;
+#ifdef LEPT_SCAN_SSE2
+	while (end - p >= 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)p);
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))),
+			_mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(special);
+		if (mask != 0) {
+			p += __builtin_ctz(mask);
+			break;
+		}
+		if (*po) {
+			_mm_storeu_si128((__m128i*)*po, x);
+			*po += 16;
+		}
+		p += 16;
+		start = p;
+	}
+#endif
+	while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) {
+		p++;
+	}
+	if (*po) {
+		memmove(*po, start, (size_t)(p - start));
+		*po += p - start;
+	}
+	return p;
+}
+
+/**
+ * 扫描字符串，*pp 指向开头的引号。出错时 *pp 指向出错的位置。
+ */
+static int lept_scan_string(const char** pp, const char* end, char** po) {
+	const char* p = *pp;
+	const char* q;
+	unsigned u;
+	int ret = LEPT_PARSE_OK;
+
+	EMIT(*po, '"');
+	p++;
+	for (;;) {
+		p = lept_scan_string_run(p, end, po);
+		if (p == end) {
+			ret = LEPT_PARSE_MISS_QUOTATION_MARK;
+			break;
+		}
+		if (*p == '"') {
+			EMIT(*po, '"');
+			p++;
+			break;
+		}
+		if (*p != '\\') {
+			ret = LEPT_PARSE_INVALID_STRING_CHAR;
+			break;
+		}
+		if (end - p < 2) {
+			ret = LEPT_PARSE_INVALID_STRING_ESCAPE;
+			break;
+		}
+		switch (p[1]) {
+			case '"': case '\\': case '/': case 'b':
+			case 'f': case 'n': case 'r': case 't':
+				q = p + 2;
+				break;
+			case 'u':
+				q = p + 2;
+				if ((ret = lept_scan_unicode(&q, end, &u)) != LEPT_PARSE_OK) {
+					*pp = p;
+					return ret;
+				}
+				break;
+			default:
+				*pp = p;
+				return LEPT_PARSE_INVALID_STRING_ESCAPE;
+		}
+		if (*po) {
+			memmove(*po, p, (size_t)(q - p));
+			*po += q - p;
+		}
+		p = q;
+	}
+	*pp = p;
+	return ret;
+}
+
+#define LEPT_SCAN_SIGNIFICANT 40	// 边界上的数字保留的有效数字，多于 double 能区分的 17 位
+
+/**
+ * 检查数字是否超出 double 的范围。
+ * 先用十进制数量级估算，只有正好落在边界上的数字才调用 strtod 精确判断：
+ * 把有效数字规范成 d.ddd…e308 写进 tmp，截掉的部分有非零数字时补一个 1，
+ * 所以结果不受数字长度和数字后面是什么字符影响。
+ */
+static int lept_scan_number_too_big(const char* int_begin, const char* int_end,
+		const char* frac_begin, const char* frac_end, long exp) {
+	long m;
+	char tmp[64];
+	char* o = tmp;
+	const char* q;
+	int k, digits = 0, sticky = 0;
+	double d;
+
+	if (!(int_end - int_begin == 1 && *int_begin == '0')) {
+		m = (long)(int_end - int_begin);
+	} else {
+		const char* f = frac_begin;
+		while (f < frac_end && *f == '0') {
+			f++;
+		}
+		if (f == frac_end) {
+			return 0; /* 数值为 0 */
+		}
+		m = -(long)(f - frac_begin);
+	}
+	m += exp;
+	if (m < 309) {
+		return 0;
+	}
+	if (m > 309) {
+		return 1;
+	}
+	for (k = 0; k < 2; k++) {
+		for (q = k == 0 ? int_begin : frac_begin; q < (k == 0 ? int_end : frac_end); q++) {
+			if (digits == 0 && *q == '0') {
+				continue;
+			}
+			if (digits < LEPT_SCAN_SIGNIFICANT) {
+				*o++ = *q;
+				if (++digits == 1) {
+					*o++ = '.';
+				}
+			} else if (*q != '0') {
+				sticky = 1;
+			}
+		}
+	}
+	if (sticky) {
+		*o++ = '1';
+	}
+	snprintf(o, sizeof(tmp) - (size_t)(o - tmp), "e%ld", m - 1);
+	d = strtod(tmp, NULL);
+	return d == HUGE_VAL;
+}
+
+static int lept_scan_number(const char** pp, const char* end) {
+	const char* p = *pp;
+	const char *int_begin, *int_end, *frac_begin = NULL, *frac_end = NULL;
+	long exp = 0;
+	int exp_neg = 0;
+
+	if (p < end && *p == '-') {
+		p++;
+	}
+	int_begin = p;
+	if (p == end || !ISDIGIT(*p)) {
+		return LEPT_PARSE_INVALID_VALUE;
+	}
+	if (*p == '0') {
+		p++;
+	} else {
+		while (p < end && ISDIGIT(*p)) {
+			p++;
+		}
+	}
+	int_end = p;
+	if (p < end && *p == '.') {
+		p++;
+		if (p == end || !ISDIGIT(*p)) {
+			*pp = p;
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+		frac_begin = p;
+		while (p < end && ISDIGIT(*p)) {
+			p++;
+		}
+		frac_end = p;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < end && (*p == '+' || *p == '-')) {
+			exp_neg = *p++ == '-';
+		}
+		if (p == end || !ISDIGIT(*p)) {
+			*pp = p;
+			return LEPT_PARSE_INVALID_VALUE;
+		}
+		while (p < end && ISDIGIT(*p)) {
+			if (exp < 100000) {
+				exp = exp * 10 + (*p - '0');
+			}
+			p++;
+		}
+	}
+	if (frac_begin == NULL) {
+		frac_begin = frac_end = int_end;
+	}
+	if (lept_scan_number_too_big(int_begin, int_end, frac_begin, frac_end, exp_neg ? -exp : exp)) {
+		return LEPT_PARSE_NUMBER_TOO_BIG;
+	}
+	*pp = p;
+	return LEPT_PARSE_OK;
+}
+
+static int lept_scan_literal(const char** pp, const char* end, const char* literal, size_t n) {
+	if ((size_t)(end - *pp) < n || memcmp(*pp, literal, n) != 0) {
+		return LEPT_PARSE_INVALID_VALUE;
+	}
+	*pp += n;
+	return LEPT_PARSE_OK;
+}
+
+/**
+ * 扫描状态：期待一个值、期待对象的键、一个值刚结束。
+ */
+enum {
+	LEPT_SCAN_VALUE,
+	LEPT_SCAN_KEY,
+	LEPT_SCAN_AFTER_VALUE
+};
+
+#define STACK_SET(stack, i, obj) do {\
+		if (obj) (stack)[(i) >> 3] |= (unsigned char)(1u << ((i) & 7));\
+		else (stack)[(i) >> 3] &= (unsigned char)~(1u << ((i) & 7));\
+	} while(0)
+#define STACK_IS_OBJECT(stack, i) (((stack)[(i) >> 3] >> ((i) & 7)) & 1)
+
+/**
+ * 扫描从 *pp 开始的值。whole 为真时值之后只能有空白，否则在值结束处停下。
+ * 返回时 *pp 指向停下或出错的位置，*po 移到输出的结尾。
+ */
+static int lept_scan_from(const char** pp, const char* end, char** po, int whole) {
+	const char* p = *pp;
+	char* o = *po;
+	unsigned char stack[(LEPT_SCAN_MAX_DEPTH + 7) / 8];
+	size_t depth = 0;
+	int state = LEPT_SCAN_VALUE, ret = LEPT_PARSE_OK, obj;
+
+	p = lept_scan_whitespace(p, end);
+	while (ret == LEPT_PARSE_OK) {
+		if (state == LEPT_SCAN_VALUE) {
+			if (p == end) {
+				ret = LEPT_PARSE_EXPECT_VALUE;
+			} else if (*p == '{' || *p == '[') {
+				obj = *p == '{';
+				if (depth == LEPT_SCAN_MAX_DEPTH) {
+					ret = LEPT_PARSE_DEPTH_EXCEEDED;
+					break;
+				}
+				STACK_SET(stack, depth, obj);
+				depth++;
+				EMIT(o, *p);
+				p++;
+				p = lept_scan_whitespace(p, end);
+				if (p < end && *p == (obj ? '}' : ']')) {
+					EMIT(o, *p);
+					p++;
+					depth--;
+					state = LEPT_SCAN_AFTER_VALUE;
+				} else {
+					state = obj ? LEPT_SCAN_KEY : LEPT_SCAN_VALUE;
+				}
+			} else {
+				const char* start = p;
+				char first = *p;	// 原地压缩时字符串的输出可能覆盖 *start
+				switch (first) {
+					case '"': ret = lept_scan_string(&p, end, &o); break;
+					case 'n': ret = lept_scan_literal(&p, end, "null", 4); break;
+					case 't': ret = lept_scan_literal(&p, end, "true", 4); break;
+					case 'f': ret = lept_scan_literal(&p, end, "false", 5); break;
+					default:  ret = lept_scan_number(&p, end); break;
+				}
+				if (ret == LEPT_PARSE_OK && o && first != '"') {
+					memmove(o, start, (size_t)(p - start));
+					o += p - start;
+				}
+				state = LEPT_SCAN_AFTER_VALUE;
+			}
+		} else if (state == LEPT_SCAN_KEY) {
+			p = lept_scan_whitespace(p, end);
+			if (p == end || *p != '"') {
+				ret = LEPT_PARSE_MISS_KEY;
+				break;
+			}
+			if ((ret = lept_scan_string(&p, end, &o)) != LEPT_PARSE_OK) {
+				break;
+			}
+			p = lept_scan_whitespace(p, end);
+			if (p == end || *p != ':') {
+				ret = LEPT_PARSE_MISS_COLON;
+				break;
+			}
+			EMIT(o, *p);
+			p++;
+			p = lept_scan_whitespace(p, end);
+			state = LEPT_SCAN_VALUE;
+		} else {
+			if (depth == 0 && !whole) {
+				break;
+			}
+			p = lept_scan_whitespace(p, end);
+			if (depth == 0) {
+				if (p != end) {
+					ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+				}
+				break;
+			}
+			obj = STACK_IS_OBJECT(stack, depth - 1);
+			if (p < end && *p == ',') {
+				EMIT(o, *p);
+				p++;
+				p = lept_scan_whitespace(p, end);
+				state = obj ? LEPT_SCAN_KEY : LEPT_SCAN_VALUE;
+			} else if (p < end && *p == (obj ? '}' : ']')) {
+				EMIT(o, *p);
+				p++;
+				depth--;
+			} else {
+				ret = obj ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+			}
+		}
+	}
+
+	*pp = p;
+	*po = o;
+	return ret;
+}
+
+int lept_scan(const char* in, size_t len, char* out, size_t* out_len, const char** err_pos) {
+	assert(in != NULL || len == 0);
+	const char* p = in;
+	char* o = out;
+	int ret = lept_scan_from(&p, in + len, &o, 1);
+
+	if (out_len) {
+		*out_len = ret == LEPT_PARSE_OK && out ? (size_t)(o - out) : 0;
+	}
+	if (err_pos) {
+		*err_pos = ret == LEPT_PARSE_OK ? NULL : p;
+	}
+	return ret;
+}
+
+int lept_scan_value(const char** pp, const char* end) {
+	char* o = NULL;
+	assert(pp != NULL && *pp != NULL);
+	return lept_scan_from(pp, end, &o, 0);
+}
+
+#ifdef LEPT_SCAN_SSE2
+/**
+ * 16 字节中引号和括号对应的位。'[' 和 ']' 或上 0x20 正好是 '{' 和 '}'。
+ */
+static inline unsigned lept_skip_special_mask(__m128i x) {
+	__m128i folded = _mm_or_si128(x, _mm_set1_epi8(0x20));
+	return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')),
+		_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}')))));
+}
+#endif
+
+/**
+ * 跳到下一个引号或括号。
+ */
+static const char* lept_skip_plain(const char* p, const char* end) {
+#ifdef LEPT_SCAN_SSE2
+	while (end - p >= 16) {
+		unsigned mask = lept_skip_special_mask(_mm_loadu_si128((const __m128i*)p));
+		if (mask != 0) {
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
+	}
+#endif
+	while (p < end && *p != '"' && (*p | 0x20) != '{' && (*p | 0x20) != '}') {
+		p++;
+	}
+	return p;
+}
+
+/**
+ * 跳过字符串的剩余部分，p 指向开头引号之后。只认转义，不检查内容。
+ * @return 结尾引号之后的位置，没有结尾引号时返回 NULL。
+ */
+static const char* lept_skip_string(const char* p, const char* end) {
+	for (;;) {
+#ifdef LEPT_SCAN_SSE2
+		while (end - p >= 16) {
+			__m128i x = _mm_loadu_si128((const __m128i*)p);
+			unsigned mask = (unsigned)_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\\'))));
+			if (mask != 0) {
+				p += __builtin_ctz(mask);
+				break;
+			}
+			p += 16;
+		}
+#endif
+		while (p < end && *p != '"' && *p != '\\') {
+			p++;
+		}
+		if (p == end) {
+			return NULL;
+		}
+		if (*p == '"') {
+			return p + 1;
+		}
+		if (end - p < 2) {
+			return NULL;
+		}
+		p += 2;
+	}
+}
+
+int lept_skip_value(const char** pp, const char* end) {
+	const char* p = *pp;
+	size_t depth = 0;
+	char open;
+
+	assert(pp != NULL && *pp != NULL);
+	if (p == end) {
+		return LEPT_PARSE_EXPECT_VALUE;
+	}
+	open = *p;
+	if (open == '"') {
+		if ((p = lept_skip_string(p + 1, end)) == NULL) {
+			*pp = end;
+			return LEPT_PARSE_MISS_QUOTATION_MARK;
+		}
+		*pp = p;
+		return LEPT_PARSE_OK;
+	}
+	if (open != '{' && open != '[') {
+		/* 数字和字面量：走到分隔符为止 */
+		while (p < end && *p != ',' && *p != '}' && *p != ']' && !ISWHITESPACE(*p)) {
+			p++;
+		}
+		if (p == *pp) {
+			return LEPT_PARSE_EXPECT_VALUE;
+		}
+		*pp = p;
+		return LEPT_PARSE_OK;
+	}
+	for (;;) {
+		p = lept_skip_plain(p, end);
+		if (p == end) {
+			*pp = end;
+			return open == '{' ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+		}
+		if (*p == '"') {
+			if ((p = lept_skip_string(p + 1, end)) == NULL) {
+				*pp = end;
+				return LEPT_PARSE_MISS_QUOTATION_MARK;
+			}
+		} else if (*p == '{' || *p == '[') {
+			depth++;
+			p++;
+		} else {
+			p++;
+			if (--depth == 0) {
+				*pp = p;
+				return LEPT_PARSE_OK;
+			}
+		}
+	}
+}
+
+int lept_minify(const char* in, size_t len, char* out, size_t* out_len) {
+	assert(out != NULL);
+	return lept_scan(in, len, out, out_len, NULL);
+}
+
+int lept_validate(const char* json, size_t len, size_t* error_offset) {
+	const char* err;
+	int ret = lept_scan(json, len, NULL, NULL, &err);
+	if (ret != LEPT_PARSE_OK && error_offset) {
+		*error_offset = (size_t)(err - json);
+	}
+	return ret;
+}
@@ -0,0 +1,75 @@
+#ifndef LEPTSCAN_H__
+#define LEPTSCAN_H__
+
+#include <stddef.h> // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 不建树的 JSON 扫描，供 lept_parse 和 lept_minify 等共用。
+ * 输入都带长度，不要求以 '\0' 结尾，扫描过程中不分配内存。
+ */
+
+#ifndef LEPT_SCAN_MAX_DEPTH
+#define LEPT_SCAN_MAX_DEPTH 1024	// 嵌套深度上限，扫描只用一个固定大小的位栈。
+#endif
+
+/**
+ * 把 4 个十六进制数字转换成码点。
+ * 遇到非十六进制字符即停止，所以以 '\0' 结尾的输入不需要额外的边界检查。
+ * @return 正确返回下一个需要解析的字符，错误则返回 NULL.
+ */
+const char* lept_parse_hex4(const char* p, unsigned* u);
+
+/**
+ * 解析 \u 之后的部分，包括代理对（surrogate pair）。
+ * @param pp 		指向 \u 之后的第一个字符，成功后移到转义序列之后。
+ * @param end 		输入结尾，为 NULL 时表示输入以 '\0' 结尾。
+ * @param u 		接收码点。
+ * @return 			LEPT_PARSE_OK，LEPT_PARSE_INVALID_UNICODE_HEX 或 LEPT_PARSE_INVALID_UNICODE_SURROGATE。
+ */
+int lept_scan_unicode(const char** pp, const char* end, unsigned* u);
+
+/**
+ * 跳过以 '\0' 结尾的输入中的空白，返回第一个非空白字符。
+ * 用 SSE2 每次检查 32 字节，给长段缩进用；只有一个空格的情况由调用方先处理。
+ */
+const char* lept_skip_whitespace(const char* p);
+
+/**
+ * 检查 [s, s + len) 是否为合法的 UTF-8。
+ * CPU 支持 SSSE3 时用查表法每次检查 16 字节，否则逐字节检查，两者都有纯 ASCII 的快速路径。
+ * @return 			LEPT_PARSE_OK 或 LEPT_PARSE_INVALID_UTF8。
+ */
+int lept_scan_utf8(const char* s, size_t len);
+
+/**
+ * 按 JSON 语法扫描 [in, in + len)。
+ * @param out 		不为 NULL 时输出去掉空白后的文本，可以和 in 相同。
+ * @param out_len 	接收输出长度，可以为 NULL。
+ * @param err_pos 	出错时接收出错的位置，可以为 NULL。
+ * @return 			LEPT_PARSE_OK 或 lept_error_type。
+ */
+int lept_scan(const char* in, size_t len, char* out, size_t* out_len, const char** err_pos);
+
+/**
+ * 按 JSON 语法扫描 *pp 开始的一个值，在值结束处停下，之后的内容不检查。
+ * 返回时 *pp 指向值之后或者出错的位置。
+ * @return 			LEPT_PARSE_OK 或 lept_error_type。
+ */
+int lept_scan_value(const char** pp, const char* end);
+
+/**
+ * 不做检查地跳过 *pp 开始的一个值，只认字符串和括号的嵌套，不限制深度。
+ * 输入不合法时可能停在任何位置，只保证不越过 end。
+ * @return 			LEPT_PARSE_OK，或者值缺失、字符串和括号没有结束时的 lept_error_type。
+ */
+int lept_skip_value(const char** pp, const char* end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#include "leptshared.h"
+#include <assert.h> /* assert() */
+#include <stdlib.h> /* NULL, malloc(), free() */
+#include <stdatomic.h>
+
+/**
+ * 根句柄的 parent 为 NULL，value 指向自己的 root；
+ * 子树句柄的 value 指向父句柄树中的某个节点。
+ */
+struct lept_shared {
+	atomic_size_t refcount;
+	lept_shared* parent;
+	const lept_value* value;
+	lept_value root;
+};
+
+lept_shared* lept_shared_new(lept_value* v) {
+	assert(v != NULL);
+	lept_shared* s = (lept_shared*)malloc(sizeof(lept_shared));
+
+	atomic_init(&s->refcount, 1);
+	s->parent = NULL;
+	lept_init(&s->root);
+	lept_move(&s->root, v);
+	s->value = &s->root;
+	return s;
+}
+
+lept_shared* lept_shared_child(lept_shared* parent, const lept_value* v) {
+	assert(parent != NULL && v != NULL);
+	lept_shared* s = (lept_shared*)malloc(sizeof(lept_shared));
+
+	atomic_init(&s->refcount, 1);
+	s->parent = lept_shared_retain(parent);
+	lept_init(&s->root);
+	s->value = v;
+	return s;
+}
+
+lept_shared* lept_shared_retain(lept_shared* s) {
+	assert(s != NULL);
+	/* 调用方已经持有引用，计数不会在这里变成 0，不需要同步 */
+	atomic_fetch_add_explicit(&s->refcount, 1, memory_order_relaxed);
+	return s;
+}
+
+void lept_shared_release(lept_shared* s) {
+	lept_shared* parent;
+
+	while (s != NULL) {
+		/* release 保证之前的读取都发生在释放之前，acquire 让最后一个引用看到它们 */
+		if (atomic_fetch_sub_explicit(&s->refcount, 1, memory_order_acq_rel) != 1) {
+			return;
+		}
+		parent = s->parent;
+		lept_free(&s->root);
+		free(s);
+		s = parent;
+	}
+}
+
+const lept_value* lept_shared_get(const lept_shared* s) {
+	assert(s != NULL);
+	return s->value;
+}
+
+size_t lept_shared_refcount(const lept_shared* s) {
+	assert(s != NULL);
+	return atomic_load_explicit(&s->refcount, memory_order_relaxed);
+}
@@ -0,0 +1,57 @@
+#ifndef LEPTSHARED_H__
+#define LEPTSHARED_H__
+
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 引用计数的只读 lept_value 子树，用于在多个线程、多个请求之间共享同一份解析结果。
+ *
+ * lept_shared_new 接管一棵树，之后这棵树不能再修改。句柄可以指向根，
+ * 也可以用 lept_shared_child 指向其中的一个子树；子树句柄持有父句柄的引用，
+ * 所以整棵树在最后一个句柄释放时才被释放。retain/release 是原子操作，
+ * 共享一次的代价是 O(1)，不需要深拷贝。
+ *
+ * 通过 lept_shared_get 拿到的 const lept_value* 可以在任意线程同时用
+ * lept_get_* 等 const 访问函数读取；数组元素用 lept_get_array_element（不会转换存储），
+ * 紧凑数组保持紧凑，用 lept_get_array_number 读取。
+ */
+
+typedef struct lept_shared lept_shared;
+
+/**
+ * 接管 v 的内容（v 变为 null），返回引用计数为 1 的根句柄。
+ */
+lept_shared* lept_shared_new(lept_value* v);
+
+/**
+ * 为 parent 中的子树 v 创建引用计数为 1 的句柄，v 必须属于 parent 指向的树。
+ * 新句柄持有 parent 的一个引用。
+ */
+lept_shared* lept_shared_child(lept_shared* parent, const lept_value* v);
+
+/**
+ * 增加引用计数，返回 s 本身。
+ */
+lept_shared* lept_shared_retain(lept_shared* s);
+
+/**
+ * 减少引用计数，减到 0 时释放句柄，根句柄还会释放整棵树。
+ */
+void lept_shared_release(lept_shared* s);
+
+const lept_value* lept_shared_get(const lept_shared* s);
+
+/**
+ * 当前的引用计数，只用于调试和测试，多线程下读到的值可能马上过时。
+ */
+size_t lept_shared_refcount(const lept_shared* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
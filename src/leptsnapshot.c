@@ -0,0 +1,345 @@
+#define _POSIX_C_SOURCE 200112L /* open, fstat, mmap */
+#include "leptsnapshot.h"
+#include <assert.h> /* assert() */
+#include <stdint.h> /* uint32_t, uint64_t */
+#include <stdio.h> /* FILE, fopen(), fwrite() */
+#include <stdlib.h> /* NULL, malloc(), free() */
+#include <string.h> /* memcpy, memcmp, memset */
+#include <fcntl.h> /* open */
+#include <unistd.h> /* close */
+#include <sys/mman.h> /* mmap, munmap */
+#include <sys/stat.h> /* fstat */
+
+#define LEPT_SNAPSHOT_MAGIC "LEPTSNAP"
+#define LEPT_SNAPSHOT_ENDIAN 0x01020304u
+
+/**
+ * 镜像头部，位于镜像开头。
+ * checksum 覆盖头部之后的全部字节。
+ */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t endian;
+	uint64_t size;
+	uint64_t checksum;
+} lept_snapshot_header;
+
+/**
+ * 镜像中的节点，24 字节，8 字节对齐。
+ * 		number: a 为 double 的位模式
+ * 		string: a 为字符串相对本节点的偏移, b 为长度（不含结尾的 '\0'）
+ * 		array:  a 为节点数组相对本节点的偏移, b 为元素个数
+ * 		object: a 为成员数组相对本节点的偏移, b 为成员个数
+ * 子数据总是排在父节点之后，所以偏移都是正数。
+ */
+struct lept_snapshot_value {
+	uint64_t a;
+	uint64_t b;
+	uint32_t type;
+	uint32_t reserved;
+};
+
+typedef struct {
+	uint64_t k;			// 键相对本成员的偏移
+	uint64_t klen;
+	lept_snapshot_value v;
+} lept_snapshot_member;
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+#define AT(node, off) ((const char*)(node) + (off))
+
+/**
+ * 64 位校验和，每次处理 8 字节。只用来发现损坏的镜像，不是加密哈希。
+ */
+static uint64_t lept_snapshot_checksum(const char* p, size_t len) {
+	uint64_t h = 0x243F6A8885A308D3ULL ^ len, w;
+	size_t i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&w, p + i, 8);
+		h ^= w * 0x9E3779B97F4A7C15ULL;
+		h = ((h << 31) | (h >> 33)) * 0xBF58476D1CE4E5B9ULL;
+	}
+	for (; i < len; ++i) {
+		h = (h ^ (unsigned char)p[i]) * 0x100000001B3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * 第一遍：计算 v 的子数据（不含 v 本身的节点）需要的字节数。
+ */
+static size_t lept_snapshot_extra_size(const lept_value* v) {
+	size_t i, size = 0;
+
+	switch (v->type) {
+		case LEPT_STRING:
+			return ALIGN8(v->u.s.len + 1);
+		case LEPT_ARRAY:
+			if (v->flags & LEPT_VALUE_PACKED) {
+				return v->u.p.size * sizeof(lept_snapshot_value);
+			}
+			size = v->u.a.size * sizeof(lept_snapshot_value);
+			for (i = 0; i < v->u.a.size; ++i) {
+				size += lept_snapshot_extra_size(&v->u.a.e[i]);
+			}
+			return size;
+		case LEPT_OBJECT:
+			size = v->u.o.size * sizeof(lept_snapshot_member);
+			for (i = 0; i < v->u.o.size; ++i) {
+				size += ALIGN8(v->u.o.m[i].klen + 1);
+				size += lept_snapshot_extra_size(&v->u.o.m[i].v);
+			}
+			return size;
+		default:
+			return 0;
+	}
+}
+
+static void lept_snapshot_set_number(lept_snapshot_value* n, double d) {
+	n->type = LEPT_NUMBER;
+	memcpy(&n->a, &d, sizeof(d));
+}
+
+/**
+ * 第二遍：写入节点 n，子数据从 *bump 开始依次分配。
+ */
+static void lept_snapshot_fill(char* image, size_t* bump, lept_snapshot_value* n, const lept_value* v) {
+	size_t i, off;
+
+	memset(n, 0, sizeof(*n));
+	n->type = v->type;
+	switch (v->type) {
+		case LEPT_NUMBER:
+			lept_snapshot_set_number(n, lept_get_number(v));
+			break;
+		case LEPT_STRING:
+			off = *bump;
+			*bump += ALIGN8(v->u.s.len + 1);
+			memcpy(image + off, v->u.s.s, v->u.s.len);
+			image[off + v->u.s.len] = '\0';
+			n->a = off - (size_t)((char*)n - image);
+			n->b = v->u.s.len;
+			break;
+		case LEPT_ARRAY: {
+			lept_snapshot_value* e;
+			size_t size = lept_get_array_size(v);
+			off = *bump;
+			*bump += size * sizeof(lept_snapshot_value);
+			e = (lept_snapshot_value*)(image + off);
+			n->a = off - (size_t)((char*)n - image);
+			n->b = size;
+			for (i = 0; i < size; ++i) {
+				if (v->flags & LEPT_VALUE_PACKED) {
+					memset(&e[i], 0, sizeof(e[i]));
+					lept_snapshot_set_number(&e[i], v->u.p.n[i]);
+				} else {
+					lept_snapshot_fill(image, bump, &e[i], &v->u.a.e[i]);
+				}
+			}
+			break;
+		}
+		case LEPT_OBJECT: {
+			lept_snapshot_member* m;
+			off = *bump;
+			*bump += v->u.o.size * sizeof(lept_snapshot_member);
+			m = (lept_snapshot_member*)(image + off);
+			n->a = off - (size_t)((char*)n - image);
+			n->b = v->u.o.size;
+			for (i = 0; i < v->u.o.size; ++i) {
+				const lept_member* src = &v->u.o.m[i];
+				off = *bump;
+				*bump += ALIGN8(src->klen + 1);
+				memcpy(image + off, src->k, src->klen);
+				image[off + src->klen] = '\0';
+				m[i].k = off - (size_t)((char*)&m[i] - image);
+				m[i].klen = src->klen;
+				lept_snapshot_fill(image, bump, &m[i].v, &src->v);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+char* lept_snapshot_create(const lept_value* v, size_t* length) {
+	assert(v != NULL && length != NULL);
+	lept_snapshot_header* h;
+	size_t size, bump;
+	char* image;
+
+	size = sizeof(lept_snapshot_header) + sizeof(lept_snapshot_value) + lept_snapshot_extra_size(v);
+	/* 填充字节也参与校验和，先清零保证镜像内容确定 */
+	image = (char*)calloc(1, size);
+	bump = sizeof(lept_snapshot_header) + sizeof(lept_snapshot_value);
+	lept_snapshot_fill(image, &bump, (lept_snapshot_value*)(image + sizeof(lept_snapshot_header)), v);
+	assert(bump == size);
+
+	h = (lept_snapshot_header*)image;
+	memcpy(h->magic, LEPT_SNAPSHOT_MAGIC, sizeof(h->magic));
+	h->version = LEPT_SNAPSHOT_VERSION;
+	h->endian = LEPT_SNAPSHOT_ENDIAN;
+	h->size = size;
+	h->checksum = lept_snapshot_checksum(image + sizeof(lept_snapshot_header), size - sizeof(lept_snapshot_header));
+
+	*length = size;
+	return image;
+}
+
+int lept_snapshot_write(const lept_value* v, const char* path) {
+	assert(v != NULL && path != NULL);
+	size_t len;
+	char* image = lept_snapshot_create(v, &len);
+	FILE* fp;
+	int ret = LEPT_SNAPSHOT_IO_ERROR;
+
+	if ((fp = fopen(path, "wb")) != NULL) {
+		if (fwrite(image, 1, len, fp) == len) {
+			ret = LEPT_SNAPSHOT_OK;
+		}
+		if (fclose(fp) != 0) {
+			ret = LEPT_SNAPSHOT_IO_ERROR;
+		}
+	}
+	free(image);
+	return ret;
+}
+
+int lept_snapshot_open(const lept_snapshot_value** root, const void* image, size_t len, int verify) {
+	assert(root != NULL && image != NULL);
+	const lept_snapshot_header* h = (const lept_snapshot_header*)image;
+	const char* p = (const char*)image;
+
+	*root = NULL;
+	if (len < sizeof(lept_snapshot_header) + sizeof(lept_snapshot_value)
+			|| memcmp(h->magic, LEPT_SNAPSHOT_MAGIC, sizeof(h->magic)) != 0
+			|| h->endian != LEPT_SNAPSHOT_ENDIAN
+			|| h->size != len) {
+		return LEPT_SNAPSHOT_INVALID_HEADER;
+	}
+	if (h->version != LEPT_SNAPSHOT_VERSION) {
+		return LEPT_SNAPSHOT_VERSION_MISMATCH;
+	}
+	if (verify && lept_snapshot_checksum(p + sizeof(lept_snapshot_header), len - sizeof(lept_snapshot_header)) != h->checksum) {
+		return LEPT_SNAPSHOT_CHECKSUM_MISMATCH;
+	}
+	*root = (const lept_snapshot_value*)(p + sizeof(lept_snapshot_header));
+	return LEPT_SNAPSHOT_OK;
+}
+
+int lept_snapshot_map(lept_snapshot_mapping* m, const char* path) {
+	assert(m != NULL && path != NULL);
+	struct stat st;
+	int fd;
+
+	m->addr = NULL;
+	m->len = 0;
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return LEPT_SNAPSHOT_IO_ERROR;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return LEPT_SNAPSHOT_IO_ERROR;
+	}
+	m->addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	/* 映射建立之后就不再需要文件描述符了 */
+	close(fd);
+	if (m->addr == MAP_FAILED) {
+		m->addr = NULL;
+		return LEPT_SNAPSHOT_IO_ERROR;
+	}
+	m->len = (size_t)st.st_size;
+	return LEPT_SNAPSHOT_OK;
+}
+
+void lept_snapshot_unmap(lept_snapshot_mapping* m) {
+	assert(m != NULL);
+	if (m->addr != NULL) {
+		munmap(m->addr, m->len);
+		m->addr = NULL;
+		m->len = 0;
+	}
+}
+
+lept_type lept_snapshot_get_type(const lept_snapshot_value* v) {
+	assert(v != NULL);
+	return (lept_type)v->type;
+}
+
+double lept_snapshot_get_number(const lept_snapshot_value* v) {
+	assert(v != NULL && v->type == LEPT_NUMBER);
+	double d;
+	memcpy(&d, &v->a, sizeof(d));
+	return d;
+}
+
+int lept_snapshot_get_boolean(const lept_snapshot_value* v) {
+	assert(v != NULL && (v->type == LEPT_FALSE || v->type == LEPT_TRUE));
+	return v->type;
+}
+
+const char* lept_snapshot_get_string(const lept_snapshot_value* v) {
+	assert(v != NULL && v->type == LEPT_STRING);
+	return AT(v, v->a);
+}
+
+size_t lept_snapshot_get_string_length(const lept_snapshot_value* v) {
+	assert(v != NULL && v->type == LEPT_STRING);
+	return (size_t)v->b;
+}
+
+size_t lept_snapshot_get_array_size(const lept_snapshot_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	return (size_t)v->b;
+}
+
+const lept_snapshot_value* lept_snapshot_get_array_element(const lept_snapshot_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_ARRAY && index < v->b);
+	return (const lept_snapshot_value*)AT(v, v->a) + index;
+}
+
+size_t lept_snapshot_get_object_size(const lept_snapshot_value* v) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	return (size_t)v->b;
+}
+
+static const lept_snapshot_member* lept_snapshot_member_at(const lept_snapshot_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_OBJECT && index < v->b);
+	return (const lept_snapshot_member*)AT(v, v->a) + index;
+}
+
+const char* lept_snapshot_get_object_key(const lept_snapshot_value* v, size_t index) {
+	const lept_snapshot_member* m = lept_snapshot_member_at(v, index);
+	return AT(m, m->k);
+}
+
+size_t lept_snapshot_get_object_key_length(const lept_snapshot_value* v, size_t index) {
+	return (size_t)lept_snapshot_member_at(v, index)->klen;
+}
+
+const lept_snapshot_value* lept_snapshot_get_object_value(const lept_snapshot_value* v, size_t index) {
+	return &lept_snapshot_member_at(v, index)->v;
+}
+
+size_t lept_snapshot_find_object_index(const lept_snapshot_value* v, const char* key, size_t klen) {
+	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	const lept_snapshot_member* m = (const lept_snapshot_member*)AT(v, v->a);
+	size_t i;
+
+	for (i = 0; i < v->b; ++i) {
+		if (m[i].klen == klen && memcmp(AT(&m[i], m[i].k), key, klen) == 0) {
+			return i;
+		}
+	}
+	return LEPT_KEY_NOT_EXIST;
+}
+
+const lept_snapshot_value* lept_snapshot_find_object_value(const lept_snapshot_value* v, const char* key, size_t klen) {
+	size_t index = lept_snapshot_find_object_index(v, key, klen);
+	return index != LEPT_KEY_NOT_EXIST ? lept_snapshot_get_object_value(v, index) : NULL;
+}
@@ -0,0 +1,87 @@
+#ifndef LEPTSNAPSHOT_H__
+#define LEPTSNAPSHOT_H__
+
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 文档快照：把解析好的 lept_value 树序列化成一块与位置无关的镜像。
+ * 镜像内部用相对偏移代替指针，可以直接 mmap 只读映射后查询，
+ * 多个进程映射同一个文件时通过页缓存共享内存，不需要再解析。
+ *
+ * 镜像开头是固定的头部（魔数、版本、字节序、大小、校验和），
+ * 数据按本机字节序存放，打开时会检查字节序是否一致。
+ */
+
+#define LEPT_SNAPSHOT_VERSION 1
+
+typedef enum {
+	LEPT_SNAPSHOT_OK = 0,
+	LEPT_SNAPSHOT_INVALID_HEADER,		// 魔数、大小或字节序不对。
+	LEPT_SNAPSHOT_VERSION_MISMATCH,
+	LEPT_SNAPSHOT_CHECKSUM_MISMATCH,
+	LEPT_SNAPSHOT_IO_ERROR
+} lept_snapshot_error;
+
+/**
+ * 镜像中的一个值，结构对使用者不透明，只能通过 lept_snapshot_get_* 访问。
+ */
+typedef struct lept_snapshot_value lept_snapshot_value;
+
+/**
+ * 生成镜像，返回 malloc 分配的缓冲区，由调用方 free。
+ * 紧凑数字数组在镜像中按普通数组存放。
+ * @param length 	接收镜像的字节数。
+ */
+char* lept_snapshot_create(const lept_value* v, size_t* length);
+
+/**
+ * 生成镜像并写入文件。
+ */
+int lept_snapshot_write(const lept_value* v, const char* path);
+
+/**
+ * 检查镜像头部，成功时 *root 指向根节点。
+ * image 必须按 8 字节对齐（malloc 和 mmap 返回的地址都满足）。
+ * @param verify 	非 0 时校验整个镜像的校验和，需要读一遍全部数据。
+ */
+int lept_snapshot_open(const lept_snapshot_value** root, const void* image, size_t len, int verify);
+
+/**
+ * 只读映射快照文件。映射使用 MAP_SHARED，多个进程共享同一份物理内存。
+ */
+typedef struct {
+	void* addr;
+	size_t len;
+} lept_snapshot_mapping;
+
+int lept_snapshot_map(lept_snapshot_mapping* m, const char* path);
+void lept_snapshot_unmap(lept_snapshot_mapping* m);
+
+/**
+ * 只读访问接口，和 lept_get_* 一一对应。
+ */
+lept_type lept_snapshot_get_type(const lept_snapshot_value* v);
+double lept_snapshot_get_number(const lept_snapshot_value* v);
+int lept_snapshot_get_boolean(const lept_snapshot_value* v);
+const char* lept_snapshot_get_string(const lept_snapshot_value* v);
+size_t lept_snapshot_get_string_length(const lept_snapshot_value* v);
+
+size_t lept_snapshot_get_array_size(const lept_snapshot_value* v);
+const lept_snapshot_value* lept_snapshot_get_array_element(const lept_snapshot_value* v, size_t index);
+
+size_t lept_snapshot_get_object_size(const lept_snapshot_value* v);
+const char* lept_snapshot_get_object_key(const lept_snapshot_value* v, size_t index);
+size_t lept_snapshot_get_object_key_length(const lept_snapshot_value* v, size_t index);
+const lept_snapshot_value* lept_snapshot_get_object_value(const lept_snapshot_value* v, size_t index);
+size_t lept_snapshot_find_object_index(const lept_snapshot_value* v, const char* key, size_t klen);
+const lept_snapshot_value* lept_snapshot_find_object_value(const lept_snapshot_value* v, const char* key, size_t klen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,788 @@
+#include "leptwriter.h"
+#include "leptcontext.h"
+#include <assert.h> /* assert() */
+#include <errno.h> /* errno, EINTR */
+#include <stdio.h> /* fwrite(), snprintf() */
+#include <stdlib.h> /* NULL */
+#include <string.h> /* memcpy */
+#include <unistd.h> /* write(), sysconf() */
+#include <limits.h> /* IOV_MAX */
+#include <math.h> /* isfinite() */
+#include <pthread.h>
+#include <sys/uio.h> /* writev() */
+
+/**
+ * state 中每层容器的状态位。
+ */
+#define LEPT_WRITER_OBJECT		0x1		// 当前容器是对象
+#define LEPT_WRITER_NOT_EMPTY	0x2		// 已经写过元素，下一个元素前要加逗号
+#define LEPT_WRITER_AFTER_KEY	0x4		// 对象中已写了键，等待写值
+
+static int lept_writer_file_write(void* userdata, const char* data, size_t len) {
+	lept_writer* w = (lept_writer*)userdata;
+	return fwrite(data, 1, len, w->fp) != len;
+}
+
+static int lept_writer_fd_write(void* userdata, const char* data, size_t len) {
+	lept_writer* w = (lept_writer*)userdata;
+	while (len > 0) {
+		ssize_t n = write(w->fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 1;
+		}
+		data += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+void lept_writer_init_callback(lept_writer* w, lept_write_func func, void* userdata) {
+	assert(w != NULL && func != NULL);
+	w->len = 0;
+	w->write = func;
+	w->userdata = userdata;
+	w->fp = NULL;
+	w->fd = -1;
+	w->indent = 0;
+	w->depth = 0;
+	w->error = LEPT_WRITER_OK;
+}
+
+void lept_writer_init_file(lept_writer* w, FILE* fp) {
+	assert(fp != NULL);
+	lept_writer_init_callback(w, lept_writer_file_write, w);
+	w->fp = fp;
+}
+
+void lept_writer_init_fd(lept_writer* w, int fd) {
+	assert(fd >= 0);
+	lept_writer_init_callback(w, lept_writer_fd_write, w);
+	w->fd = fd;
+}
+
+void lept_writer_set_pretty(lept_writer* w, int indent) {
+	assert(w != NULL && indent >= 0);
+	w->indent = indent;
+}
+
+int lept_writer_flush(lept_writer* w) {
+	assert(w != NULL);
+	if (w->error == LEPT_WRITER_OK && w->len > 0 && w->write(w->userdata, w->buffer, w->len) != 0) {
+		w->error = LEPT_WRITER_IO_ERROR;
+	}
+	w->len = 0;
+	return w->error;
+}
+
+/**
+ * 写入缓冲区，满了就先输出。比缓冲区还大的数据直接交给输出目标。
+ */
+static void lept_writer_put(lept_writer* w, const char* s, size_t len) {
+	if (w->len + len > LEPT_WRITER_BUFFER_SIZE) {
+		lept_writer_flush(w);
+		if (len > LEPT_WRITER_BUFFER_SIZE) {
+			if (w->error == LEPT_WRITER_OK && w->write(w->userdata, s, len) != 0) {
+				w->error = LEPT_WRITER_IO_ERROR;
+			}
+			return;
+		}
+	}
+	memcpy(w->buffer + w->len, s, len);
+	w->len += len;
+}
+
+static void lept_writer_put_c(lept_writer* w, char ch) {
+	if (w->len == LEPT_WRITER_BUFFER_SIZE) {
+		lept_writer_flush(w);
+	}
+	w->buffer[w->len++] = ch;
+}
+
+/**
+ * 美化输出时换行并缩进到当前层。
+ */
+static void lept_writer_newline(lept_writer* w) {
+	static const char spaces[] = "                                ";
+	size_t n = (size_t)w->indent * w->depth;
+
+	lept_writer_put_c(w, '\n');
+	while (n > 0) {
+		size_t len = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+		lept_writer_put(w, spaces, len);
+		n -= len;
+	}
+}
+
+/**
+ * 写值之前的处理：数组中补逗号和换行，对象中检查是否已经写了键。
+ */
+static int lept_writer_prefix(lept_writer* w) {
+	unsigned char* s;
+
+	if (w->error != LEPT_WRITER_OK) {
+		return w->error;
+	}
+	if (w->depth == 0) {
+		return LEPT_WRITER_OK;
+	}
+	s = &w->state[w->depth - 1];
+	if (*s & LEPT_WRITER_OBJECT) {
+		if (!(*s & LEPT_WRITER_AFTER_KEY)) {
+			return w->error = LEPT_WRITER_INVALID_STATE;
+		}
+		*s &= ~LEPT_WRITER_AFTER_KEY;
+		return LEPT_WRITER_OK;
+	}
+	if (*s & LEPT_WRITER_NOT_EMPTY) {
+		lept_writer_put_c(w, ',');
+	}
+	*s |= LEPT_WRITER_NOT_EMPTY;
+	if (w->indent > 0) {
+		lept_writer_newline(w);
+	}
+	return LEPT_WRITER_OK;
+}
+
+static int lept_writer_begin(lept_writer* w, unsigned char state, char ch) {
+	int ret;
+	if ((ret = lept_writer_prefix(w)) != LEPT_WRITER_OK) {
+		return ret;
+	}
+	if (w->depth >= LEPT_WRITER_MAX_DEPTH) {
+		return w->error = LEPT_WRITER_DEPTH_EXCEEDED;
+	}
+	w->state[w->depth++] = state;
+	lept_writer_put_c(w, ch);
+	return w->error;
+}
+
+static int lept_writer_end(lept_writer* w, unsigned char state, char ch) {
+	unsigned char s;
+
+	if (w->error != LEPT_WRITER_OK) {
+		return w->error;
+	}
+	if (w->depth == 0) {
+		return w->error = LEPT_WRITER_INVALID_STATE;
+	}
+	s = w->state[w->depth - 1];
+	if ((s & LEPT_WRITER_OBJECT) != state || (s & LEPT_WRITER_AFTER_KEY)) {
+		return w->error = LEPT_WRITER_INVALID_STATE;
+	}
+	w->depth--;
+	if (w->indent > 0 && (s & LEPT_WRITER_NOT_EMPTY)) {
+		lept_writer_newline(w);
+	}
+	lept_writer_put_c(w, ch);
+	return w->error;
+}
+
+int lept_writer_begin_object(lept_writer* w) {
+	return lept_writer_begin(w, LEPT_WRITER_OBJECT, '{');
+}
+
+int lept_writer_end_object(lept_writer* w) {
+	return lept_writer_end(w, LEPT_WRITER_OBJECT, '}');
+}
+
+int lept_writer_begin_array(lept_writer* w) {
+	return lept_writer_begin(w, 0, '[');
+}
+
+int lept_writer_end_array(lept_writer* w) {
+	return lept_writer_end(w, 0, ']');
+}
+
+/**
+ * 写入带引号的字符串。不需要转义的字符成段拷贝。
+ */
+static void lept_writer_put_string(lept_writer* w, const char* s, size_t len) {
+	static const char hex_digits[] = "0123456789ABCDEF";
+	size_t i, run = 0;
+
+	lept_writer_put_c(w, '"');
+	for (i = 0; i < len; ++i) {
+		unsigned char ch = (unsigned char)s[i];
+		char esc[6];
+		size_t esc_len = 2;
+
+		if (ch >= 0x20 && ch != '"' && ch != '\\') {
+			continue;
+		}
+		lept_writer_put(w, s + run, i - run);
+		run = i + 1;
+		esc[0] = '\\';
+		switch (ch) {
+			case '"': esc[1] = '"'; break;
+			case '\\': esc[1] = '\\'; break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default:
+				esc[1] = 'u';
+				esc[2] = '0';
+				esc[3] = '0';
+				esc[4] = hex_digits[ch >> 4];
+				esc[5] = hex_digits[ch & 15];
+				esc_len = 6;
+		}
+		lept_writer_put(w, esc, esc_len);
+	}
+	lept_writer_put(w, s + run, len - run);
+	lept_writer_put_c(w, '"');
+}
+
+int lept_writer_key(lept_writer* w, const char* key, size_t len) {
+	assert(w != NULL && (key != NULL || len == 0));
+	unsigned char* s;
+
+	if (w->error != LEPT_WRITER_OK) {
+		return w->error;
+	}
+	if (w->depth == 0 || !(w->state[w->depth - 1] & LEPT_WRITER_OBJECT)
+			|| (w->state[w->depth - 1] & LEPT_WRITER_AFTER_KEY)) {
+		return w->error = LEPT_WRITER_INVALID_STATE;
+	}
+	s = &w->state[w->depth - 1];
+	if (*s & LEPT_WRITER_NOT_EMPTY) {
+		lept_writer_put_c(w, ',');
+	}
+	*s |= LEPT_WRITER_NOT_EMPTY | LEPT_WRITER_AFTER_KEY;
+	if (w->indent > 0) {
+		lept_writer_newline(w);
+	}
+	lept_writer_put_string(w, key, len);
+	if (w->indent > 0) {
+		lept_writer_put(w, ": ", 2);
+	} else {
+		lept_writer_put_c(w, ':');
+	}
+	return w->error;
+}
+
+int lept_writer_string(lept_writer* w, const char* s, size_t len) {
+	assert(w != NULL && (s != NULL || len == 0));
+	int ret;
+	if ((ret = lept_writer_prefix(w)) == LEPT_WRITER_OK) {
+		lept_writer_put_string(w, s, len);
+		ret = w->error;
+	}
+	return ret;
+}
+
+/**
+ * 数字用 %.17g 输出，可以无损地解析回同一个 double。
+ */
+static void lept_writer_put_number(lept_writer* w, double n) {
+	char buffer[32];
+	lept_writer_put(w, buffer, (size_t)snprintf(buffer, sizeof(buffer), "%.17g", n));
+}
+
+int lept_writer_number(lept_writer* w, double n) {
+	assert(w != NULL);
+	int ret;
+	if (w->error == LEPT_WRITER_OK && !isfinite(n)) {
+		return w->error = LEPT_WRITER_INVALID_NUMBER;
+	}
+	if ((ret = lept_writer_prefix(w)) == LEPT_WRITER_OK) {
+		lept_writer_put_number(w, n);
+		ret = w->error;
+	}
+	return ret;
+}
+
+/**
+ * 照原文写出 LEPT_PARSE_RAW_NUMBERS 解析的数字，原文已经检查过语法。
+ */
+static int lept_writer_number_text(lept_writer* w, const char* text, size_t len) {
+	int ret;
+	if ((ret = lept_writer_prefix(w)) == LEPT_WRITER_OK) {
+		lept_writer_put(w, text, len);
+		ret = w->error;
+	}
+	return ret;
+}
+
+int lept_writer_boolean(lept_writer* w, int b) {
+	assert(w != NULL);
+	int ret;
+	if ((ret = lept_writer_prefix(w)) == LEPT_WRITER_OK) {
+		lept_writer_put(w, b ? "true" : "false", b ? 4 : 5);
+		ret = w->error;
+	}
+	return ret;
+}
+
+int lept_writer_null(lept_writer* w) {
+	assert(w != NULL);
+	int ret;
+	if ((ret = lept_writer_prefix(w)) == LEPT_WRITER_OK) {
+		lept_writer_put(w, "null", 4);
+		ret = w->error;
+	}
+	return ret;
+}
+
+int lept_write_value(lept_writer* w, const lept_value* v) {
+	assert(w != NULL && v != NULL);
+	size_t i, len;
+
+	switch (v->type) {
+		case LEPT_NULL:		return lept_writer_null(w);
+		case LEPT_FALSE:	return lept_writer_boolean(w, 0);
+		case LEPT_TRUE:		return lept_writer_boolean(w, 1);
+		case LEPT_NUMBER:
+			if (v->flags & LEPT_VALUE_RAW_NUMBER) {
+				const char* text = lept_get_number_text(v, &len);
+				return lept_writer_number_text(w, text, len);
+			}
+			return lept_writer_number(w, v->u.n);
+		case LEPT_STRING:	return lept_writer_string(w, v->u.s.s, v->u.s.len);
+		/* 出错之后立即返回，不再进入子节点，递归深度不会超过 LEPT_WRITER_MAX_DEPTH */
+		case LEPT_ARRAY:
+			if (lept_writer_begin_array(w) != LEPT_WRITER_OK) {
+				return w->error;
+			}
+			if (v->flags & LEPT_VALUE_PACKED) {
+				for (i = 0; i < v->u.p.size; ++i) {
+					if (lept_writer_number(w, v->u.p.n[i]) != LEPT_WRITER_OK) {
+						return w->error;
+					}
+				}
+			} else {
+				for (i = 0; i < v->u.a.size; ++i) {
+					if (lept_write_value(w, &v->u.a.e[i]) != LEPT_WRITER_OK) {
+						return w->error;
+					}
+				}
+			}
+			return lept_writer_end_array(w);
+		case LEPT_OBJECT:
+			if (lept_writer_begin_object(w) != LEPT_WRITER_OK) {
+				return w->error;
+			}
+			for (i = 0; i < v->u.o.size; ++i) {
+				if (lept_writer_key(w, v->u.o.m[i].k, v->u.o.m[i].klen) != LEPT_WRITER_OK
+						|| lept_write_value(w, &v->u.o.m[i].v) != LEPT_WRITER_OK) {
+					return w->error;
+				}
+			}
+			return lept_writer_end_object(w);
+		default:
+			assert(0 && "invalid type");
+			return LEPT_WRITER_INVALID_STATE;
+	}
+}
+
+/**
+ * lept_stringify 的输出目标：写进 lept_context 的栈。
+ */
+static int lept_stringify_write(void* userdata, const char* data, size_t len) {
+	memcpy(lept_context_push((lept_context*)userdata, len), data, len);
+	return 0;
+}
+
+char* lept_stringify_pretty(const lept_value* v, size_t* length, int indent) {
+	assert(v != NULL);
+	lept_writer w;
+	lept_context c;
+	c.json = NULL;
+	c.stack = NULL;
+	c.size = c.top = 0;
+	c.flags = 0;
+
+	lept_writer_init_callback(&w, lept_stringify_write, &c);
+	lept_writer_set_pretty(&w, indent);
+	lept_write_value(&w, v);
+	if (lept_writer_flush(&w) != LEPT_WRITER_OK) {
+		free(c.stack);
+		if (length) {
+			*length = 0;
+		}
+		return NULL;
+	}
+	if (length) {
+		*length = c.top;
+	}
+	put_c(&c, '\0');
+	return c.stack;
+}
+
+char* lept_stringify(const lept_value* v, size_t* length) {
+	return lept_stringify_pretty(v, length, 0);
+}
+
+/**
+ * 并行输出的一块：容器 v 的第 [begin, end) 个元素。
+ * depth 和 state 是写这些元素时容器所在层的状态，和串行写到这里时完全相同，
+ * 所以逗号、换行和缩进都一样。
+ */
+typedef struct {
+	const lept_value* v;
+	size_t begin, end;
+	int depth;
+	unsigned char state;
+	char* data;			// 工作线程写出的文本
+	size_t len;
+	int error;
+} lept_parallel_task;
+
+/**
+ * 输出按顺序由若干段组成：主线程写的括号、键等文本，或者一块的结果。
+ */
+typedef struct {
+	size_t offset, len;	// 文本在 literal 中的位置
+	size_t task;		// 块的下标，文本段为 LEPT_PARALLEL_LITERAL
+} lept_parallel_segment;
+
+#define LEPT_PARALLEL_LITERAL ((size_t)-1)
+
+typedef struct {
+	lept_context literal;		// 主线程写出的文本
+	lept_context segments;		// lept_parallel_segment 数组
+	lept_context tasks;			// lept_parallel_task 数组
+	size_t literal_begin;		// literal 中还没有归入段的部分的起点
+	size_t next;				// 下一个要做的块
+	pthread_mutex_t lock;
+	int indent;
+	int threads;
+} lept_parallel;
+
+static int lept_parallel_literal_write(void* userdata, const char* data, size_t len) {
+	memcpy(lept_context_push(&((lept_parallel*)userdata)->literal, len), data, len);
+	return 0;
+}
+
+static size_t lept_parallel_count(const lept_parallel* p) {
+	return p->tasks.top / sizeof(lept_parallel_task);
+}
+
+static size_t lept_parallel_size(const lept_value* v) {
+	if (v->type == LEPT_OBJECT) {
+		return v->u.o.size;
+	}
+	return v->flags & LEPT_VALUE_PACKED ? v->u.p.size : v->u.a.size;
+}
+
+/**
+ * 估计一个元素输出的字节数，只看这一层，不遍历子树。
+ */
+static size_t lept_parallel_weight(const lept_value* v, size_t i) {
+	const lept_value* e;
+	size_t w = 0;
+
+	if (v->type == LEPT_OBJECT) {
+		w = v->u.o.m[i].klen + 3;
+		e = &v->u.o.m[i].v;
+	} else if (v->flags & LEPT_VALUE_PACKED) {
+		return 24;
+	} else {
+		e = &v->u.a.e[i];
+	}
+	switch (e->type) {
+		case LEPT_NUMBER:	return w + 24;
+		case LEPT_STRING:	return w + e->u.s.len + 3;
+		case LEPT_ARRAY:
+		case LEPT_OBJECT:	return w + lept_parallel_size(e) * 24 + 2;
+		default:			return w + 5;
+	}
+}
+
+/**
+ * 把 literal 中新写的文本归为一段，再加入 [begin, end) 这一块。
+ */
+static void lept_parallel_add_task(lept_parallel* p, lept_writer* w, const lept_value* v, size_t begin, size_t end) {
+	lept_parallel_segment* seg;
+	lept_parallel_task* t;
+
+	lept_writer_flush(w);
+	if (p->literal.top > p->literal_begin) {
+		seg = (lept_parallel_segment*)lept_context_push(&p->segments, sizeof(lept_parallel_segment));
+		seg->offset = p->literal_begin;
+		seg->len = p->literal.top - p->literal_begin;
+		seg->task = LEPT_PARALLEL_LITERAL;
+		p->literal_begin = p->literal.top;
+	}
+	seg = (lept_parallel_segment*)lept_context_push(&p->segments, sizeof(lept_parallel_segment));
+	seg->offset = seg->len = 0;
+	seg->task = lept_parallel_count(p);
+
+	t = (lept_parallel_task*)lept_context_push(&p->tasks, sizeof(lept_parallel_task));
+	t->v = v;
+	t->begin = begin;
+	t->end = end;
+	t->depth = w->depth;
+	t->state = w->state[w->depth - 1];
+	t->data = NULL;
+	t->len = 0;
+	t->error = LEPT_WRITER_OK;
+	/* 主线程接着写，就像这些元素已经写过了 */
+	w->state[w->depth - 1] |= LEPT_WRITER_NOT_EMPTY;
+}
+
+/**
+ * 在主线程中模拟串行写入：小的值直接写进 literal，大的容器拆成块。
+ */
+static void lept_parallel_plan(lept_parallel* p, lept_writer* w, const lept_value* v) {
+	size_t i, b, size, total = 0, acc = 0, target;
+
+	if (v->type != LEPT_ARRAY && v->type != LEPT_OBJECT) {
+		lept_write_value(w, v);
+		return;
+	}
+	size = lept_parallel_size(v);
+	for (i = 0; i < size; ++i) {
+		total += lept_parallel_weight(v, i);
+	}
+	if (total < LEPT_PARALLEL_MIN_SPLIT || w->depth >= LEPT_WRITER_MAX_DEPTH) {
+		lept_write_value(w, v);
+		return;
+	}
+
+	if (v->type == LEPT_OBJECT) {
+		lept_writer_begin_object(w);
+	} else {
+		lept_writer_begin_array(w);
+	}
+	if (size < (size_t)p->threads * 2 && !(v->flags & LEPT_VALUE_PACKED)) {
+		/* 元素太少，拆元素本身 */
+		for (i = 0; i < size; ++i) {
+			if (v->type == LEPT_OBJECT) {
+				lept_writer_key(w, v->u.o.m[i].k, v->u.o.m[i].klen);
+				lept_parallel_plan(p, w, &v->u.o.m[i].v);
+			} else {
+				lept_parallel_plan(p, w, &v->u.a.e[i]);
+			}
+		}
+	} else {
+		/* 每个线程平均分到 8 块左右，方便负载均衡 */
+		target = total / ((size_t)p->threads * 8);
+		if (target < LEPT_PARALLEL_MIN_SPLIT / 4) {
+			target = LEPT_PARALLEL_MIN_SPLIT / 4;
+		}
+		for (b = i = 0; i < size; ++i) {
+			acc += lept_parallel_weight(v, i);
+			if (acc >= target || i + 1 == size) {
+				lept_parallel_add_task(p, w, v, b, i + 1);
+				b = i + 1;
+				acc = 0;
+			}
+		}
+	}
+	if (v->type == LEPT_OBJECT) {
+		lept_writer_end_object(w);
+	} else {
+		lept_writer_end_array(w);
+	}
+}
+
+static void lept_parallel_format(const lept_parallel* p, lept_parallel_task* t) {
+	const lept_value* v = t->v;
+	lept_writer w;
+	lept_context c;
+	size_t i;
+
+	c.stack = NULL;
+	c.size = c.top = 0;
+	lept_writer_init_callback(&w, lept_stringify_write, &c);
+	lept_writer_set_pretty(&w, p->indent);
+	w.depth = t->depth;
+	w.state[t->depth - 1] = t->state;
+	for (i = t->begin; i < t->end; ++i) {
+		if (v->type == LEPT_OBJECT) {
+			lept_writer_key(&w, v->u.o.m[i].k, v->u.o.m[i].klen);
+			lept_write_value(&w, &v->u.o.m[i].v);
+		} else if (v->flags & LEPT_VALUE_PACKED) {
+			lept_writer_number(&w, v->u.p.n[i]);
+		} else {
+			lept_write_value(&w, &v->u.a.e[i]);
+		}
+	}
+	t->error = lept_writer_flush(&w);
+	t->data = c.stack;
+	t->len = c.top;
+}
+
+static void* lept_parallel_worker(void* arg) {
+	lept_parallel* p = (lept_parallel*)arg;
+	lept_parallel_task* tasks = (lept_parallel_task*)p->tasks.stack;
+	size_t count = lept_parallel_count(p), i;
+
+	for (;;) {
+		pthread_mutex_lock(&p->lock);
+		i = p->next++;
+		pthread_mutex_unlock(&p->lock);
+		if (i >= count) {
+			return NULL;
+		}
+		lept_parallel_format(p, &tasks[i]);
+	}
+}
+
+/**
+ * 规划并格式化所有块，调用线程也参与。
+ * @return 			第一个错误，之后由 lept_parallel_free 释放所有缓冲区。
+ */
+static int lept_parallel_run(lept_parallel* p, const lept_value* v, int indent, int threads) {
+	lept_writer w;
+	lept_parallel_segment* seg;
+	lept_parallel_task* tasks;
+	pthread_t* workers;
+	size_t i, count;
+	int n = 0, ret;
+
+	memset(p, 0, sizeof(*p));
+	if (threads <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (int)cpus : 1;
+	}
+	p->indent = indent;
+	p->threads = threads;
+
+	lept_writer_init_callback(&w, lept_parallel_literal_write, p);
+	lept_writer_set_pretty(&w, indent);
+	lept_parallel_plan(p, &w, v);
+	lept_writer_flush(&w);
+	if (p->literal.top > p->literal_begin) {
+		seg = (lept_parallel_segment*)lept_context_push(&p->segments, sizeof(lept_parallel_segment));
+		seg->offset = p->literal_begin;
+		seg->len = p->literal.top - p->literal_begin;
+		seg->task = LEPT_PARALLEL_LITERAL;
+	}
+	if ((ret = w.error) != LEPT_WRITER_OK) {
+		return ret;
+	}
+
+	count = lept_parallel_count(p);
+	pthread_mutex_init(&p->lock, NULL);
+	workers = (pthread_t*)malloc((size_t)threads * sizeof(pthread_t));
+	while (n + 1 < threads && (size_t)n + 1 < count && pthread_create(&workers[n], NULL, lept_parallel_worker, p) == 0) {
+		n++;
+	}
+	lept_parallel_worker(p);
+	while (n > 0) {
+		pthread_join(workers[--n], NULL);
+	}
+	free(workers);
+	pthread_mutex_destroy(&p->lock);
+
+	tasks = (lept_parallel_task*)p->tasks.stack;
+	for (i = 0; i < count && ret == LEPT_WRITER_OK; ++i) {
+		ret = tasks[i].error;
+	}
+	return ret;
+}
+
+static void lept_parallel_free(lept_parallel* p) {
+	lept_parallel_task* tasks = (lept_parallel_task*)p->tasks.stack;
+	size_t i, count = lept_parallel_count(p);
+
+	for (i = 0; i < count; ++i) {
+		free(tasks[i].data);
+	}
+	free(p->literal.stack);
+	free(p->segments.stack);
+	free(p->tasks.stack);
+}
+
+/**
+ * 第 i 段的文本。
+ */
+static const char* lept_parallel_segment_data(const lept_parallel* p, size_t i, size_t* len) {
+	const lept_parallel_segment* seg = (const lept_parallel_segment*)p->segments.stack + i;
+	const lept_parallel_task* t;
+
+	if (seg->task == LEPT_PARALLEL_LITERAL) {
+		*len = seg->len;
+		return p->literal.stack + seg->offset;
+	}
+	t = (const lept_parallel_task*)p->tasks.stack + seg->task;
+	*len = t->len;
+	return t->data;
+}
+
+char* lept_stringify_parallel(const lept_value* v, size_t* length, int indent, int threads) {
+	assert(v != NULL && indent >= 0);
+	lept_parallel p;
+	size_t i, len, total = 0, count;
+	char* out = NULL;
+
+	if (lept_parallel_run(&p, v, indent, threads) == LEPT_WRITER_OK) {
+		count = p.segments.top / sizeof(lept_parallel_segment);
+		for (i = 0; i < count; ++i) {
+			lept_parallel_segment_data(&p, i, &len);
+			total += len;
+		}
+		out = (char*)malloc(total + 1);
+		for (total = i = 0; i < count; ++i) {
+			const char* data = lept_parallel_segment_data(&p, i, &len);
+			memcpy(out + total, data, len);
+			total += len;
+		}
+		out[total] = '\0';
+		if (length) {
+			*length = total;
+		}
+	}
+	lept_parallel_free(&p);
+	return out;
+}
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/**
+ * 写出 iov 中的全部内容，处理部分写入。
+ */
+static int lept_parallel_writev(int fd, struct iovec* iov, int n) {
+	while (n > 0) {
+		ssize_t w = writev(fd, iov, n);
+		if (w < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return LEPT_WRITER_IO_ERROR;
+		}
+		while (n > 0 && (size_t)w >= iov->iov_len) {
+			w -= (ssize_t)iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char*)iov->iov_base + w;
+			iov->iov_len -= (size_t)w;
+		}
+	}
+	return LEPT_WRITER_OK;
+}
+
+int lept_write_value_parallel(int fd, const lept_value* v, int indent, int threads) {
+	assert(fd >= 0 && v != NULL && indent >= 0);
+	lept_parallel p;
+	struct iovec iov[IOV_MAX < 256 ? IOV_MAX : 256];
+	size_t i, len, count;
+	int n = 0, ret;
+
+	if ((ret = lept_parallel_run(&p, v, indent, threads)) == LEPT_WRITER_OK) {
+		count = p.segments.top / sizeof(lept_parallel_segment);
+		for (i = 0; i < count && ret == LEPT_WRITER_OK; ++i) {
+			iov[n].iov_base = (void*)lept_parallel_segment_data(&p, i, &len);
+			iov[n].iov_len = len;
+			if (len > 0 && ++n == (int)(sizeof(iov) / sizeof(iov[0]))) {
+				ret = lept_parallel_writev(fd, iov, n);
+				n = 0;
+			}
+		}
+		if (ret == LEPT_WRITER_OK) {
+			ret = lept_parallel_writev(fd, iov, n);
+		}
+	}
+	lept_parallel_free(&p);
+	return ret;
+}
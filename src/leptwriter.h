@@ -0,0 +1,127 @@
+#ifndef LEPTWRITER_H__
+#define LEPTWRITER_H__
+
+#include <stdio.h> /* FILE */
+#include "leptjson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 流式 JSON 写入器。
+ * 输出先写进固定大小的缓冲区，满了再交给 FILE*、文件描述符或者回调函数，
+ * 所以不论输出多大，占用的内存都是固定的。
+ *
+ * 一般用法：
+ 		lept_writer w;
+ 		lept_writer_init_file(&w, stdout);
+ 		lept_writer_begin_object(&w);
+ 		lept_writer_key(&w, "id", 2);
+ 		lept_writer_number(&w, 1);
+ 		lept_writer_end_object(&w);
+ 		lept_writer_flush(&w);
+ */
+
+#ifndef LEPT_WRITER_BUFFER_SIZE
+#define LEPT_WRITER_BUFFER_SIZE 4096
+#endif
+
+#ifndef LEPT_WRITER_MAX_DEPTH
+#define LEPT_WRITER_MAX_DEPTH 1024
+#endif
+
+typedef enum {
+	LEPT_WRITER_OK = 0,
+	LEPT_WRITER_IO_ERROR,			// 输出目标写入失败。
+	LEPT_WRITER_DEPTH_EXCEEDED,		// 嵌套超过 LEPT_WRITER_MAX_DEPTH。
+	LEPT_WRITER_INVALID_STATE,		// 调用顺序不对，例如在对象中没有先写键。
+	LEPT_WRITER_INVALID_NUMBER		// 数字是 NaN 或无穷大，JSON 中没有对应的写法。
+} lept_writer_error;
+
+/**
+ * 输出回调，成功返回 0，失败返回非 0。
+ */
+typedef int (*lept_write_func)(void* userdata, const char* data, size_t len);
+
+typedef struct {
+	char buffer[LEPT_WRITER_BUFFER_SIZE];
+	size_t len;						// 缓冲区中待输出的字节数
+	lept_write_func write;
+	void* userdata;
+	FILE* fp;
+	int fd;
+	int indent;						// 美化输出时每层缩进的空格数，0 表示紧凑输出
+	int depth;
+	unsigned char state[LEPT_WRITER_MAX_DEPTH];	// 每层容器的状态，见 leptwriter.c
+	int error;						// 第一个错误，出错之后的调用都直接返回它
+} lept_writer;
+
+void lept_writer_init_file(lept_writer* w, FILE* fp);
+void lept_writer_init_fd(lept_writer* w, int fd);
+void lept_writer_init_callback(lept_writer* w, lept_write_func func, void* userdata);
+
+/**
+ * 设置美化输出，indent 为每层缩进的空格数，0 为紧凑输出（默认）。
+ */
+void lept_writer_set_pretty(lept_writer* w, int indent);
+
+int lept_writer_begin_object(lept_writer* w);
+int lept_writer_end_object(lept_writer* w);
+int lept_writer_begin_array(lept_writer* w);
+int lept_writer_end_array(lept_writer* w);
+int lept_writer_key(lept_writer* w, const char* key, size_t len);
+int lept_writer_string(lept_writer* w, const char* s, size_t len);
+/**
+ * @return 			n 是 NaN 或无穷大时返回 LEPT_WRITER_INVALID_NUMBER，什么也不写。
+ */
+int lept_writer_number(lept_writer* w, double n);
+int lept_writer_boolean(lept_writer* w, int b);
+int lept_writer_null(lept_writer* w);
+
+/**
+ * 写入整棵 lept_value 树。
+ * @return 			第一个错误，例如树中有 NaN 或无穷大时为 LEPT_WRITER_INVALID_NUMBER。
+ */
+int lept_write_value(lept_writer* w, const lept_value* v);
+
+/**
+ * 把缓冲区中的内容交给输出目标。结束写入前必须调用。
+ */
+int lept_writer_flush(lept_writer* w);
+
+/**
+ * 生成 JSON 文本，返回 malloc 分配的字符串（以 '\0' 结尾），由调用方 free。
+ * @param length 	接收字符串长度，可以为 NULL。
+ * @param indent 	同 lept_writer_set_pretty。
+ * @return 			写入出错（嵌套过深、NaN 或无穷大）时返回 NULL。
+ */
+char* lept_stringify(const lept_value* v, size_t* length);
+char* lept_stringify_pretty(const lept_value* v, size_t* length, int indent);
+
+#ifndef LEPT_PARALLEL_MIN_SPLIT
+#define LEPT_PARALLEL_MIN_SPLIT 65536	// 容器的元素估计不到这么多字节时不拆分
+#endif
+
+/**
+ * 多线程生成 JSON 文本，输出和 lept_stringify_pretty 逐字节相同。
+ *
+ * 较大的数组和对象按元素拆成若干块，每块由线程池中的一个线程写进自己的缓冲区，
+ * 最后按顺序拼接。只有少数几个元素的大容器（例如 {"data": [...]}）不拆自身，
+ * 而是继续拆它的元素。块的大小按元素的字符串长度和个数估算，不遍历整棵树。
+ * @param threads 	线程数（包括调用线程），0 表示使用在线的 CPU 数。
+ * @return 			嵌套超过 LEPT_WRITER_MAX_DEPTH 或有 NaN、无穷大时返回 NULL。
+ */
+char* lept_stringify_parallel(const lept_value* v, size_t* length, int indent, int threads);
+
+/**
+ * 同 lept_stringify_parallel，但不拼接，各块用 writev 按顺序直接写到 fd。
+ * @return 			LEPT_WRITER_OK，LEPT_WRITER_IO_ERROR，LEPT_WRITER_DEPTH_EXCEEDED 或 LEPT_WRITER_INVALID_NUMBER。
+ */
+int lept_write_value_parallel(int fd, const lept_value* v, int indent, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
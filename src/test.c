@@ -1,7 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "leptjson.h"
+#include "leptmsgpack.h"
+#include "leptsnapshot.h"
+#include "leptwriter.h"
+#include "leptscan.h"
+#include "leptshared.h"
+#include "leptpatch.h"
+#include "leptcache.h"
+#include "leptreclaim.h"
+#include "leptreader.h"
+#include "leptedit.h"
+#include <pthread.h>
 
 /**
  * test.c
@@ -223,9 +237,240 @@ static void test_access_number () {
 	lept_free(&v);
 }
 
+static void test_access_array () {
+	lept_value a, e;
+	size_t i, j;
+
+	lept_init(&a);
+
+	for (j = 0; j <= 5; j += 5) {
+		lept_set_array(&a, j);
+		EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+		EXPECT_EQ_SIZE_T(j, lept_get_array_capacity(&a));
+		for (i = 0; i < 10; ++i) {
+			lept_init(&e);
+			lept_set_number(&e, i);
+			lept_move(lept_pushback_array_element(&a), &e);
+			lept_free(&e);
+		}
+
+		EXPECT_EQ_SIZE_T(10, lept_get_array_size(&a));
+		for (i = 0; i < 10; ++i) {
+			EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+		}
+	}
+
+	lept_popback_array_element(&a);
+	EXPECT_EQ_SIZE_T(9, lept_get_array_size(&a));
+	for (i = 0; i < 9; ++i) {
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	lept_erase_array_element(&a, 4, 0);
+	EXPECT_EQ_SIZE_T(9, lept_get_array_size(&a));
+	for (i = 0; i < 9; ++i) {
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	lept_erase_array_element(&a, 8, 1);
+	EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+	for (i = 0; i < 8; ++i) {
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	lept_erase_array_element(&a, 0, 2);
+	EXPECT_EQ_SIZE_T(6, lept_get_array_size(&a));
+	for (i = 0; i < 6; ++i) {
+		EXPECT_EQ_DOUBLE((double)i + 2, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	for (i = 0; i < 2; ++i) {
+		lept_init(&e);
+		lept_set_number(&e, i);
+		lept_move(lept_insert_array_element(&a, i), &e);
+		lept_free(&e);
+	}
+
+	EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+	for (i = 0; i < 8; ++i) {
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	EXPECT_TRUE(lept_get_array_capacity(&a) > 8);
+	lept_shrink_array(&a);
+	EXPECT_EQ_SIZE_T(8, lept_get_array_capacity(&a));
+	EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+	for (i = 0; i < 8; ++i) {
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	lept_set_string(&e, "Hello", 5);
+	lept_move(lept_pushback_array_element(&a), &e);
+	lept_free(&e);
+
+	i = lept_get_array_capacity(&a);
+	lept_clear_array(&a);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+	EXPECT_EQ_SIZE_T(i, lept_get_array_capacity(&a));
+	lept_shrink_array(&a);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_capacity(&a));
+
+	lept_free(&a);
+}
+
+static void test_access_object () {
+	lept_value o, v, *pv;
+	size_t i, j, index;
+
+	lept_init(&o);
+
+	for (j = 0; j <= 5; j += 5) {
+		lept_set_object(&o, j);
+		EXPECT_EQ_SIZE_T(0, lept_get_object_size(&o));
+		EXPECT_EQ_SIZE_T(j, lept_get_object_capacity(&o));
+		for (i = 0; i < 10; ++i) {
+			char key[2] = "a";
+			key[0] += i;
+			lept_init(&v);
+			lept_set_number(&v, i);
+			lept_move(lept_set_object_value(&o, key, 1), &v);
+			lept_free(&v);
+		}
+		EXPECT_EQ_SIZE_T(10, lept_get_object_size(&o));
+		for (i = 0; i < 10; ++i) {
+			char key[] = "a";
+			key[0] += i;
+			index = lept_find_object_index(&o, key, 1);
+			EXPECT_TRUE(index != LEPT_KEY_NOT_EXIST);
+			pv = lept_get_object_value(&o, index);
+			EXPECT_EQ_DOUBLE((double)i, lept_get_number(pv));
+		}
+	}
+
+	/* 重复设置同一个键不会增加成员 */
+	lept_set_number(lept_set_object_value(&o, "a", 1), 100.0);
+	EXPECT_EQ_SIZE_T(10, lept_get_object_size(&o));
+	EXPECT_EQ_DOUBLE(100.0, lept_get_number(lept_find_object_value(&o, "a", 1)));
+
+	index = lept_find_object_index(&o, "j", 1);
+	EXPECT_TRUE(index != LEPT_KEY_NOT_EXIST);
+	lept_remove_object_value(&o, index);
+	index = lept_find_object_index(&o, "j", 1);
+	EXPECT_TRUE(index == LEPT_KEY_NOT_EXIST);
+	EXPECT_EQ_SIZE_T(9, lept_get_object_size(&o));
+
+	index = lept_find_object_index(&o, "a", 1);
+	EXPECT_TRUE(index != LEPT_KEY_NOT_EXIST);
+	lept_remove_object_value(&o, index);
+	index = lept_find_object_index(&o, "a", 1);
+	EXPECT_TRUE(index == LEPT_KEY_NOT_EXIST);
+	EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+
+	EXPECT_TRUE(lept_get_object_capacity(&o) > 8);
+	lept_shrink_object(&o);
+	EXPECT_EQ_SIZE_T(8, lept_get_object_capacity(&o));
+	EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+	for (i = 0; i < 8; ++i) {
+		char key[] = "a";
+		key[0] += i + 1;
+		EXPECT_EQ_DOUBLE((double)i + 1, lept_get_number(lept_get_object_value(&o, lept_find_object_index(&o, key, 1))));
+	}
+
+	lept_set_string(&v, "Hello", 5);
+	lept_move(lept_set_object_value(&o, "World", 5), &v);
+	lept_free(&v);
+
+	pv = lept_find_object_value(&o, "World", 5);
+	EXPECT_TRUE(pv != NULL);
+	EXPECT_EQ_STRING("Hello", lept_get_string(pv), 5);
+
+	i = lept_get_object_capacity(&o);
+	lept_clear_object(&o);
+	EXPECT_EQ_SIZE_T(0, lept_get_object_size(&o));
+	EXPECT_EQ_SIZE_T(i, lept_get_object_capacity(&o));
+	lept_shrink_object(&o);
+	EXPECT_EQ_SIZE_T(0, lept_get_object_capacity(&o));
+
+	lept_free(&o);
+}
+
+static void test_copy_move_swap () {
+	lept_value v1, v2, v3;
+
+	lept_init(&v1);
+	lept_init(&v2);
+	lept_init(&v3);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"t\":true,\"a\":[1,\"s\",{}],\"o\":{\"n\":null}}"));
+	lept_copy(&v2, &v1);
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v2));
+	EXPECT_EQ_SIZE_T(3, lept_get_object_size(&v2));
+	EXPECT_EQ_STRING("s", lept_get_string(lept_get_array_element(lept_find_object_value(&v2, "a", 1), 1)), 1);
+	/* 深拷贝：修改副本不影响原值 */
+	lept_set_number(lept_find_object_value(&v2, "t", 1), 1.0);
+	EXPECT_EQ_INT(LEPT_TRUE, lept_get_type(lept_find_object_value(&v1, "t", 1)));
+
+	/* 重复的键原样复制 */
+	lept_free(&v3);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v3, "{\"a\":1,\"a\":2}"));
+	lept_copy(&v1, &v3);
+	EXPECT_EQ_SIZE_T(2, lept_get_object_size(&v1));
+	EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_object_value(&v1, 1)));
+	EXPECT_TRUE(lept_is_equal(&v1, &v3));
+	lept_free(&v3);
+
+	lept_move(&v3, &v2);
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v2));
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v3));
+
+	lept_set_string(&v2, "Hello", 5);
+	lept_swap(&v2, &v3);
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v2));
+	EXPECT_EQ_STRING("Hello", lept_get_string(&v3), lept_get_string_length(&v3));
+
+	lept_free(&v1);
+	lept_free(&v2);
+	lept_free(&v3);
+}
+
 static void test_parse_string () {
 	TEST_STRING("", "\"\"");
 	TEST_STRING("Hello", "\"Hello\"");
+	TEST_STRING("\x24", "\"\\u0024\"");
+	TEST_STRING("\xE2\x82\xAC", "\"\\u20AC\"");
+	TEST_STRING("\xF0\x9D\x84\x9E", "\"\\uD834\\uDD1E\"");
+	TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\"");
+	TEST_STRING("\xC2\xA2\xE2\x82\xAC\n\"a\xF0\x9D\x84\x9E", "\"\\u00a2\\u20aC\\n\\\"a\\uD834\\uDD1E\"");
+}
+
+/**
+ * 连续的转义超过一次预留的输出空间。
+ */
+static void test_parse_escape_run () {
+	char json[2048], expect[512];
+	size_t i, n = 0, m = 0;
+	lept_value v;
+
+	json[n++] = '"';
+	for (i = 0; i < 100; i++) {
+		memcpy(json + n, "\\uD83D\\uDE00\\t", 14);
+		n += 14;
+		memcpy(expect + m, "\xF0\x9F\x98\x80\t", 5);
+		m += 5;
+	}
+	json[n++] = '"';
+	json[n] = '\0';
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+	EXPECT_EQ_SIZE_T(m, lept_get_string_length(&v));
+	EXPECT_TRUE(memcmp(expect, lept_get_string(&v), m) == 0);
+	lept_free(&v);
+
+	json[n - 1] = '\\';
+	json[n] = 'x';
+	json[n + 1] = '"';
+	json[n + 2] = '\0';
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_parse(&v, json));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
 }
 
 static void test_parse_array () {
@@ -273,6 +518,198 @@ static void test_parse_array () {
 	}
 
 	lept_free(&v);
+
+	/* 元素多于第一次分配的个数，块扩充几次之后缩到正好 */
+	{
+		char json[4096];
+		size_t len = 0;
+		json[len++] = '[';
+		for (i = 0; i < 100; ++i) {
+			len += sprintf(json + len, "%s{\"k%zu\":%zu}", i ? "," : "", i, i);
+		}
+		strcpy(json + len, "]");
+		lept_init(&v);
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+		EXPECT_EQ_SIZE_T(100, lept_get_array_size(&v));
+		EXPECT_EQ_SIZE_T(100, lept_get_array_capacity(&v));
+		for (i = 0; i < 100; ++i) {
+			lept_value* o = lept_get_array_element(&v, i);
+			EXPECT_EQ_SIZE_T(1, lept_get_object_capacity(o));
+			EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_object_value(o, 0)));
+		}
+		lept_free(&v);
+	}
+}
+
+static void test_parse_packed_array () {
+	lept_value v, c;
+	double* n;
+	size_t i;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[ 1, 2.5, -3, 4e2 ]", LEPT_PARSE_PACKED_NUMBERS));
+	EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+	EXPECT_TRUE(lept_is_array_packed(&v));
+	EXPECT_EQ_SIZE_T(4, lept_get_array_size(&v));
+	n = lept_get_array_numbers(&v);
+	EXPECT_TRUE(n != NULL);
+	EXPECT_EQ_DOUBLE(1.0, n[0]);
+	EXPECT_EQ_DOUBLE(2.5, n[1]);
+	EXPECT_EQ_DOUBLE(-3.0, n[2]);
+	EXPECT_EQ_DOUBLE(400.0, lept_get_array_number(&v, 3));
+	EXPECT_TRUE(lept_is_array_packed(&v));
+	EXPECT_TRUE(lept_get_array_numbers(&v) == n);
+
+	lept_init(&c);
+	lept_copy(&c, &v);
+	EXPECT_TRUE(lept_is_array_packed(&c));
+	EXPECT_EQ_DOUBLE(2.5, lept_get_array_numbers(&c)[1]);
+	lept_erase_array_element(&c, 0, 1);
+	EXPECT_TRUE(lept_is_array_packed(&c));
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(&c));
+	EXPECT_EQ_DOUBLE(2.5, lept_get_array_number(&c, 0));
+	lept_free(&c);
+
+	/* 用 lept_get_array_element_mutable 取元素时转换回普通存储，之后可以放入非数字 */
+	lept_set_string(lept_get_array_element_mutable(&v, 1), "x", 1);
+	EXPECT_FALSE(lept_is_array_packed(&v));
+	EXPECT_TRUE(lept_get_array_numbers(&v) == NULL);
+	EXPECT_EQ_SIZE_T(4, lept_get_array_size(&v));
+	EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_get_array_element(&v, 0)));
+	EXPECT_EQ_STRING("x", lept_get_string(lept_get_array_element(&v, 1)), 1);
+	EXPECT_EQ_DOUBLE(400.0, lept_get_array_number(&v, 3));
+	EXPECT_FALSE(lept_pack_array(&v));
+	lept_erase_array_element(&v, 1, 1);
+	EXPECT_TRUE(lept_pack_array(&v));
+	EXPECT_EQ_DOUBLE(-3.0, lept_get_array_numbers(&v)[1]);
+	lept_free(&v);
+
+	/* 只有全部是数字的数组才会紧凑存储 */
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[ [ 0, 1 ], [ 0, null ], [] ]", LEPT_PARSE_PACKED_NUMBERS));
+	EXPECT_FALSE(lept_is_array_packed(&v));
+	EXPECT_TRUE(lept_is_array_packed(lept_get_array_element(&v, 0)));
+	EXPECT_FALSE(lept_is_array_packed(lept_get_array_element(&v, 1)));
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(lept_get_array_element(&v, 2)));
+	for (i = 0; i < 2; ++i) {
+		EXPECT_EQ_DOUBLE((double)i, lept_get_array_number(lept_get_array_element(&v, 0), i));
+	}
+	lept_free(&v);
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[ 1, 2 ]"));
+	EXPECT_FALSE(lept_is_array_packed(&v));
+	EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(&v, 1)));
+	lept_free(&v);
+
+	TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1");
+	TEST_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "[1] x");
+}
+
+#define TEST_RAW_NUMBER(expect, json)\
+	do {\
+		lept_value v;\
+		size_t len;\
+		char* out;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, json, LEPT_PARSE_RAW_NUMBERS));\
+		EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(&v));\
+		EXPECT_EQ_STRING(json, lept_get_number_text(&v, &len), len);\
+		EXPECT_EQ_DOUBLE(expect, lept_get_number(&v));\
+		EXPECT_EQ_DOUBLE(expect, lept_get_number(&v));\
+		out = lept_stringify(&v, &len);\
+		EXPECT_EQ_STRING(json, out, len);\
+		free(out);\
+		lept_free(&v);\
+	} while(0)
+
+#define TEST_RAW_THREADS 4
+
+static void* test_raw_reader (void* arg) {
+	const lept_value* v = (const lept_value*)arg;
+	size_t i;
+	double sum = 0;
+
+	for (i = 0; i < lept_get_array_size(v); ++i) {
+		sum += lept_get_number(lept_get_array_element(v, i));
+	}
+	return sum == 500500.0 ? arg : NULL;
+}
+
+static void test_parse_raw_numbers () {
+	lept_value v, c, n;
+	pthread_t threads[TEST_RAW_THREADS];
+	char json[8192];
+	char* out;
+	size_t i, len = 0, ok = 0;
+	void* ret;
+
+	/* 短的原文存在节点里，长的单独分配 */
+	TEST_RAW_NUMBER(0.0, "0");
+	TEST_RAW_NUMBER(-1.5, "-1.50");
+	TEST_RAW_NUMBER(1e-10, "1E-10");
+	TEST_RAW_NUMBER(123456789012345.0, "123456789012345");
+	TEST_RAW_NUMBER(1234567890123456.0, "1234567890123456");
+	TEST_RAW_NUMBER(12345678901234567890.0, "12345678901234567890");
+	TEST_RAW_NUMBER(0.1, "0.1000000000000000055511151231257827");
+	TEST_RAW_NUMBER(1.7976931348623157e308, "1.7976931348623157e308");
+	TEST_RAW_NUMBER(0.0, "0e999999999");
+	TEST_RAW_NUMBER(0.0, "1e-400");
+
+	/* 溢出仍然在解析时报告 */
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_parse_ex(&v, "1e309", LEPT_PARSE_RAW_NUMBERS));
+	EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_parse_ex(&v, "[1.5,-0.00001e400]", LEPT_PARSE_RAW_NUMBERS));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_ex(&v, "-", LEPT_PARSE_RAW_NUMBERS));
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_parse_ex(&v, "1.5 2", LEPT_PARSE_RAW_NUMBERS));
+
+	/* 输出照原文，比较和哈希按数值 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "{\"a\":1.10,\"b\":[1e2,-0,12345678901234567890]}", LEPT_PARSE_RAW_NUMBERS));
+	out = lept_stringify(&v, &len);
+	EXPECT_EQ_STRING("{\"a\":1.10,\"b\":[1e2,-0,12345678901234567890]}", out, len);
+	free(out);
+	lept_init(&n);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&n, "{\"a\":1.1,\"b\":[100,0,1.2345678901234567e19]}"));
+	EXPECT_TRUE(lept_is_equal(&v, &n));
+	EXPECT_TRUE(lept_hash(&v) == lept_hash(&n));
+	EXPECT_TRUE(lept_get_number_text(lept_find_object_value(&n, "a", 1), NULL) == NULL);
+
+	/* 拷贝带上原文，修改之后不再有原文 */
+	lept_init(&c);
+	lept_copy(&c, &v);
+	EXPECT_EQ_STRING("12345678901234567890", lept_get_number_text(lept_get_array_element(lept_find_object_value(&c, "b", 1), 2), &len), len);
+	lept_set_number(lept_find_object_value(&c, "a", 1), 2.5);
+	EXPECT_TRUE(lept_get_number_text(lept_find_object_value(&c, "a", 1), NULL) == NULL);
+	out = lept_stringify(&c, &len);
+	EXPECT_EQ_STRING("{\"a\":2.5,\"b\":[1e2,-0,12345678901234567890]}", out, len);
+	free(out);
+	lept_free(&c);
+	lept_free(&n);
+	lept_free(&v);
+
+	/* 和紧凑数组一起用时，全是数字的数组在解析时转换 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[[1.50,12345678901234567890],[2.0,null]]", LEPT_PARSE_RAW_NUMBERS | LEPT_PARSE_PACKED_NUMBERS));
+	out = lept_stringify(&v, &len);
+	EXPECT_EQ_STRING("[[1.5,1.2345678901234567e+19],[2.0,null]]", out, len);
+	free(out);
+	lept_free(&v);
+
+	/* 几个线程同时第一次读取 */
+	json[len = 0] = '[';
+	for (i = 1; i <= 1000; ++i) {
+		len += sprintf(json + len + 1, "%s%zu.0", i > 1 ? "," : "", i);
+	}
+	strcpy(json + len + 1, "]");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, json, LEPT_PARSE_RAW_NUMBERS));
+	for (i = 0; i < TEST_RAW_THREADS; i++) {
+		pthread_create(&threads[i], NULL, test_raw_reader, &v);
+	}
+	for (i = 0; i < TEST_RAW_THREADS; i++) {
+		pthread_join(threads[i], &ret);
+		ok += ret != NULL;
+	}
+	EXPECT_EQ_SIZE_T(TEST_RAW_THREADS, ok);
+	lept_free(&v);
 }
 
 static void test_parse_object () {
@@ -362,6 +799,1211 @@ static void test_parse_expect_value () {
 	TEST_ERROR(LEPT_PARSE_EXPECT_VALUE, " ");
 }
 
+#define TEST_MSGPACK_ERROR(error, data, len)\
+	do {\
+		lept_value v;\
+		v.type = LEPT_FALSE;\
+		EXPECT_EQ_INT(error, lept_decode_msgpack(&v, data, len));\
+		EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+	} while(0)
+
+static void test_msgpack_number (double d, const char* expect, size_t expect_len) {
+	lept_value v, d2;
+	char* data;
+	size_t len;
+
+	lept_init(&v);
+	lept_init(&d2);
+	lept_set_number(&v, d);
+	data = lept_encode_msgpack(&v, &len);
+	EXPECT_EQ_SIZE_T(expect_len, len);
+	EXPECT_TRUE(memcmp(expect, data, expect_len) == 0);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_msgpack(&d2, data, len));
+	EXPECT_EQ_DOUBLE(d, lept_get_number(&d2));
+	free(data);
+}
+
+static void test_msgpack () {
+	lept_value v, d;
+	char* data;
+	char big[40];
+	size_t len, i;
+
+	test_msgpack_number(0.0, "\x00", 1);
+	test_msgpack_number(127.0, "\x7f", 1);
+	test_msgpack_number(-1.0, "\xff", 1);
+	test_msgpack_number(-32.0, "\xe0", 1);
+	test_msgpack_number(200.0, "\xcc\xc8", 2);
+	test_msgpack_number(-200.0, "\xd1\xff\x38", 3);
+	test_msgpack_number(65536.0, "\xce\x00\x01\x00\x00", 5);
+	test_msgpack_number(-4294967296.0, "\xd3\xff\xff\xff\xff\x00\x00\x00\x00", 9);
+	test_msgpack_number(1.5, "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00", 9);
+
+	lept_init(&v);
+	lept_init(&d);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v,
+		"{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"d\":-0.25,\"s\":\"abc\\u0000def\","
+		"\"a\":[1,2,[3,{}]],\"o\":{\"1\":1,\"2\":\"two\"}}"));
+	data = lept_encode_msgpack(&v, &len);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_msgpack(&d, data, len));
+	free(data);
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&d));
+	EXPECT_EQ_SIZE_T(8, lept_get_object_size(&d));
+	EXPECT_EQ_SIZE_T(8, lept_get_object_capacity(&d));
+	EXPECT_EQ_STRING("n", lept_get_object_key(&d, 0), 1);
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(lept_get_object_value(&d, 0)));
+	EXPECT_EQ_INT(LEPT_FALSE, lept_get_type(lept_get_object_value(&d, 1)));
+	EXPECT_EQ_INT(LEPT_TRUE, lept_get_type(lept_get_object_value(&d, 2)));
+	EXPECT_EQ_DOUBLE(123.0, lept_get_number(lept_get_object_value(&d, 3)));
+	EXPECT_EQ_DOUBLE(-0.25, lept_get_number(lept_get_object_value(&d, 4)));
+	EXPECT_EQ_SIZE_T(7, lept_get_string_length(lept_get_object_value(&d, 5)));
+	EXPECT_TRUE(memcmp("abc\0def", lept_get_string(lept_get_object_value(&d, 5)), 7) == 0);
+	{
+		lept_value* a = lept_find_object_value(&d, "a", 1);
+		EXPECT_EQ_SIZE_T(3, lept_get_array_size(a));
+		EXPECT_EQ_SIZE_T(3, lept_get_array_capacity(a));
+		EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(a, 1)));
+		EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(lept_get_array_element(lept_get_array_element(a, 2), 1)));
+	}
+	EXPECT_EQ_STRING("two", lept_get_string(lept_find_object_value(lept_find_object_value(&d, "o", 1), "2", 1)), 3);
+	lept_free(&v);
+	lept_free(&d);
+
+	/* 长字符串、大数组用 8/16 位长度前缀 */
+	memset(big, 'x', sizeof(big));
+	lept_set_array(&v, 0);
+	for (i = 0; i < 20; ++i) {
+		lept_set_string(lept_pushback_array_element(&v), big, sizeof(big));
+	}
+	data = lept_encode_msgpack(&v, &len);
+	EXPECT_EQ_INT(0xdc, (unsigned char)data[0]);
+	EXPECT_EQ_INT(0xd9, (unsigned char)data[3]);
+	EXPECT_EQ_SIZE_T(3 + 20 * (2 + sizeof(big)), len);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_msgpack(&d, data, len));
+	EXPECT_EQ_SIZE_T(20, lept_get_array_size(&d));
+	EXPECT_EQ_SIZE_T(sizeof(big), lept_get_string_length(lept_get_array_element(&d, 19)));
+	free(data);
+	lept_free(&v);
+	lept_free(&d);
+
+	/* 超过 32 位的长度没有对应的格式，编码失败；这里只改长度字段，编码器在读内容之前就会拒绝 */
+	if (sizeof(size_t) > 4) {
+		size_t huge = (size_t)0xFFFFFFFFu + 1;
+		lept_set_array(&v, 0);
+		lept_set_string(lept_pushback_array_element(&v), "x", 1);
+		lept_get_array_element(&v, 0)->u.s.len = huge;
+		len = 1;
+		EXPECT_TRUE(lept_encode_msgpack(&v, &len) == NULL);
+		EXPECT_EQ_SIZE_T(0, len);
+		lept_get_array_element(&v, 0)->u.s.len = 1;
+		lept_set_array(&d, 0);
+		d.u.a.size = huge;
+		EXPECT_TRUE(lept_encode_msgpack(&d, NULL) == NULL);
+		d.u.a.size = 0;
+		lept_free(&v);
+		lept_free(&d);
+	}
+
+	/* 解码时也可以使用紧凑数字数组 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_msgpack_ex(&d, "\x93\x01\x02\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00", 12, LEPT_PARSE_PACKED_NUMBERS));
+	EXPECT_TRUE(lept_is_array_packed(&d));
+	EXPECT_EQ_DOUBLE(1.5, lept_get_array_numbers(&d)[2]);
+	lept_free(&d);
+
+	TEST_MSGPACK_ERROR(LEPT_PARSE_EXPECT_VALUE, "", 0);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "\xc0\xc0", 2);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\xc4\x01\x00", 3);	/* bin 8 */
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\xc1", 1);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\xa3" "ab", 3);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\xcb\x00\x00", 3);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\x92\x01", 2);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\x92\xa1x\xc1", 4);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\x81\x01\x01", 3);	/* 键不是字符串 */
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\x82\xa1k\x01\xa1j", 6);
+	TEST_MSGPACK_ERROR(LEPT_PARSE_INVALID_MSGPACK, "\xdd\xff\xff\xff\xff\x00", 6);
+
+	/* 只有容器计入深度：最深一层的 nil 和整数一样可以解码 */
+	{
+		char deep[LEPT_MSGPACK_MAX_DEPTH + 2];
+		memset(deep, 0x91, sizeof(deep));
+		for (i = 0; i < 2; i++) {
+			deep[LEPT_MSGPACK_MAX_DEPTH] = i == 0 ? (char)0xc0 : 0x01;
+			EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_msgpack(&d, deep, LEPT_MSGPACK_MAX_DEPTH + 1));
+			lept_free(&d);
+			deep[LEPT_MSGPACK_MAX_DEPTH + 1] = deep[LEPT_MSGPACK_MAX_DEPTH];
+			deep[LEPT_MSGPACK_MAX_DEPTH] = (char)0x91;
+			EXPECT_EQ_INT(LEPT_PARSE_DEPTH_EXCEEDED, lept_decode_msgpack(&d, deep, LEPT_MSGPACK_MAX_DEPTH + 2));
+		}
+	}
+}
+
+static void test_snapshot () {
+	lept_value v;
+	lept_snapshot_mapping m;
+	const lept_snapshot_value *root, *a, *o;
+	char* image;
+	size_t len, i;
+	const char* path = "leptjson_test.snapshot";
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v,
+		"{\"n\":null,\"b\":true,\"i\":123,\"s\":\"abc\\u0000def\",\"p\":[1,2,3],"
+		"\"a\":[false,\"x\",[],{}],\"o\":{\"k\":{\"deep\":-1.5}}}", LEPT_PARSE_PACKED_NUMBERS));
+	image = lept_snapshot_create(&v, &len);
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&root, image, len, 1));
+
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_snapshot_get_type(root));
+	EXPECT_EQ_SIZE_T(7, lept_snapshot_get_object_size(root));
+	EXPECT_EQ_STRING("n", lept_snapshot_get_object_key(root, 0), lept_snapshot_get_object_key_length(root, 0));
+	EXPECT_EQ_INT(LEPT_NULL, lept_snapshot_get_type(lept_snapshot_get_object_value(root, 0)));
+	EXPECT_EQ_BOOLEAN(LEPT_TRUE, lept_snapshot_get_boolean(lept_snapshot_find_object_value(root, "b", 1)));
+	EXPECT_EQ_DOUBLE(123.0, lept_snapshot_get_number(lept_snapshot_find_object_value(root, "i", 1)));
+	EXPECT_EQ_SIZE_T(7, lept_snapshot_get_string_length(lept_snapshot_find_object_value(root, "s", 1)));
+	EXPECT_TRUE(memcmp("abc\0def", lept_snapshot_get_string(lept_snapshot_find_object_value(root, "s", 1)), 8) == 0);
+	a = lept_snapshot_find_object_value(root, "p", 1);
+	EXPECT_EQ_SIZE_T(3, lept_snapshot_get_array_size(a));
+	for (i = 0; i < 3; ++i) {
+		EXPECT_EQ_DOUBLE(i + 1.0, lept_snapshot_get_number(lept_snapshot_get_array_element(a, i)));
+	}
+	a = lept_snapshot_find_object_value(root, "a", 1);
+	EXPECT_EQ_SIZE_T(4, lept_snapshot_get_array_size(a));
+	EXPECT_EQ_INT(LEPT_FALSE, lept_snapshot_get_type(lept_snapshot_get_array_element(a, 0)));
+	EXPECT_EQ_STRING("x", lept_snapshot_get_string(lept_snapshot_get_array_element(a, 1)), 1);
+	EXPECT_EQ_SIZE_T(0, lept_snapshot_get_array_size(lept_snapshot_get_array_element(a, 2)));
+	EXPECT_EQ_SIZE_T(0, lept_snapshot_get_object_size(lept_snapshot_get_array_element(a, 3)));
+	o = lept_snapshot_find_object_value(lept_snapshot_find_object_value(root, "o", 1), "k", 1);
+	EXPECT_EQ_DOUBLE(-1.5, lept_snapshot_get_number(lept_snapshot_find_object_value(o, "deep", 4)));
+	EXPECT_TRUE(lept_snapshot_find_object_value(o, "missing", 7) == NULL);
+
+	/* 写入文件后映射回来，内容一致 */
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write(&v, path));
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_map(&m, path));
+	EXPECT_EQ_SIZE_T(len, m.len);
+	EXPECT_TRUE(memcmp(image, m.addr, len) == 0);
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&root, m.addr, m.len, 1));
+	EXPECT_EQ_DOUBLE(123.0, lept_snapshot_get_number(lept_snapshot_find_object_value(root, "i", 1)));
+	lept_snapshot_unmap(&m);
+	remove(path);
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_IO_ERROR, lept_snapshot_map(&m, path));
+
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_INVALID_HEADER, lept_snapshot_open(&root, image, len - 8, 1));
+	image[len - 1] ^= 1;
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_CHECKSUM_MISMATCH, lept_snapshot_open(&root, image, len, 1));
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&root, image, len, 0));
+	image[8] += 1;	/* version */
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_VERSION_MISMATCH, lept_snapshot_open(&root, image, len, 0));
+	image[0] = 'X';
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_INVALID_HEADER, lept_snapshot_open(&root, image, len, 0));
+	EXPECT_TRUE(root == NULL);
+
+	free(image);
+	lept_free(&v);
+
+	/* 标量作为根 */
+	lept_set_string(&v, "hi", 2);
+	image = lept_snapshot_create(&v, &len);
+	EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&root, image, len, 1));
+	EXPECT_EQ_STRING("hi", lept_snapshot_get_string(root), 2);
+	free(image);
+	lept_free(&v);
+}
+
+#define TEST_ROUNDTRIP(json)\
+	do {\
+		lept_value v;\
+		char* json2;\
+		size_t length;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+		json2 = lept_stringify(&v, &length);\
+		EXPECT_EQ_STRING(json, json2, length);\
+		EXPECT_EQ_SIZE_T(strlen(json), length);\
+		lept_free(&v);\
+		free(json2);\
+	} while(0)
+
+static void test_stringify () {
+	TEST_ROUNDTRIP("null");
+	TEST_ROUNDTRIP("false");
+	TEST_ROUNDTRIP("true");
+	TEST_ROUNDTRIP("0");
+	TEST_ROUNDTRIP("-0");
+	TEST_ROUNDTRIP("1");
+	TEST_ROUNDTRIP("-1");
+	TEST_ROUNDTRIP("1.5");
+	TEST_ROUNDTRIP("3.25");
+	TEST_ROUNDTRIP("1e+20");
+	TEST_ROUNDTRIP("1.234e-20");
+	TEST_ROUNDTRIP("1.0000000000000002");
+	TEST_ROUNDTRIP("4.9406564584124654e-324");
+	TEST_ROUNDTRIP("1.7976931348623157e+308");
+	TEST_ROUNDTRIP("\"\"");
+	TEST_ROUNDTRIP("\"Hello\"");
+	TEST_ROUNDTRIP("\"Hello\\nWorld\"");
+	TEST_ROUNDTRIP("\"\\\" \\\\ / \\b \\f \\n \\r \\t\"");
+	TEST_ROUNDTRIP("\"Hello\\u0000World\\u001F\"");
+	TEST_ROUNDTRIP("[]");
+	TEST_ROUNDTRIP("[null,false,true,123,\"abc\",[1,2,3]]");
+	TEST_ROUNDTRIP("{}");
+	TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
+}
+
+/**
+ * 测试用的输出回调，把输出收集到 lept_value 字符串里。
+ */
+static int test_writer_collect (void* userdata, const char* data, size_t len) {
+	lept_value* out = (lept_value*)userdata;
+	size_t old = lept_get_string_length(out);
+	char* s = (char*)malloc(old + len);
+	memcpy(s, lept_get_string(out), old);
+	memcpy(s + old, data, len);
+	lept_set_string(out, s, old + len);
+	free(s);
+	return 0;
+}
+
+static int test_writer_fail (void* userdata, const char* data, size_t len) {
+	return 1;
+}
+
+static void test_writer () {
+	lept_writer w;
+	lept_value out, v;
+	char* s;
+	char big[10000];
+	size_t length;
+	FILE* fp;
+
+	/* 美化输出 */
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":[1,[],{}],\"b\":{\"c\":null}}"));
+	s = lept_stringify_pretty(&v, &length, 2);
+	EXPECT_EQ_STRING(
+		"{\n"
+		"  \"a\": [\n"
+		"    1,\n"
+		"    [],\n"
+		"    {}\n"
+		"  ],\n"
+		"  \"b\": {\n"
+		"    \"c\": null\n"
+		"  }\n"
+		"}", s, length);
+	EXPECT_EQ_SIZE_T(strlen(s), length);
+	free(s);
+	lept_free(&v);
+
+	/* 紧凑数组与普通数组输出相同 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[1,2.5,-3]", LEPT_PARSE_PACKED_NUMBERS));
+	s = lept_stringify(&v, &length);
+	EXPECT_EQ_STRING("[1,2.5,-3]", s, length);
+	free(s);
+	lept_free(&v);
+
+	/* 逐个调用，输出经过回调；超过缓冲区大小的字符串直接输出 */
+	lept_init(&out);
+	lept_set_string(&out, "", 0);
+	memset(big, 'x', sizeof(big));
+	lept_writer_init_callback(&w, test_writer_collect, &out);
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_begin_array(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_number(&w, 1.5));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_boolean(&w, 1));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_begin_object(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_key(&w, "k", 1));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_string(&w, big, sizeof(big)));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_end_object(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_null(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_end_array(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_flush(&w));
+	EXPECT_EQ_SIZE_T(sizeof(big) + 24, lept_get_string_length(&out));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, lept_get_string(&out)));
+	EXPECT_EQ_SIZE_T(sizeof(big), lept_get_string_length(lept_find_object_value(lept_get_array_element(&v, 2), "k", 1)));
+	lept_free(&v);
+
+	/* 调用顺序错误 */
+	lept_set_string(&out, "", 0);
+	lept_writer_init_callback(&w, test_writer_collect, &out);
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_begin_object(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_STATE, lept_writer_number(&w, 1));
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_STATE, lept_writer_key(&w, "k", 1));
+	lept_writer_init_callback(&w, test_writer_collect, &out);
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_STATE, lept_writer_key(&w, "k", 1));
+	lept_writer_init_callback(&w, test_writer_collect, &out);
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_begin_array(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_STATE, lept_writer_end_object(&w));
+	lept_writer_init_callback(&w, test_writer_collect, &out);
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_STATE, lept_writer_end_array(&w));
+	lept_free(&out);
+
+	/* NaN 和无穷大不能写成 JSON */
+	lept_writer_init_callback(&w, test_writer_fail, NULL);
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_begin_array(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_NUMBER, lept_writer_number(&w, HUGE_VAL));
+	EXPECT_EQ_INT(LEPT_WRITER_INVALID_NUMBER, lept_writer_null(&w));
+	lept_set_array(&v, 0);
+	lept_set_number(lept_pushback_array_element(&v), 1.0);
+	lept_set_number(lept_pushback_array_element(&v), NAN);
+	length = 1;
+	EXPECT_TRUE(lept_stringify(&v, &length) == NULL);
+	EXPECT_EQ_SIZE_T(0, length);
+	EXPECT_TRUE(lept_stringify_parallel(&v, NULL, 0, 2) == NULL);
+	lept_set_number(lept_get_array_element(&v, 1), -HUGE_VAL);
+	EXPECT_TRUE(lept_stringify_pretty(&v, NULL, 2) == NULL);
+	lept_free(&v);
+
+	/* 比 LEPT_WRITER_MAX_DEPTH 深得多的树：出错后不再递归，不会栈溢出 */
+	{
+		lept_value* p = &v;
+		size_t i;
+		lept_set_array(&v, 0);
+		for (i = 0; i < 1000000; i++) {
+			p = lept_pushback_array_element(p);
+			lept_set_array(p, 0);
+		}
+		lept_writer_init_callback(&w, test_writer_fail, NULL);
+		EXPECT_EQ_INT(LEPT_WRITER_DEPTH_EXCEEDED, lept_write_value(&w, &v));
+		EXPECT_TRUE(lept_stringify(&v, NULL) == NULL);
+		EXPECT_TRUE(lept_stringify_parallel(&v, NULL, 2, 2) == NULL);
+		lept_free(&v);
+	}
+
+	/* 输出失败 */
+	lept_writer_init_callback(&w, test_writer_fail, NULL);
+	EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_string(&w, "abc", 3));
+	EXPECT_EQ_INT(LEPT_WRITER_IO_ERROR, lept_writer_flush(&w));
+	EXPECT_EQ_INT(LEPT_WRITER_IO_ERROR, lept_writer_null(&w));
+
+	/* FILE* 和文件描述符 */
+	if ((fp = tmpfile()) != NULL) {
+		char buffer[64];
+		lept_writer_init_file(&w, fp);
+		lept_writer_begin_array(&w);
+		lept_writer_number(&w, 1);
+		lept_writer_end_array(&w);
+		EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_flush(&w));
+		fflush(fp);
+		lept_writer_init_fd(&w, fileno(fp));
+		lept_writer_string(&w, "fd", 2);
+		EXPECT_EQ_INT(LEPT_WRITER_OK, lept_writer_flush(&w));
+		rewind(fp);
+		length = fread(buffer, 1, sizeof(buffer), fp);
+		EXPECT_EQ_STRING("[1]\"fd\"", buffer, length);
+		EXPECT_EQ_SIZE_T(7, length);
+		fclose(fp);
+	}
+}
+
+/**
+ * 比较并行输出和 lept_stringify_pretty，包括 fd 版本。
+ */
+static void test_parallel_same (const lept_value* v) {
+	static const int indents[] = { 0, 4 };
+	static const int threads[] = { 1, 2, 4 };
+	size_t i, j, length, plength;
+	char *s, *p;
+	FILE* fp;
+
+	for (i = 0; i < sizeof(indents) / sizeof(indents[0]); ++i) {
+		s = lept_stringify_pretty(v, &length, indents[i]);
+		for (j = 0; j < sizeof(threads) / sizeof(threads[0]); ++j) {
+			p = lept_stringify_parallel(v, &plength, indents[i], threads[j]);
+			EXPECT_EQ_SIZE_T(length, plength);
+			EXPECT_TRUE(p != NULL && length == plength && memcmp(s, p, length) == 0);
+			free(p);
+		}
+		if ((fp = tmpfile()) != NULL) {
+			p = (char*)malloc(length + 1);
+			EXPECT_EQ_INT(LEPT_WRITER_OK, lept_write_value_parallel(fileno(fp), v, indents[i], 3));
+			rewind(fp);
+			plength = fread(p, 1, length + 1, fp);
+			EXPECT_EQ_SIZE_T(length, plength);
+			EXPECT_TRUE(length == plength && memcmp(s, p, length) == 0);
+			free(p);
+			fclose(fp);
+		}
+		free(s);
+	}
+}
+
+static void test_stringify_parallel () {
+	lept_value v, *e;
+	char buf[64];
+	size_t i, n = 20000;
+
+	/* 小文档不拆分 */
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":[1,[],{}],\"b\":\"x\\ny\"}"));
+	test_parallel_same(&v);
+	lept_free(&v);
+
+	/* 数字和带转义的字符串组成的大数组 */
+	lept_set_array(&v, n);
+	for (i = 0; i < n; ++i) {
+		e = lept_pushback_array_element(&v);
+		if (i % 3 == 0) {
+			lept_set_number(e, i * 1.25);
+		} else if (i % 3 == 1) {
+			sprintf(buf, "s\"%zu\"\n\\t", i);
+			lept_set_string(e, buf, strlen(buf));
+		} else {
+			lept_set_array(e, 0);
+			lept_set_number(lept_pushback_array_element(e), (double)i);
+		}
+	}
+	test_parallel_same(&v);
+
+	/* {"data": [...], "meta": {...}} 拆开 data 数组 */
+	{
+		lept_value doc;
+		lept_init(&doc);
+		lept_set_object(&doc, 2);
+		lept_move(lept_set_object_value(&doc, "data", 4), &v);
+		lept_set_object(lept_set_object_value(&doc, "meta", 4), 0);
+		e = lept_set_object_value(lept_find_object_value(&doc, "meta", 4), "count", 5);
+		lept_set_number(e, (double)n);
+		test_parallel_same(&doc);
+
+		/* 大对象 */
+		lept_set_object(&v, n);
+		for (i = 0; i < n; ++i) {
+			sprintf(buf, "key%zu", i);
+			lept_set_string(lept_set_object_value(&v, buf, strlen(buf)), buf, strlen(buf));
+		}
+		test_parallel_same(&v);
+		lept_free(&v);
+		lept_free(&doc);
+	}
+
+	/* 紧凑数组 */
+	{
+		char* json = (char*)malloc(n * 12 + 2);
+		size_t len = 0;
+		json[len++] = '[';
+		for (i = 0; i < n; ++i) {
+			len += sprintf(json + len, "%s%zu.5", i ? "," : "", i);
+		}
+		json[len++] = ']';
+		json[len] = '\0';
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, json, LEPT_PARSE_PACKED_NUMBERS));
+		test_parallel_same(&v);
+		lept_free(&v);
+		free(json);
+	}
+}
+
+#define TEST_MINIFY(expect, json)\
+	do {\
+		char buf[256];\
+		size_t length;\
+		strcpy(buf, json);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(buf, strlen(buf), buf, &length));\
+		EXPECT_EQ_SIZE_T(strlen(expect), length);\
+		EXPECT_EQ_STRING(expect, buf, length);\
+	} while(0)
+
+#define TEST_MINIFY_ERROR(error, json)\
+	do {\
+		char buf[256];\
+		size_t length;\
+		EXPECT_EQ_INT(error, lept_minify(json, strlen(json), buf, &length));\
+	} while(0)
+
+static void test_minify () {
+	char* deep;
+	char out[64];
+	size_t i, length;
+	const char* s = "{ \"a\" : [ 1 , 2 ] }garbage";
+
+	TEST_MINIFY("null", " null ");
+	TEST_MINIFY("-1.5e+10", "\t-1.5e+10\r\n");
+	TEST_MINIFY("[]", "[ ]");
+	TEST_MINIFY("{}", "{\n}");
+	TEST_MINIFY("[1,2,[true,false]]", "[ 1 ,\n\t2 , [ true , false ] ]");
+	TEST_MINIFY("{\"a b\":\" x \\\" y \",\"c\":{\"d\":null}}",
+		"{\n  \"a b\": \" x \\\" y \",\n  \"c\": {\n    \"d\": null\n  }\n}");
+	TEST_MINIFY("[\"0123456789abcdef 0123456789abcdef\\u00e9\\n\",\"\\uD834\\uDD1E\"]",
+		"[ \"0123456789abcdef 0123456789abcdef\\u00e9\\n\" ,                  \"\\uD834\\uDD1E\" ]");
+
+	/* 输出到另一块缓冲区，不要求输入以 '\0' 结尾 */
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_minify(s, 12, out, &length));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(s, 19, out, &length));
+	EXPECT_EQ_SIZE_T(11, length);
+	EXPECT_EQ_STRING("{\"a\":[1,2]}", out, length);
+
+	TEST_MINIFY_ERROR(LEPT_PARSE_EXPECT_VALUE, "");
+	TEST_MINIFY_ERROR(LEPT_PARSE_EXPECT_VALUE, " ");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_VALUE, "nul");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_VALUE, "+1");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_VALUE, "1.");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_VALUE, "[1,]");
+	TEST_MINIFY_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "null x");
+	TEST_MINIFY_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "0123");
+	TEST_MINIFY_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "1e309");
+	TEST_MINIFY_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "[-1e309]");
+	TEST_MINIFY_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, "\"abc");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE, "\"\\v\"");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_STRING_CHAR, "\"\x01\"");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX, "\"\\u00G0\"");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\"");
+	TEST_MINIFY_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
+	TEST_MINIFY_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]");
+	TEST_MINIFY_ERROR(LEPT_PARSE_MISS_KEY, "{1:1}");
+	TEST_MINIFY_ERROR(LEPT_PARSE_MISS_KEY, "{\"a\":1,}");
+	TEST_MINIFY_ERROR(LEPT_PARSE_MISS_COLON, "{\"a\"}");
+	TEST_MINIFY_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1 \"b\"}");
+
+	/* 嵌套深度 */
+	deep = (char*)malloc(LEPT_SCAN_MAX_DEPTH * 2 + 2);
+	for (i = 0; i < LEPT_SCAN_MAX_DEPTH; i++) {
+		deep[i] = '[';
+		deep[LEPT_SCAN_MAX_DEPTH * 2 - 1 - i] = ']';
+	}
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(deep, LEPT_SCAN_MAX_DEPTH * 2, deep, &length));
+	EXPECT_EQ_SIZE_T(LEPT_SCAN_MAX_DEPTH * 2, length);
+	memmove(deep + 1, deep, LEPT_SCAN_MAX_DEPTH * 2);
+	deep[0] = '[';
+	deep[LEPT_SCAN_MAX_DEPTH * 2 + 1] = ']';
+	EXPECT_EQ_INT(LEPT_PARSE_DEPTH_EXCEEDED, lept_minify(deep, LEPT_SCAN_MAX_DEPTH * 2 + 2, deep, &length));
+	free(deep);
+
+	/* 数量级正好是 309 的长数字：和 lept_parse 一样判断，与数字后面有没有空白无关 */
+	{
+		char num[320];
+		char out[320];
+		lept_value v;
+		for (i = 0; i < 2; i++) {
+			size_t n = 309;
+			num[0] = i == 0 ? '2' : '1';
+			memset(num + 1, '0', n - 1);
+			num[n] = ' ';
+			num[n + 1] = '\0';
+			lept_init(&v);
+			EXPECT_EQ_INT(i == 0 ? LEPT_PARSE_NUMBER_TOO_BIG : LEPT_PARSE_OK, lept_parse(&v, num));
+			lept_free(&v);
+			EXPECT_EQ_INT(i == 0 ? LEPT_PARSE_NUMBER_TOO_BIG : LEPT_PARSE_OK, lept_minify(num, n, out, &length));
+			EXPECT_EQ_INT(i == 0 ? LEPT_PARSE_NUMBER_TOO_BIG : LEPT_PARSE_OK, lept_minify(num, n + 1, out, &length));
+			EXPECT_EQ_INT(i == 0 ? LEPT_PARSE_NUMBER_TOO_BIG : LEPT_PARSE_OK, lept_validate(num, n, NULL));
+			EXPECT_EQ_INT(i == 0 ? LEPT_PARSE_NUMBER_TOO_BIG : LEPT_PARSE_OK, lept_validate(num, n + 1, NULL));
+		}
+	}
+}
+
+#define TEST_VALIDATE_ERROR(error, offset, json)\
+	do {\
+		size_t off = 0;\
+		EXPECT_EQ_INT(error, lept_validate(json, strlen(json), &off));\
+		EXPECT_EQ_SIZE_T(offset, off);\
+	} while(0)
+
+static void test_validate () {
+	const char* s = "{\"a\":[1,2]}[";
+	const char* nested = " [ 1 , \"a\\u00e9\" , { \"k\" : [ ] } ] ";
+
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("null", 4, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(nested, strlen(nested), NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(s, 11, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_validate(s, 12, NULL));
+
+	TEST_VALIDATE_ERROR(LEPT_PARSE_EXPECT_VALUE, 2, "  ");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_INVALID_VALUE, 3, "[1,nul]");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, 5, "null x");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, 1, "[1e309]");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, 8, "[\"abcdef");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE, 2, "\"a\\v\"");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_INVALID_STRING_CHAR, 3, "\"ab\x01\"");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, 1, "\"\\uDC00\"");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, 3, "[1 2]");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_MISS_KEY, 7, "{\"a\":1,}");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_MISS_COLON, 5, "{\"a\" 1}");
+	TEST_VALIDATE_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, 6, "{\"a\":1]");
+}
+
+#define TEST_UTF8_ERROR(json)\
+	do {\
+		lept_value v;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(LEPT_PARSE_INVALID_UTF8, lept_parse_ex(&v, json, LEPT_PARSE_VALIDATE_UTF8));\
+		EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+		lept_free(&v);\
+	} while(0)
+
+static void test_parse_utf8 () {
+	/* 有效和无效的字节序列，拼成各种组合来比较逐字节检查和 SSSE3 的结果 */
+	static const unsigned char bytes[] = {
+		'a', 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF,
+		0xE0, 0xE1, 0xED, 0xEF, 0xF0, 0xF1, 0xF4, 0xF5, 0xFF
+	};
+	const size_t n = sizeof(bytes);
+	char buf[40];
+	size_t i, j, k, mismatch = 0;
+	lept_value v;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "\"\xC2\xA2\xE2\x82\xAC\xF0\x9D\x84\x9E\xEF\xBF\xBF\xF4\x8F\xBF\xBF\"", LEPT_PARSE_VALIDATE_UTF8));
+	EXPECT_EQ_SIZE_T(16, lept_get_string_length(&v));
+	lept_free(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "{\"\xE4\xB8\xAD\xE6\x96\x87 and some ascii to fill a block\":[\"\\u00e9\xC3\xA9\"]}", LEPT_PARSE_VALIDATE_UTF8));
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v));
+	lept_free(&v);
+
+	TEST_UTF8_ERROR("\"\x80\"");
+	TEST_UTF8_ERROR("\"\xC0\x80\"");					/* 过长编码 */
+	TEST_UTF8_ERROR("\"\xE0\x80\x80\"");
+	TEST_UTF8_ERROR("\"\xF0\x80\x80\x80\"");
+	TEST_UTF8_ERROR("\"\xED\xA0\x80\"");				/* 代理区 */
+	TEST_UTF8_ERROR("\"\xF4\x90\x80\x80\"");			/* 大于 U+10FFFF */
+	TEST_UTF8_ERROR("\"\xF5\x80\x80\x80\"");
+	TEST_UTF8_ERROR("\"\xE2\x82\"");					/* 序列没有结束 */
+	TEST_UTF8_ERROR("\"\xE2\x82\\n\"");
+	TEST_UTF8_ERROR("\"0123456789abcdef0123456789\xE2\x82\"");
+	TEST_UTF8_ERROR("\"0123456789abcdef01234\xC3\"");
+	TEST_UTF8_ERROR("\"0123456789abcdef0123456789abcdef\xFF\"");
+	TEST_UTF8_ERROR("[\"ok\",{\"\xC3\x28\":1}]");
+
+	/* 短输入走逐字节检查，前面补足 ASCII 之后走 SSSE3，序列落在块边界上 */
+	memset(buf, 'x', sizeof(buf));
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			for (k = 0; k < n; k++) {
+				char seq[4];
+				int expect;
+				seq[0] = (char)bytes[i];
+				seq[1] = (char)bytes[j];
+				seq[2] = (char)bytes[k];
+				seq[3] = (char)0x80;
+				expect = lept_scan_utf8(seq, 3);
+				memcpy(buf + 14, seq, 3);
+				mismatch += lept_scan_utf8(buf, 17) != expect;
+				mismatch += lept_scan_utf8(buf, 30) != expect;
+				memcpy(buf + 14, seq, 4);
+				mismatch += lept_scan_utf8(buf, 20) != lept_scan_utf8(seq, 4);
+				buf[17] = 'x';
+			}
+	EXPECT_EQ_SIZE_T(0, mismatch);
+}
+
+/**
+ * 各种长度的空白，以及紧贴在不可读页之前、以 '\0' 结尾的输入。
+ */
+static void test_parse_whitespace () {
+	char buf[256];
+	size_t i, j, page = (size_t)sysconf(_SC_PAGESIZE);
+	char* mem;
+	lept_value v;
+
+	lept_init(&v);
+	for (i = 0; i < 80; i++) {
+		j = 0;
+		buf[j++] = '[';
+		memset(buf + j, " \t\n\r"[i & 3], i); j += i;
+		buf[j++] = '1';
+		memset(buf + j, ' ', i); j += i;
+		buf[j++] = ']';
+		memset(buf + j, '\n', i); j += i;
+		buf[j] = '\0';
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, buf));
+		EXPECT_EQ_SIZE_T(1, lept_get_array_size(&v));
+		lept_free(&v);
+	}
+
+	mem = (char*)mmap(NULL, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem != MAP_FAILED) {
+		mprotect(mem + page, page, PROT_NONE);
+		for (i = 2; i < 40; i++) {
+			char* json = mem + page - i;
+			json[0] = '0';
+			memset(json + 1, ' ', i - 2);
+			json[i - 1] = '\0';
+			EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+		}
+		munmap(mem, page * 2);
+	}
+}
+
+#define TEST_SHARED_THREADS 8
+
+/**
+ * 每个线程反复 retain、读取、release，同时主线程已经放掉了自己的引用。
+ */
+static void* test_shared_reader (void* arg) {
+	lept_shared* s = (lept_shared*)arg;
+	const lept_value* v;
+	size_t i, sum = 0;
+
+	for (i = 0; i < 10000; i++) {
+		lept_shared* t = lept_shared_retain(s);
+		v = lept_shared_get(t);
+		sum += (size_t)lept_get_array_number(v, i % 3);
+		lept_shared_release(t);
+	}
+	lept_shared_release(s);
+	return (void*)sum;
+}
+
+static void test_shared () {
+	lept_value v;
+	lept_shared* root;
+	lept_shared* child;
+	const lept_value* a;
+	pthread_t threads[TEST_SHARED_THREADS];
+	size_t i, ok = 0;
+	void* sum;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "{\"name\":\"cfg\",\"a\":[1,2,3]}", LEPT_PARSE_PACKED_NUMBERS));
+	root = lept_shared_new(&v);
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	EXPECT_EQ_SIZE_T(1, lept_shared_refcount(root));
+	EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(lept_shared_get(root)));
+
+	/* 紧凑数组共享之后仍然紧凑，只读访问不会展开它 */
+	a = lept_find_object_value((lept_value*)lept_shared_get(root), "a", 1);
+	EXPECT_TRUE(lept_is_array_packed(a));
+
+	/* 子树句柄持有根的引用，根句柄先释放也没关系 */
+	child = lept_shared_child(root, a);
+	EXPECT_EQ_SIZE_T(2, lept_shared_refcount(root));
+	EXPECT_TRUE(lept_shared_get(child) == a);
+	EXPECT_TRUE(lept_shared_retain(root) == root);
+	EXPECT_EQ_SIZE_T(3, lept_shared_refcount(root));
+	lept_shared_release(root);
+	lept_shared_release(root);
+
+	for (i = 0; i < TEST_SHARED_THREADS; i++) {
+		pthread_create(&threads[i], NULL, test_shared_reader, lept_shared_retain(child));
+	}
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_shared_get(child)));
+	lept_shared_release(child);
+	for (i = 0; i < TEST_SHARED_THREADS; i++) {
+		pthread_join(threads[i], &sum);
+		ok += (size_t)sum == 19999;
+	}
+	EXPECT_EQ_SIZE_T(TEST_SHARED_THREADS, ok);
+}
+
+#define TEST_MERGE_PATCH(expect, target, patch)\
+	do {\
+		lept_value t, p;\
+		char* json;\
+		size_t length;\
+		lept_init(&t);\
+		lept_init(&p);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&t, target));\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, patch));\
+		lept_merge_patch(&t, &p);\
+		json = lept_stringify(&t, &length);\
+		EXPECT_EQ_STRING(expect, json, length);\
+		EXPECT_EQ_SIZE_T(strlen(expect), length);\
+		lept_free(&t);\
+		lept_free(&p);\
+		free(json);\
+	} while(0)
+
+static void test_merge_patch () {
+	/* RFC 7386 附录 A */
+	TEST_MERGE_PATCH("{\"a\":\"c\"}", "{\"a\":\"b\"}", "{\"a\":\"c\"}");
+	TEST_MERGE_PATCH("{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":\"b\"}", "{\"b\":\"c\"}");
+	TEST_MERGE_PATCH("{}", "{\"a\":\"b\"}", "{\"a\":null}");
+	TEST_MERGE_PATCH("{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}");
+	TEST_MERGE_PATCH("{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":\"c\"}");
+	TEST_MERGE_PATCH("{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":[\"b\"]}");
+	TEST_MERGE_PATCH("{\"a\":{\"b\":\"d\"}}", "{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}");
+	TEST_MERGE_PATCH("{\"a\":[1]}", "{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}");
+	TEST_MERGE_PATCH("[\"c\",\"d\"]", "[\"a\",\"b\"]", "[\"c\",\"d\"]");
+	TEST_MERGE_PATCH("[\"c\"]", "{\"a\":\"b\"}", "[\"c\"]");
+	TEST_MERGE_PATCH("null", "{\"a\":\"foo\"}", "null");
+	TEST_MERGE_PATCH("\"bar\"", "{\"a\":\"foo\"}", "\"bar\"");
+	TEST_MERGE_PATCH("{\"e\":null,\"a\":1}", "{\"e\":null}", "{\"a\":1}");
+	TEST_MERGE_PATCH("{\"a\":\"b\"}", "[1,2]", "{\"a\":\"b\",\"c\":null}");
+	TEST_MERGE_PATCH("{\"a\":{\"bb\":{}}}", "{}", "{\"a\":{\"bb\":{\"ccc\":null}}}");
+}
+
+#define TEST_PATCH(error, expect, target, ops)\
+	do {\
+		lept_value t, o;\
+		char* json;\
+		size_t length;\
+		lept_init(&t);\
+		lept_init(&o);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&t, target));\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&o, ops));\
+		EXPECT_EQ_INT(error, lept_apply_patch(&t, &o));\
+		json = lept_stringify(&t, &length);\
+		EXPECT_EQ_STRING(expect, json, length);\
+		EXPECT_EQ_SIZE_T(strlen(expect), length);\
+		lept_free(&t);\
+		lept_free(&o);\
+		free(json);\
+	} while(0)
+
+static void test_apply_patch () {
+	/* RFC 6902 附录 A */
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\",\"baz\":\"qux\"}",
+		"{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"qux\",\"baz\"]}",
+		"{\"foo\":[\"bar\",\"baz\"]}", "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\"}",
+		"{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"remove\",\"path\":\"/baz\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"baz\"]}",
+		"{\"foo\":[\"bar\",\"qux\",\"baz\"]}", "[{\"op\":\"remove\",\"path\":\"/foo/1\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"boo\",\"foo\":\"bar\"}",
+		"{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":{\"bar\":\"baz\"},\"qux\":{\"corge\":\"grault\",\"thud\":\"fred\"}}",
+		"{\"foo\":{\"bar\":\"baz\",\"waldo\":\"fred\"},\"qux\":{\"corge\":\"grault\"}}",
+		"[{\"op\":\"move\",\"from\":\"/foo/waldo\",\"path\":\"/qux/thud\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}",
+		"{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}", "[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+		"{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+		"[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"qux\"},{\"op\":\"test\",\"path\":\"/foo/1\",\"value\":2}]");
+	TEST_PATCH(LEPT_PATCH_TEST_FAILED, "{\"baz\":\"qux\"}",
+		"{\"baz\":\"qux\"}", "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"bar\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\",\"child\":{\"grandchild\":{}}}",
+		"{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/child\",\"value\":{\"grandchild\":{}}}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"foo\":\"bar\"}",
+		"{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz/bat\",\"value\":\"qux\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"/\":9,\"~1\":10,\"~\":1}",
+		"{\"/\":9,\"~1\":10}", "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":10},{\"op\":\"copy\",\"from\":\"/~1\",\"path\":\"/~0\"},{\"op\":\"replace\",\"path\":\"/~0\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",[\"abc\",\"def\"]]}",
+		"{\"foo\":[\"bar\"]}", "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[\"abc\",\"def\"]}]");
+
+	/* 整个文档、紧凑数组和对象成员的顺序无关比较 */
+	TEST_PATCH(LEPT_PATCH_OK, "[1,2]", "{\"a\":1}", "[{\"op\":\"replace\",\"path\":\"\",\"value\":[1,2]}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"x\":{\"b\":2,\"a\":1},\"y\":[1,2.5]}", "{\"x\":{\"b\":2,\"a\":1},\"y\":[1,2.5]}",
+		"[{\"op\":\"test\",\"path\":\"/x\",\"value\":{\"a\":1,\"b\":2}},{\"op\":\"test\",\"path\":\"\",\"value\":{\"y\":[1,2.5],\"x\":{\"a\":1,\"b\":2}}}]");
+
+	/* 出错时前面的操作全部撤销 */
+	TEST_PATCH(LEPT_PATCH_TEST_FAILED, "{\"a\":[1,2,3],\"b\":{\"c\":1}}", "{\"a\":[1,2,3],\"b\":{\"c\":1}}",
+		"[{\"op\":\"add\",\"path\":\"/a/0\",\"value\":0},{\"op\":\"remove\",\"path\":\"/a/3\"},"
+		"{\"op\":\"replace\",\"path\":\"/b/c\",\"value\":[true]},{\"op\":\"add\",\"path\":\"/b/d\",\"value\":\"x\"},"
+		"{\"op\":\"move\",\"from\":\"/b\",\"path\":\"/a/-\"},{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/e\"},"
+		"{\"op\":\"add\",\"path\":\"\",\"value\":{\"z\":1}},{\"op\":\"move\",\"from\":\"/z\",\"path\":\"\"},"
+		"{\"op\":\"test\",\"path\":\"\",\"value\":2}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":{\"b\":1},\"c\":[]}", "{\"a\":{\"b\":1},\"c\":[]}",
+		"[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/c/1\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"a\":{\"x\":1,\"x\":2},\"b\":{\"x\":1,\"x\":2}}", "{\"a\":{\"x\":1,\"x\":2}}",
+		"[{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/b\"}]");
+	/* 有重复的键时，撤销放回被删掉的那个成员，不覆盖留下的同名成员 */
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":1,\"a\":2}", "{\"a\":1,\"a\":2}",
+		"[{\"op\":\"remove\",\"path\":\"/a\"},{\"op\":\"test\",\"path\":\"/x\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_TEST_FAILED, "{\"a\":1,\"b\":0,\"a\":2}", "{\"a\":1,\"b\":0,\"a\":2}",
+		"[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/c\"},{\"op\":\"remove\",\"path\":\"/a\"},"
+		"{\"op\":\"add\",\"path\":\"/a\",\"value\":3},{\"op\":\"test\",\"path\":\"/c\",\"value\":2}]");
+
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "{\"op\":\"add\"}");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[{\"op\":\"add\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[{\"op\":\"frobnicate\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[{\"op\":\"move\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[1]");
+	TEST_PATCH(LEPT_PATCH_INVALID_POINTER, "{}", "{}", "[{\"op\":\"add\",\"path\":\"a\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_POINTER, "{}", "{}", "[{\"op\":\"add\",\"path\":\"/~2\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "[1]", "[1]", "[{\"op\":\"add\",\"path\":\"/01\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "[1]", "[1]", "[{\"op\":\"add\",\"path\":\"/2\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "[1]", "[1]", "[{\"op\":\"remove\",\"path\":\"/1\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "[1]", "[1]", "[{\"op\":\"remove\",\"path\":\"\"}]");
+	TEST_PATCH(LEPT_PATCH_MOVE_INTO_CHILD, "{\"a\":{}}", "{\"a\":{}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/b\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"a\":{}}", "{\"a\":{}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"a\":{}}", "{\"a\":{}}", "[]");
+}
+
+#define TEST_EQUAL(json1, json2, equality)\
+	do {\
+		lept_value v1, v2;\
+		lept_init(&v1);\
+		lept_init(&v2);\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, json1));\
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json2));\
+		EXPECT_EQ_INT(equality, lept_is_equal(&v1, &v2));\
+		EXPECT_EQ_INT(equality, lept_is_equal(&v2, &v1));\
+		if (equality)\
+			EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));\
+		else\
+			EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));\
+		lept_free(&v1);\
+		lept_free(&v2);\
+	} while(0)
+
+static void test_equal () {
+	lept_value v1, v2;
+	size_t i, depth = 100000;
+
+	TEST_EQUAL("true", "true", 1);
+	TEST_EQUAL("true", "false", 0);
+	TEST_EQUAL("false", "false", 1);
+	TEST_EQUAL("null", "null", 1);
+	TEST_EQUAL("null", "0", 0);
+	TEST_EQUAL("123", "123", 1);
+	TEST_EQUAL("123", "456", 0);
+	TEST_EQUAL("0", "-0", 1);
+	TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+	TEST_EQUAL("\"abc\"", "\"abcd\"", 0);
+	TEST_EQUAL("\"a\\u0000b\"", "\"a\\u0000c\"", 0);
+	TEST_EQUAL("[]", "[]", 1);
+	TEST_EQUAL("[]", "null", 0);
+	TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+	TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+	TEST_EQUAL("[1,2,3]", "[3,2,1]", 0);
+	TEST_EQUAL("[[]]", "[[]]", 1);
+	TEST_EQUAL("[[],{}]", "[{},[]]", 0);
+	TEST_EQUAL("{}", "{}", 1);
+	TEST_EQUAL("{}", "null", 0);
+	TEST_EQUAL("{}", "[]", 0);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":2}", 0);
+	TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+	TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+	TEST_EQUAL("{\"a\":{\"x\":1,\"y\":[1,{\"p\":1,\"q\":2}]},\"b\":2}", "{\"b\":2,\"a\":{\"y\":[1,{\"q\":2,\"p\":1}],\"x\":1}}", 1);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":2,\"b\":1}", 0);
+
+	/* 重复的键：每个成员只配对一次，同一个键按出现顺序对应 */
+	TEST_EQUAL("{\"x\":1,\"x\":1}", "{\"x\":1,\"y\":2}", 0);
+	TEST_EQUAL("{\"x\":1,\"y\":2,\"x\":3}", "{\"y\":2,\"x\":1,\"x\":3}", 1);
+	TEST_EQUAL("{\"z\":0,\"x\":{\"b\":1,\"a\":2},\"x\":3}", "{\"x\":{\"a\":2,\"b\":1},\"x\":3,\"z\":0}", 1);
+	lept_init(&v1);
+	lept_init(&v2);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"x\":1,\"x\":2}"));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "{\"x\":2,\"x\":1}"));
+	EXPECT_FALSE(lept_is_equal(&v1, &v2));
+	EXPECT_FALSE(lept_is_equal(&v2, &v1));
+	lept_free(&v1);
+	lept_free(&v2);
+
+	/* 紧凑数组和普通数组 */
+	lept_init(&v1);
+	lept_init(&v2);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v1, "[[1,2.5,-0],{\"a\":[3]}]", LEPT_PARSE_PACKED_NUMBERS));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "[[1,2.5,0],{\"a\":[3]}]"));
+	EXPECT_TRUE(lept_is_equal(&v1, &v2));
+	EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));
+	lept_set_number(lept_get_array_element(lept_get_array_element(&v2, 0), 2), 1);
+	EXPECT_FALSE(lept_is_equal(&v1, &v2));
+	lept_set_string(lept_get_array_element(lept_get_array_element(&v2, 0), 2), "0", 1);
+	EXPECT_FALSE(lept_is_equal(&v1, &v2));
+	lept_free(&v1);
+	lept_free(&v2);
+
+	/* 很深的嵌套不会栈溢出 */
+	lept_set_array(&v1, 0);
+	lept_set_array(&v2, 0);
+	{
+		lept_value* p1 = &v1;
+		lept_value* p2 = &v2;
+		for (i = 0; i < depth; i++) {
+			p1 = lept_pushback_array_element(p1);
+			p2 = lept_pushback_array_element(p2);
+			lept_set_array(p1, 0);
+			lept_set_array(p2, 0);
+		}
+		EXPECT_TRUE(lept_is_equal(&v1, &v2));
+		EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));
+		lept_set_number(lept_pushback_array_element(p2), 1);
+		EXPECT_FALSE(lept_is_equal(&v1, &v2));
+		EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));
+	}
+	lept_free(&v1);
+	lept_free(&v2);
+}
+
+#define TEST_PROJECTED(expect, json, ...)\
+	do {\
+		const char* paths[] = { __VA_ARGS__ };\
+		lept_projection* proj = lept_projection_compile(paths, sizeof(paths) / sizeof(paths[0]));\
+		lept_value v;\
+		char* out;\
+		size_t length;\
+		unsigned k;\
+		EXPECT_TRUE(proj != NULL);\
+		for (k = 0; k < 2; k++) {\
+			lept_init(&v);\
+			EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, json, proj, k ? LEPT_PARSE_TRUST_SKIPPED : 0));\
+			out = lept_stringify(&v, &length);\
+			EXPECT_EQ_STRING(expect, out, length);\
+			free(out);\
+			lept_free(&v);\
+		}\
+		lept_projection_free(proj);\
+	} while(0)
+
+#define TEST_PROJECTED_ERROR(error, trusted_error, json, path)\
+	do {\
+		const char* paths[] = { path };\
+		lept_projection* proj = lept_projection_compile(paths, 1);\
+		lept_value v;\
+		lept_init(&v);\
+		EXPECT_EQ_INT(error, lept_parse_projected(&v, json, proj, 0));\
+		lept_free(&v);\
+		EXPECT_EQ_INT(trusted_error, lept_parse_projected(&v, json, proj, LEPT_PARSE_TRUST_SKIPPED));\
+		lept_free(&v);\
+		lept_projection_free(proj);\
+	} while(0)
+
+static void test_parse_projected () {
+	const char* doc =
+		"{\"id\":7,\"user\":{\"name\":\"ann\",\"age\":30,\"tags\":[\"a\",\"]\\\"}\"]},"
+		"\"items\":[{\"price\":1.5,\"sku\":\"x\"},{\"sku\":\"y\"},3,{\"price\":2,\"qty\":{\"n\":[1,2]}}],"
+		"\"meta\":{\"a\":[[[]]],\"b\":\"{[\"}}";
+	const char* bad[] = { "a..b", ".a", "a.", "a[0]", "a[*", "a.[*]", "[]" };
+	lept_projection* none;
+	lept_value v;
+	size_t i;
+
+	TEST_PROJECTED("{\"id\":7}", doc, "id");
+	TEST_PROJECTED("{\"user\":{\"name\":\"ann\"}}", doc, "user.name");
+	TEST_PROJECTED("{\"items\":[{\"price\":1.5},{},{\"price\":2}]}", doc, "items[*].price");
+	TEST_PROJECTED("{\"id\":7,\"user\":{\"name\":\"ann\"},\"items\":[{\"price\":1.5},{},{\"price\":2}]}",
+		doc, "id", "user.name", "items[*].price");
+	/* 选中整个值时，子路径不再起作用 */
+	TEST_PROJECTED("{\"user\":{\"name\":\"ann\",\"age\":30,\"tags\":[\"a\",\"]\\\"}\"]}}", doc, "user.name", "user");
+	TEST_PROJECTED("{\"meta\":{\"b\":\"{[\"}}", doc, "meta.b");
+	TEST_PROJECTED("{\"items\":[{},{},{\"qty\":{\"n\":[1,2]}}]}", doc, "items[*].qty.n");
+	/* 形状对不上的值略去 */
+	TEST_PROJECTED("{}", doc, "id.x");
+	TEST_PROJECTED("{}", doc, "nothing");
+	TEST_PROJECTED("{\"user\":{}}", doc, "user[*]", "user.none");
+	TEST_PROJECTED("null", "[1,2]", "a");
+	TEST_PROJECTED("[1,2]", "[1,2]", "");
+	TEST_PROJECTED("[{\"id\":1},{\"id\":3}]", " [ {\"id\" : 1 , \"x\" : 2} , { \"id\" : 3 } ] ", "[*].id");
+	TEST_PROJECTED("[[{\"a\":2}],[]]", "[[{\"a\":2},1],[]]", "[*][*].a");
+	/* 键按转义之后的内容匹配 */
+	TEST_PROJECTED("{\"a\":1}", "{\"\\u0061\":1,\"b\":2}", "a");
+
+	for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		EXPECT_TRUE(lept_projection_compile(&bad[i], 1) == NULL);
+	}
+	/* 没有路径时什么也不选 */
+	none = lept_projection_compile(NULL, 0);
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, doc, none, 0));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	lept_projection_free(none);
+
+	/* 元素全部被跳过的数组是普通的空数组，不按紧凑存储 */
+	{
+		const char* path = "[*].a";
+		lept_projection* proj = lept_projection_compile(&path, 1);
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, "[1,2]", proj, LEPT_PARSE_PACKED_NUMBERS));
+		EXPECT_EQ_SIZE_T(0, lept_get_array_size(&v));
+		EXPECT_FALSE(lept_is_array_packed(&v));
+		lept_free(&v);
+		lept_projection_free(proj);
+	}
+
+	/* 跳过的部分默认仍然检查，TRUST_SKIPPED 时只认括号和字符串 */
+	TEST_PROJECTED_ERROR(LEPT_PARSE_INVALID_VALUE, LEPT_PARSE_OK, "{\"a\":1,\"b\":[tru]}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, LEPT_PARSE_OK, "{\"a\":1,\"b\":[1 2]}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE, LEPT_PARSE_OK, "{\"b\":\"\\x\",\"a\":1}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, LEPT_PARSE_MISS_QUOTATION_MARK, "{\"a\":1,\"b\":\"abc}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1,\"b\":{\"c\":[1]}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "{\"a\":1,\"b\":[[1]", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_INVALID_VALUE, LEPT_PARSE_EXPECT_VALUE, "{\"a\":1,\"b\":}", "a");
+	/* 选中部分和结构上的错误与 lept_parse 相同 */
+	TEST_PROJECTED_ERROR(LEPT_PARSE_INVALID_VALUE, LEPT_PARSE_INVALID_VALUE, "{\"b\":1,\"a\":[tru]}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_MISS_COLON, LEPT_PARSE_MISS_COLON, "{\"b\" 1,\"a\":1}", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, LEPT_PARSE_ROOT_NOT_SINGULAR, "{\"b\":1} x", "a");
+	TEST_PROJECTED_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1 \"b\":2}", "a");
+}
+
+#define TEST_LIMIT(error, json, field, limit)\
+	do {\
+		lept_parse_limits limits;\
+		lept_value v;\
+		memset(&limits, 0, sizeof(limits));\
+		limits.field = (limit);\
+		lept_init(&v);\
+		EXPECT_EQ_INT(error, lept_parse_limited(&v, json, 0, &limits));\
+		if ((error) != LEPT_PARSE_OK) {\
+			EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+		}\
+		lept_free(&v);\
+	} while(0)
+
+static void test_parse_limits () {
+	lept_parse_limits limits;
+	lept_value v;
+	char* json;
+	size_t i, n = 1 << 20;
+
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_limited(&v, "[1,{\"a\":\"b\"}]", 0, NULL));
+	EXPECT_EQ_SIZE_T(2, lept_get_array_size(&v));
+	lept_free(&v);
+
+	TEST_LIMIT(LEPT_PARSE_OK, " [1,2] ", max_input, 7);
+	TEST_LIMIT(LEPT_PARSE_INPUT_TOO_LARGE, " [1,2] ", max_input, 6);
+
+	/* 容器本身也是节点 */
+	TEST_LIMIT(LEPT_PARSE_OK, "[1,[2,3]]", max_nodes, 5);
+	TEST_LIMIT(LEPT_PARSE_TOO_MANY_NODES, "[1,[2,3]]", max_nodes, 4);
+	TEST_LIMIT(LEPT_PARSE_TOO_MANY_NODES, "{\"a\":null,\"b\":null}", max_nodes, 2);
+
+	/* 按转义之后的字节数计算，键也受限制 */
+	TEST_LIMIT(LEPT_PARSE_OK, "\"abc\"", max_string, 3);
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, "\"abcd\"", max_string, 3);
+	TEST_LIMIT(LEPT_PARSE_OK, "\"\\u00e9\\n\"", max_string, 3);
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, "\"\\u00e9\\n\"", max_string, 2);
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, "\"a\\u00e9\"", max_string, 2);
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, "{\"abcd\":\"x\"}", max_string, 3);
+
+	TEST_LIMIT(LEPT_PARSE_OK, "[[1,2,3],{\"a\":1,\"b\":2,\"c\":3}]", max_container, 3);
+	TEST_LIMIT(LEPT_PARSE_CONTAINER_TOO_LARGE, "[[1,2,3],4]", max_container, 2);
+	TEST_LIMIT(LEPT_PARSE_CONTAINER_TOO_LARGE, "[{\"a\":1,\"b\":2,\"c\":3}]", max_container, 2);
+
+	/* 数组元素按 lept_value 计算，成员按 lept_member 加上键的长度计算 */
+	TEST_LIMIT(LEPT_PARSE_OK, "[\"ab\"]", max_bytes, sizeof(lept_value) + 3);
+	TEST_LIMIT(LEPT_PARSE_TOO_MANY_BYTES, "[\"ab\"]", max_bytes, sizeof(lept_value) + 2);
+	TEST_LIMIT(LEPT_PARSE_OK, "{\"k\":1}", max_bytes, sizeof(lept_member) + 2);
+	TEST_LIMIT(LEPT_PARSE_TOO_MANY_BYTES, "{\"k\":1}", max_bytes, sizeof(lept_member) + 1);
+	TEST_LIMIT(LEPT_PARSE_TOO_MANY_BYTES, "{\"key\":1}", max_bytes, 3);
+
+	/* 超长的字符串在上限处就停下 */
+	json = (char*)malloc(n + 3);
+	json[0] = '"';
+	memset(json + 1, 'x', n);
+	json[n + 1] = '"';
+	json[n + 2] = '\0';
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, json, max_string, 1000);
+	TEST_LIMIT(LEPT_PARSE_OK, json, max_string, n);
+	free(json);
+
+	/* 全是转义的字符串也在上限处停下，不会先把整段转义写进栈 */
+	json = (char*)malloc(n + 3);
+	json[0] = '"';
+	for (i = 0; i < n / 2; i++) {
+		json[1 + 2 * i] = '\\';
+		json[2 + 2 * i] = 'n';
+	}
+	json[n + 1] = '"';
+	json[n + 2] = '\0';
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, json, max_string, 1000);
+	TEST_LIMIT(LEPT_PARSE_OK, json, max_string, n / 2);
+	TEST_LIMIT(LEPT_PARSE_STRING_TOO_LONG, json, max_string, n / 2 - 1);
+	free(json);
+
+	/* 语法错误照常返回，多个上限同时生效 */
+	memset(&limits, 0, sizeof(limits));
+	limits.max_nodes = 100;
+	limits.max_container = 10;
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_parse_limited(&v, "[1,2", 0, &limits));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_limited(&v, "[1,2,3]", LEPT_PARSE_PACKED_NUMBERS, &limits));
+	EXPECT_TRUE(lept_is_array_packed(&v));
+	lept_free(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_CONTAINER_TOO_LARGE, lept_parse_limited(&v, "[[0,1,2,3,4,5,6,7,8,9,10]]", LEPT_PARSE_PACKED_NUMBERS, &limits));
+
+	/* 紧凑数组的 double 块也计入 max_bytes */
+	memset(&limits, 0, sizeof(limits));
+	limits.max_bytes = 3 * (sizeof(lept_value) + sizeof(double));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_limited(&v, "[1,2,3]", LEPT_PARSE_PACKED_NUMBERS, &limits));
+	lept_free(&v);
+	limits.max_bytes--;
+	EXPECT_EQ_INT(LEPT_PARSE_TOO_MANY_BYTES, lept_parse_limited(&v, "[1,2,3]", LEPT_PARSE_PACKED_NUMBERS, &limits));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_limited(&v, "[1,2,3]", 0, &limits));
+	lept_free(&v);
+}
+
 static void test_parse () {
   test_parse_literal();
   test_parse_number();
@@ -371,6 +2013,8 @@ static void test_parse () {
   test_parse_number_too_big();
   test_parse_string();
 	test_parse_array(); 
+	test_parse_packed_array();
+	test_parse_raw_numbers();
 	test_parse_object(); 
 	test_parse_miss_key();
 	test_parse_miss_comma_or_curly_bracket();
@@ -381,6 +2025,11 @@ static void test_parse () {
 	test_parse_missing_quotation_mark();
 	test_parse_invalid_unicode_hex();
 	test_parse_invalid_unicode_surrogate();
+	test_parse_utf8();
+	test_parse_whitespace();
+	test_parse_escape_run();
+	test_parse_projected();
+	test_parse_limits();
 }
 
 static void test_access () {
@@ -388,11 +2037,436 @@ static void test_access () {
   test_access_boolean();
   test_access_number();
   test_access_null();
+  test_access_array();
+  test_access_object();
+  test_copy_move_swap();
+}
+
+#define TEST_CACHE_THREADS 8
+
+static lept_cache* test_cache_shared;
+
+/**
+ * 所有线程反复解析同样的几份输入，得到的树必须和直接解析的一样。
+ */
+static void* test_cache_reader (void* arg) {
+	static const char* inputs[] = { "[1,2,3]", "{\"a\":true}", "\"x\"" };
+	lept_shared* doc;
+	size_t i, ok = 0;
+
+	(void)arg;
+	for (i = 0; i < 3000; i++) {
+		if (lept_cache_parse(test_cache_shared, inputs[i % 3], 0, &doc) != LEPT_PARSE_OK) {
+			continue;
+		}
+		switch (i % 3) {
+			case 0: ok += lept_get_array_size(lept_shared_get(doc)) == 3; break;
+			case 1: ok += lept_get_object_size(lept_shared_get(doc)) == 1; break;
+			case 2: ok += lept_get_type(lept_shared_get(doc)) == LEPT_STRING; break;
+		}
+		lept_shared_release(doc);
+	}
+	return (void*)ok;
+}
+
+static void test_cache () {
+	lept_cache* c = lept_cache_new(1 << 20);
+	lept_cache_stats st;
+	lept_shared* d1;
+	lept_shared* d2;
+	lept_shared* d3;
+	pthread_t threads[TEST_CACHE_THREADS];
+	char json[32];
+	size_t i, ok = 0;
+	void* sum;
+
+	/* 相同的输入返回同一棵树 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "{\"a\":[1,2,3]}", 0, &d1));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "{\"a\":[1,2,3]}", 0, &d2));
+	EXPECT_TRUE(d1 == d2);
+	EXPECT_EQ_SIZE_T(3, lept_shared_refcount(d1));
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_find_object_value((lept_value*)lept_shared_get(d1), "a", 1)));
+
+	/* 内容、长度或选项不同都是不同的键 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "{\"a\":[1,2,4]}", 0, &d3));
+	EXPECT_TRUE(d3 != d1);
+	lept_shared_release(d3);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "{\"a\":[1,2,3]} ", 0, &d3));
+	EXPECT_TRUE(d3 != d1);
+	lept_shared_release(d3);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "{\"a\":[1,2,3]}", LEPT_PARSE_PACKED_NUMBERS, &d3));
+	EXPECT_TRUE(d3 != d1);
+	EXPECT_TRUE(lept_is_equal(lept_shared_get(d1), lept_shared_get(d3)));
+	lept_shared_release(d3);
+
+	/* 解析失败的输入不缓存 */
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_cache_parse(c, "[1", 0, &d3));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_cache_parse(c, "[1", 0, &d3));
+
+	lept_cache_get_stats(c, &st);
+	EXPECT_EQ_SIZE_T(1, st.hits);
+	EXPECT_EQ_SIZE_T(6, st.misses);
+	EXPECT_EQ_SIZE_T(4, st.entries);
+	EXPECT_EQ_SIZE_T(0, st.evictions);
+
+	/* 清空之后调用方的句柄仍然有效 */
+	lept_cache_clear(c);
+	lept_cache_get_stats(c, &st);
+	EXPECT_EQ_SIZE_T(0, st.entries);
+	EXPECT_EQ_SIZE_T(0, st.bytes);
+	EXPECT_EQ_SIZE_T(2, lept_shared_refcount(d1));
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_find_object_value((lept_value*)lept_shared_get(d2), "a", 1)));
+	lept_shared_release(d1);
+	lept_shared_release(d2);
+	lept_cache_free(c);
+
+	/* 预算只够放几份文档时按 LRU 淘汰 */
+	c = lept_cache_new(1024);
+	for (i = 0; i < 100; i++) {
+		sprintf(json, "[%d,\"%d\"]", (int)i, (int)i);
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, json, 0, &d1));
+		lept_shared_release(d1);
+		/* 第一份一直在用，不会被淘汰 */
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "[0,\"0\"]", 0, &d1));
+		lept_shared_release(d1);
+		lept_cache_get_stats(c, &st);
+		EXPECT_TRUE(st.bytes <= 1024);
+	}
+	lept_cache_get_stats(c, &st);
+	EXPECT_TRUE(st.evictions > 0);
+	EXPECT_EQ_SIZE_T(100, st.evictions + st.entries);
+	EXPECT_EQ_SIZE_T(100, st.misses);
+	EXPECT_EQ_SIZE_T(100, st.hits);
+	lept_cache_free(c);
+
+	/* 超过预算的文档照常解析，但不缓存 */
+	c = lept_cache_new(16);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cache_parse(c, "[1,2,3]", 0, &d1));
+	EXPECT_EQ_SIZE_T(1, lept_shared_refcount(d1));
+	lept_shared_release(d1);
+	lept_cache_get_stats(c, &st);
+	EXPECT_EQ_SIZE_T(0, st.entries);
+	lept_cache_free(c);
+
+	test_cache_shared = lept_cache_new(1 << 20);
+	for (i = 0; i < TEST_CACHE_THREADS; i++) {
+		pthread_create(&threads[i], NULL, test_cache_reader, NULL);
+	}
+	for (i = 0; i < TEST_CACHE_THREADS; i++) {
+		pthread_join(threads[i], &sum);
+		ok += (size_t)sum == 3000;
+	}
+	EXPECT_EQ_SIZE_T(TEST_CACHE_THREADS, ok);
+	lept_cache_get_stats(test_cache_shared, &st);
+	EXPECT_EQ_SIZE_T(3, st.entries);
+	EXPECT_EQ_SIZE_T(TEST_CACHE_THREADS * 3000, st.hits + st.misses);
+	lept_cache_free(test_cache_shared);
+}
+
+static void test_reclaim () {
+	lept_reclaim_stats st, before;
+	lept_value v;
+	lept_value* p;
+	size_t i;
+
+	lept_reclaim_get_stats(&before);
+
+	/* 标量和空容器直接释放，不入队 */
+	lept_init(&v);
+	lept_set_string(&v, "abc", 3);
+	lept_free_deferred(&v);
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[]"));
+	lept_free_deferred(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[1,2,3]", LEPT_PARSE_PACKED_NUMBERS));
+	lept_free_deferred(&v);
+	lept_reclaim_drain();
+	lept_reclaim_get_stats(&st);
+	EXPECT_EQ_SIZE_T(before.freed, st.freed);
+
+	for (i = 0; i < 100; i++) {
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":[1,{\"b\":\"c\"},[[]]],\"d\":{}}"));
+		lept_free_deferred(&v);
+		EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	}
+	lept_reclaim_drain();
+	lept_reclaim_get_stats(&st);
+	EXPECT_EQ_SIZE_T(0, st.queued);
+	EXPECT_EQ_SIZE_T(before.freed + 100, st.freed);
+	/* 整棵树：3 个成员、4 个数组元素、键 "a" "d" "b" 和字符串 "c" */
+	EXPECT_EQ_SIZE_T(before.freed_bytes + 100 * (3 * sizeof(lept_member) + 4 * sizeof(lept_value) + 8), st.freed_bytes);
+
+	/* 很深的树，lept_free 和后台线程都不会栈溢出 */
+	for (i = 0; i < 2; i++) {
+		size_t depth;
+		lept_set_object(&v, 0);
+		p = &v;
+		for (depth = 0; depth < 200000; depth++) {
+			p = lept_set_object_value(p, "a", 1);
+			lept_set_array(p, 0);
+			p = lept_pushback_array_element(p);
+			lept_set_object(p, 0);
+		}
+		if (i == 0) {
+			lept_free(&v);
+		} else {
+			lept_free_deferred(&v);
+		}
+		EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	}
+
+	/* shutdown 之前入队的树都会释放，之后再入队会重新启动后台线程 */
+	lept_reclaim_shutdown();
+	lept_reclaim_get_stats(&st);
+	EXPECT_EQ_SIZE_T(0, st.queued);
+	EXPECT_EQ_SIZE_T(before.freed + 101, st.freed);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[[1],[2]]"));
+	lept_free_deferred(&v);
+	lept_reclaim_shutdown();
+	lept_reclaim_get_stats(&st);
+	EXPECT_EQ_SIZE_T(before.freed + 102, st.freed);
+}
+
+/**
+ * 把 json 写进临时文件，逐个读出元素，拼成一个数组后和 lept_parse 的结果比较。
+ */
+static void test_array_reader_file (const char* json, size_t len, int use_fd) {
+	FILE* fp = tmpfile();
+	lept_array_reader* r;
+	lept_value expect, actual, e;
+	int ret;
+
+	fwrite(json, 1, len, fp);
+	rewind(fp);
+	r = use_fd ? lept_array_reader_open_fd(fileno(fp), 0) : lept_array_reader_open_file(fp, 0);
+	lept_init(&expect);
+	lept_init(&actual);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&expect, json));
+	lept_set_array(&actual, 0);
+	while ((ret = lept_array_reader_next(r, &e)) == LEPT_PARSE_OK) {
+		lept_move(lept_pushback_array_element(&actual), &e);
+	}
+	EXPECT_EQ_INT(LEPT_READER_END, ret);
+	EXPECT_EQ_INT(LEPT_READER_END, lept_array_reader_next(r, &e));
+	EXPECT_EQ_SIZE_T(len, lept_array_reader_offset(r));
+	EXPECT_TRUE(lept_is_equal(&expect, &actual));
+	lept_array_reader_close(r);
+	lept_free(&expect);
+	lept_free(&actual);
+	fclose(fp);
+}
+
+#define TEST_ARRAY_READER_ERROR(error, json, count)\
+	do {\
+		FILE* fp = tmpfile();\
+		lept_array_reader* r;\
+		lept_value e;\
+		size_t n = 0;\
+		int ret;\
+		fputs(json, fp);\
+		rewind(fp);\
+		r = lept_array_reader_open_file(fp, 0);\
+		while ((ret = lept_array_reader_next(r, &e)) == LEPT_PARSE_OK) {\
+			lept_free(&e);\
+			n++;\
+		}\
+		EXPECT_EQ_INT(error, ret);\
+		EXPECT_EQ_INT(error, lept_array_reader_next(r, &e));\
+		EXPECT_EQ_SIZE_T(count, n);\
+		lept_array_reader_close(r);\
+		fclose(fp);\
+	} while(0)
+
+static void test_array_reader () {
+	static const char* small[] = {
+		"[]", " [ ] \n", "[1]", "[ 1 , \"a\" , true , null , false ]",
+		"[{\"a\":[1,2,{\"b\":\"]\"}]},[[]],\"\\\"]\",-1.5e10]"
+	};
+	char* json;
+	size_t i, n = 0, cap = 4 * LEPT_READER_BUFFER_SIZE + 4096;
+
+	for (i = 0; i < sizeof(small) / sizeof(small[0]); i++) {
+		test_array_reader_file(small[i], strlen(small[i]), 0);
+		test_array_reader_file(small[i], strlen(small[i]), 1);
+	}
+
+	/* 元素跨过缓冲区边界，其中一个元素比初始缓冲区还大 */
+	json = (char*)malloc(cap);
+	json[n++] = '[';
+	for (i = 0; n < LEPT_READER_BUFFER_SIZE + 100; i++) {
+		n += sprintf(json + n, "%s{\"id\":%d,\"v\":12345.678}", i ? ", " : "", (int)i);
+	}
+	memcpy(json + n, ",\"", 2);
+	n += 2;
+	memset(json + n, 'x', 2 * LEPT_READER_BUFFER_SIZE);
+	n += 2 * LEPT_READER_BUFFER_SIZE;
+	n += sprintf(json + n, "\",123456789,[1,2,3]]  ");
+	json[n] = '\0';
+	test_array_reader_file(json, n, 0);
+	test_array_reader_file(json, n, 1);
+	free(json);
+
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_EXPECT_VALUE, "", 0);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"a\":1}", 0);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_EXPECT_VALUE, "[", 0);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1,2", 2);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]", 1);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_INVALID_VALUE, "[1,]", 1);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_INVALID_VALUE, "[1,,2]", 1);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_INVALID_VALUE, "[1,tru,3]", 1);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, "[1,\"abc", 1);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "[{\"a\":1]", 0);
+	TEST_ARRAY_READER_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "[1,2] 3", 2);
+}
+
+/**
+ * 编辑之后的树和完整解析当前文本的结果相同。
+ */
+static void test_editor_check (lept_editor* e, unsigned flags) {
+	lept_value v;
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, lept_editor_text(e, NULL), flags));
+	EXPECT_TRUE(lept_is_equal(&v, lept_editor_root(e)));
+	lept_free(&v);
+}
+
+static size_t test_editor_offset (lept_editor* e, const char* s) {
+	const char* text = lept_editor_text(e, NULL);
+	return (size_t)(strstr(text, s) - text);
+}
+
+static void test_editor_random (unsigned flags) {
+	static const char* tokens[] = {
+		"", " ", "1", "-2.5", "\"s\"", "\"\\u00e9\"", ",", ":", "[", "]", "{", "}", "null", "true",
+		"[3,4]", "{\"k\":[5]}", "\"k\":6,"
+	};
+	const char* json = "{\"a\":[1,[2,3],{\"b\":[4,5,6]},\"x\"],\"c\":{\"d\":{\"e\":[7,[8,[9]]]},\"f\":\"y\"},\"g\":[10,11]}";
+	lept_editor* e = lept_editor_new(flags);
+	lept_value expect;
+	char* buf = (char*)malloc(4096);
+	int i, ret;
+
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_load(e, json, strlen(json)));
+	srand(45);
+	for (i = 0; i < 2000; i++) {
+		size_t len, n = 0;
+		const char* text = lept_editor_text(e, &len);
+		const char* token = tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+		size_t offset = (size_t)rand() % (len + 1);
+		size_t count = (size_t)rand() % 4;
+		if (count > len - offset || len > 2000) {
+			count = len - offset < 2 ? len - offset : 2;
+		}
+
+		memcpy(buf, text, offset);
+		n = offset;
+		memcpy(buf + n, token, strlen(token));
+		n += strlen(token);
+		memcpy(buf + n, text + offset + count, len - offset - count);
+		n += len - offset - count;
+		buf[n] = '\0';
+
+		/* 不合法的修改返回和完整解析相同的错误，文本不变 */
+		lept_init(&expect);
+		ret = lept_parse_ex(&expect, buf, flags);
+		EXPECT_EQ_INT(ret, lept_editor_replace(e, offset, count, token, strlen(token)));
+		if (ret == LEPT_PARSE_OK) {
+			EXPECT_EQ_STRING(buf, lept_editor_text(e, NULL), n + 1);
+			EXPECT_TRUE(lept_is_equal(&expect, lept_editor_root(e)));
+		} else {
+			EXPECT_EQ_SIZE_T(len, strlen(lept_editor_text(e, NULL)));
+		}
+		lept_free(&expect);
+	}
+	test_editor_check(e, flags);
+	free(buf);
+	lept_editor_free(e);
+}
+
+static void test_editor () {
+	const char* json = " {\"a\":[1,{\"b\":\"x\"},3], \"c\":{\"d\":[true,null]}, \"e\":\"keep\"} ";
+	lept_editor* e = lept_editor_new(LEPT_PARSE_DEFAULT_FLAGS);
+	lept_editor_stats stats;
+	const lept_value* root;
+	const lept_value* c;
+	const char* keep;
+	char* before;
+	size_t reparsed;
+
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_load(e, json, strlen(json)));
+	root = lept_editor_root(e);
+	c = lept_find_object_value((lept_value*)root, "c", 1);
+	keep = lept_get_string(lept_find_object_value((lept_value*)root, "e", 1));
+
+	/* 只解析 {"b":...}，兄弟和祖先原地保留 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_replace(e, test_editor_offset(e, "\"x\"") + 1, 1, "yy", 2));
+	test_editor_check(e, 0);
+	lept_editor_get_stats(e, &stats);
+	EXPECT_EQ_SIZE_T(1, stats.edits);
+	EXPECT_EQ_SIZE_T(1, stats.full_parses);
+	EXPECT_EQ_SIZE_T(strlen(json) - 1 + strlen("{\"b\":\"yy\"}"), stats.reparsed_bytes);
+	EXPECT_TRUE(root == lept_editor_root(e));
+	EXPECT_TRUE(c == lept_find_object_value((lept_value*)root, "c", 1));
+	EXPECT_TRUE(keep == lept_get_string(lept_find_object_value((lept_value*)root, "e", 1)));
+
+	/* 前面的修改使后面的区间后移 */
+	reparsed = stats.reparsed_bytes;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_replace(e, test_editor_offset(e, "null"), 4, "false", 5));
+	test_editor_check(e, 0);
+	lept_editor_get_stats(e, &stats);
+	EXPECT_EQ_SIZE_T(reparsed + strlen("[true,false]"), stats.reparsed_bytes);
+
+	/* 修改键时重新解析所在的对象 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_replace(e, test_editor_offset(e, "\"d\"") + 1, 1, "dd", 2));
+	test_editor_check(e, 0);
+	EXPECT_TRUE(lept_find_object_value((lept_value*)c, "dd", 2) != NULL);
+
+	/* 括号的配对变了，改为解析外层 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_replace(e, test_editor_offset(e, "3]"), 1, "3],\"z\":[4", 9));
+	test_editor_check(e, 0);
+	EXPECT_EQ_SIZE_T(4, lept_get_object_size(lept_editor_root(e)));
+
+	/* 出错时文本和树都不变 */
+	before = strdup(lept_editor_text(e, NULL));
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_editor_replace(e, test_editor_offset(e, "true"), 4, "tru", 3));
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_editor_replace(e, test_editor_offset(e, "\"keep\"}") + 6, 1, "", 0));
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_editor_replace(e, 0, 0, "1", 1));
+	EXPECT_EQ_STRING(before, lept_editor_text(e, NULL), strlen(before) + 1);
+	test_editor_check(e, 0);
+	free(before);
+
+	/* 根之外的空白和整个根 */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_replace(e, 0, 1, "\n\n", 2));
+	test_editor_check(e, 0);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_editor_replace(e, 0, strlen(lept_editor_text(e, NULL)), "\"s\"", 3));
+	EXPECT_EQ_INT(LEPT_STRING, lept_get_type(lept_editor_root(e)));
+	EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_editor_load(e, " ", 1));
+	EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_editor_load(e, "1\0 2", 4));
+	EXPECT_EQ_INT(LEPT_STRING, lept_get_type(lept_editor_root(e)));
+	lept_editor_free(e);
+
+	test_editor_random(LEPT_PARSE_DEFAULT_FLAGS);
+	test_editor_random(LEPT_PARSE_PACKED_NUMBERS);
 }
 
 int main () {
 	test_parse();
 	test_access();
+	test_msgpack();
+	test_snapshot();
+	test_stringify();
+	test_writer();
+	test_stringify_parallel();
+	test_minify();
+	test_validate();
+	test_shared();
+	test_merge_patch();
+	test_equal();
+	test_apply_patch();
+	test_cache();
+	test_reclaim();
+	test_array_reader();
+	test_editor();
 
 	printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
 	return main_ret;
@@ -0,0 +1,296 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "leptjson.hpp"
+#include "leptbind.hpp"
+
+/**
+ * test.cpp
+ * leptjson.hpp 和 leptbind.hpp 的测试，沿用 test.c 的极简测试框架。
+ */
+
+static int main_ret = 0;
+static int test_count = 0;
+static int test_pass = 0;
+
+#define EXPECT_EQ_BASE(equality, expect, actual, format)\
+	do {\
+		test_count++;\
+		if (equality)\
+			test_pass++;\
+		else {\
+			fprintf(stderr, "%s:%d: expect: " format " actual: " format "\n", __FILE__, __LINE__, expect, actual);\
+			main_ret = 1;\
+		}\
+	} while(0)
+
+#define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (int)(expect), (int)(actual), "%d")
+#define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%.10g")
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)(expect), (size_t)(actual), "%zu")
+#define EXPECT_EQ_VIEW(expect, actual) EXPECT_EQ_BASE(std::string_view(expect) == (actual), std::string(expect).c_str(), std::string(actual).c_str(), "%s")
+#define EXPECT_TRUE(actual) EXPECT_EQ_BASE(static_cast<bool>(actual), "true", "false", "%s")
+#define EXPECT_FALSE(actual) EXPECT_EQ_BASE(!static_cast<bool>(actual), "false", "true", "%s")
+
+static_assert(!std::is_copy_constructible<lept::document>::value, "document is move-only");
+static_assert(std::is_nothrow_move_constructible<lept::document>::value, "document moves without throwing");
+static_assert(std::is_trivially_copyable<lept::value_ref>::value, "views are plain pointers");
+static_assert(sizeof(lept::array_view) == sizeof(void*), "array_view is one pointer");
+#if __cplusplus >= 202002L
+static_assert(std::random_access_iterator<lept::array_view::iterator>);
+static_assert(std::random_access_iterator<lept::object_view::iterator>);
+#endif
+
+static void test_document () {
+	lept::document doc;
+	std::error_code ec = doc.parse("{\"id\":7,\"name\":\"a\\u0000b\",\"ok\":true,\"tags\":[\"x\",null]}");
+	EXPECT_FALSE(ec);
+	lept::value_ref root = doc.root();
+	EXPECT_TRUE(root.is_object());
+	EXPECT_EQ_DOUBLE(7.0, root["id"].get_number());
+	EXPECT_TRUE(root["ok"].get_boolean());
+	EXPECT_TRUE(root["tags"][1].is_null());
+
+	/* string_view 直接指向树中的字符串，包括中间的 '\0' */
+	std::string_view name = root["name"].get_string();
+	EXPECT_EQ_SIZE_T(3, name.size());
+	EXPECT_TRUE(name == std::string_view("a\0b", 3));
+	EXPECT_TRUE(name.data() == root["name"].c_value()->u.s.s);
+
+	lept::value_ref found = root;
+	EXPECT_TRUE(root.find("ok", found));
+	EXPECT_TRUE(found.is_boolean());
+	EXPECT_FALSE(root.find("missing", found));
+	EXPECT_TRUE(found.is_boolean());
+
+	/* 移动之后原对象为 null，树只有一份 */
+	const lept_member* tree = doc.c_value()->u.o.m;
+	lept::document moved(std::move(doc));
+	EXPECT_TRUE(doc.root().is_null());
+	EXPECT_TRUE(moved.c_value()->u.o.m == tree);
+	doc = std::move(moved);
+	EXPECT_TRUE(doc.c_value()->u.o.m == tree);
+
+	lept_value raw = doc.release();
+	EXPECT_TRUE(doc.root().is_null());
+	lept::document adopted(&raw);
+	EXPECT_TRUE(raw.type == LEPT_NULL);
+	EXPECT_EQ_SIZE_T(4, adopted.root().get_object().size());
+
+	ec = doc.parse(std::string("[1 2]"));
+	EXPECT_TRUE(ec == lept::parse_error::miss_comma_or_square_bracket);
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, ec.value());
+	EXPECT_EQ_VIEW("LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET", ec.message());
+	EXPECT_EQ_VIEW("leptjson", ec.category().name());
+	EXPECT_TRUE(doc.root().is_null());
+}
+
+static void test_iterators () {
+	lept::document doc;
+	EXPECT_FALSE(doc.parse("{\"a\":[3,1,2],\"b\":[\"x\",{\"c\":1},[]],\"\":{}}"));
+	lept::object_view obj = doc.root().get_object();
+
+	std::vector<std::string_view> keys;
+	for (lept::member_ref m : obj) {
+		keys.push_back(m.key);
+	}
+	EXPECT_EQ_SIZE_T(3, keys.size());
+	EXPECT_EQ_VIEW("a", keys[0]);
+	EXPECT_EQ_VIEW("b", keys[1]);
+	EXPECT_EQ_VIEW("", keys[2]);
+	EXPECT_EQ_VIEW("b", obj[1].key);
+	EXPECT_EQ_SIZE_T(3, obj.end() - obj.begin());
+	EXPECT_TRUE((*(obj.begin() + 2)).key.empty());
+
+	lept::array_view a = doc.root()["a"].get_array();
+	double sum = 0;
+	for (lept::value_ref e : a) {
+		sum += e.get_number();
+	}
+	EXPECT_EQ_DOUBLE(6.0, sum);
+	EXPECT_TRUE(a.numbers() == nullptr);
+	EXPECT_EQ_DOUBLE(2.0, a.begin()[2].get_number());
+	EXPECT_EQ_DOUBLE(1.0, (*(a.end() - 2)).get_number());
+	EXPECT_TRUE(a.begin() < a.end());
+	EXPECT_TRUE(std::max_element(a.begin(), a.end(), [](lept::value_ref x, lept::value_ref y) {
+		return x.get_number() < y.get_number();
+	}) == a.begin());
+
+	lept::array_view b = doc.root()["b"].get_array();
+	EXPECT_EQ_SIZE_T(3, b.size());
+	EXPECT_EQ_VIEW("x", b[0].get_string());
+	EXPECT_EQ_DOUBLE(1.0, b[1]["c"].get_number());
+	EXPECT_TRUE(b[2].get_array().empty());
+	EXPECT_TRUE(doc.root()[""].get_object().empty());
+}
+
+static void test_packed () {
+	lept::document packed, plain;
+	EXPECT_FALSE(packed.parse("[1.5,2.5,-3]", LEPT_PARSE_PACKED_NUMBERS));
+	EXPECT_FALSE(plain.parse("[1.5,2.5,-3]"));
+	lept::array_view a = packed.root().get_array();
+	EXPECT_TRUE(a.numbers() != nullptr);
+	EXPECT_EQ_SIZE_T(3, a.size());
+	EXPECT_TRUE(a[1].c_value() == nullptr);
+	EXPECT_TRUE(a[1].is_number());
+	EXPECT_EQ_DOUBLE(2.5, a[1].get_number());
+
+	double sum = 0;
+	for (lept::value_ref e : a) {
+		sum += e.get_number();
+	}
+	EXPECT_EQ_DOUBLE(1.0, sum);
+	EXPECT_TRUE(packed.root() == plain.root());
+	EXPECT_TRUE(a[2] == plain.root()[2]);
+	EXPECT_TRUE(a[0] != a[1]);
+	/* 只读访问不会展开紧凑数组 */
+	EXPECT_TRUE(lept_is_array_packed(packed.c_value()));
+}
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+static void test_expected () {
+	auto doc = lept::parse("{\"items\":[{\"price\":1.5},{\"price\":2}]}");
+	EXPECT_TRUE(doc.has_value());
+	double total = 0;
+	for (lept::value_ref item : doc->root()["items"].get_array()) {
+		total += item["price"].get_number();
+	}
+	EXPECT_EQ_DOUBLE(3.5, total);
+
+	auto bad = lept::parse(std::string("{\"a\" 1}"));
+	EXPECT_FALSE(bad.has_value());
+	EXPECT_TRUE(bad.error() == lept::parse_error::miss_colon);
+}
+#endif
+
+struct bind_point {
+	double x;
+	double y;
+};
+LEPT_BIND(bind_point, LEPT_REQUIRED_FIELD(bind_point, x), LEPT_REQUIRED_FIELD(bind_point, y));
+
+struct bind_order {
+	std::int64_t id;
+	unsigned qty;
+	float price;
+	bool paid;
+	std::string name;
+	std::optional<std::string> note;
+	std::vector<std::string> tags;
+	std::vector<bind_point> path;
+	std::optional<bind_point> origin;
+};
+LEPT_BIND(bind_order,
+	LEPT_REQUIRED_FIELD(bind_order, id),
+	LEPT_FIELD(bind_order, qty),
+	LEPT_FIELD(bind_order, price),
+	LEPT_FIELD(bind_order, paid),
+	lept::make_field("display name", &bind_order::name),
+	LEPT_FIELD(bind_order, note),
+	LEPT_FIELD(bind_order, tags),
+	LEPT_FIELD(bind_order, path),
+	LEPT_FIELD(bind_order, origin));
+
+/* 完美哈希在编译期算出 */
+static_assert(lept::detail::object_binder<bind_order>::plan.size >= 16, "table is at least twice the field count");
+static_assert(lept::detail::object_binder<bind_order>::required == 1, "only id is required");
+
+#define TEST_BIND_ERROR(error, json)\
+	do {\
+		bind_order o;\
+		EXPECT_TRUE(lept::parse_into(json, o) == error);\
+	} while(0)
+
+static void test_bind () {
+	bind_order o;
+	o.qty = 99;
+	EXPECT_FALSE(lept::parse_into(
+		" { \"id\" : 9007199254740993, \"price\": 2.5, \"paid\": true, \"display name\": \"a\\u00e9\\n\","
+		"\"extra\": {\"id\": [1, {\"x\": null}]}, \"note\": null, \"tags\": [\"x\", \"\"],"
+		"\"path\": [{\"y\": 2, \"x\": 1e0}, {\"x\": -3, \"y\": 4.5}], \"origin\": {\"x\": 0, \"y\": 0} } ", o));
+	EXPECT_EQ_INT(1, o.id == 9007199254740993LL);	/* 整数不经过 double */
+	EXPECT_EQ_INT(99, o.qty);						/* 没有出现的字段保持原值 */
+	EXPECT_EQ_DOUBLE(2.5, o.price);
+	EXPECT_TRUE(o.paid);
+	EXPECT_EQ_VIEW("a\xC3\xA9\n", o.name);
+	EXPECT_FALSE(o.note.has_value());
+	EXPECT_EQ_SIZE_T(2, o.tags.size());
+	EXPECT_EQ_VIEW("", o.tags[1]);
+	EXPECT_EQ_SIZE_T(2, o.path.size());
+	EXPECT_EQ_DOUBLE(1.0, o.path[0].x);
+	EXPECT_EQ_DOUBLE(4.5, o.path[1].y);
+	EXPECT_TRUE(o.origin.has_value());
+
+	/* 重复解析时数组和字符串先清空，带转义的键也能匹配 */
+	EXPECT_FALSE(lept::parse_into(std::string("{\"\\u0069d\":1,\"qty\":3e2,\"tags\":[],\"note\":\"n\",\"id\":2}"), o));
+	EXPECT_EQ_INT(2, o.id);
+	EXPECT_EQ_INT(300, o.qty);
+	EXPECT_TRUE(o.tags.empty());
+	EXPECT_EQ_VIEW("n", *o.note);
+
+	std::vector<bind_point> points;
+	EXPECT_FALSE(lept::parse_into("[{\"x\":1,\"y\":2}]", points));
+	EXPECT_EQ_SIZE_T(1, points.size());
+	bool b = false;
+	EXPECT_FALSE(lept::parse_into("true", b));
+	EXPECT_TRUE(b);
+
+	TEST_BIND_ERROR(lept::parse_error::miss_required_field, "{}");
+	TEST_BIND_ERROR(lept::parse_error::miss_required_field, "{\"id\":1,\"path\":[{\"x\":1}]}");
+	TEST_BIND_ERROR(lept::parse_error::type_mismatch, "{\"id\":\"1\"}");
+	TEST_BIND_ERROR(lept::parse_error::type_mismatch, "{\"id\":1.5}");
+	TEST_BIND_ERROR(lept::parse_error::type_mismatch, "{\"id\":1,\"qty\":-1}");
+	TEST_BIND_ERROR(lept::parse_error::type_mismatch, "{\"id\":1,\"paid\":null}");
+	TEST_BIND_ERROR(lept::parse_error::type_mismatch, "{\"id\":1,\"tags\":\"x\"}");
+	TEST_BIND_ERROR(lept::parse_error::type_mismatch, "[]");
+	TEST_BIND_ERROR(lept::parse_error::number_too_big, "{\"id\":9223372036854775808}");
+	TEST_BIND_ERROR(lept::parse_error::number_too_big, "{\"id\":1,\"qty\":4294967296}");
+	TEST_BIND_ERROR(lept::parse_error::number_too_big, "{\"id\":1,\"price\":1e300}");
+	TEST_BIND_ERROR(lept::parse_error::expect_value, " ");
+	TEST_BIND_ERROR(lept::parse_error::miss_comma_or_curly_bracket, "{\"id\":01}");	/* 同 lept_parse：0 之后不能再有数字 */
+	TEST_BIND_ERROR(lept::parse_error::invalid_value, "{\"id\":1,\"paid\":tru}");
+	TEST_BIND_ERROR(lept::parse_error::invalid_value, "{\"id\":1,\"extra\":[nul]}");
+	TEST_BIND_ERROR(lept::parse_error::miss_key, "{\"id\":1,}");
+	TEST_BIND_ERROR(lept::parse_error::miss_colon, "{\"id\" 1}");
+	TEST_BIND_ERROR(lept::parse_error::miss_comma_or_curly_bracket, "{\"id\":1");
+	TEST_BIND_ERROR(lept::parse_error::miss_comma_or_square_bracket, "{\"id\":1,\"tags\":[\"a\"}");
+	TEST_BIND_ERROR(lept::parse_error::miss_quotation_mark, "{\"id\":1,\"display name\":\"abc");
+	TEST_BIND_ERROR(lept::parse_error::invalid_string_escape, "{\"id\":1,\"display name\":\"\\v\"}");
+	TEST_BIND_ERROR(lept::parse_error::invalid_string_char, "{\"id\":1,\"display name\":\"\x01\"}");
+	TEST_BIND_ERROR(lept::parse_error::invalid_unicode_surrogate, "{\"id\":1,\"display name\":\"\\uD800\"}");
+	TEST_BIND_ERROR(lept::parse_error::root_not_singular, "{\"id\":1} x");
+
+	/* 未绑定的键默认按语法检查，LEPT_PARSE_TRUST_SKIPPED 时只匹配括号 */
+	const char* loose = "{\"id\":1,\"extra\":[1,,2]}";
+	EXPECT_TRUE(lept::parse_into(loose, o) == lept::parse_error::invalid_value);
+	EXPECT_FALSE(lept::parse_into(loose, o, LEPT_PARSE_TRUST_SKIPPED));
+
+	const char* bad_utf8 = "{\"id\":1,\"display name\":\"\xC0\xAF\"}";
+	EXPECT_FALSE(lept::parse_into(bad_utf8, o));
+	EXPECT_TRUE(lept::parse_into(bad_utf8, o, LEPT_PARSE_VALIDATE_UTF8) == lept::parse_error::invalid_utf8);
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+	auto parsed = lept::parse_as<bind_point>("{\"x\":1,\"y\":2}");
+	EXPECT_TRUE(parsed.has_value());
+	EXPECT_EQ_DOUBLE(2.0, parsed->y);
+	EXPECT_TRUE(lept::parse_as<bind_point>("{\"x\":1}").error() == lept::parse_error::miss_required_field);
+#endif
+}
+
+int main () {
+	test_document();
+	test_iterators();
+	test_packed();
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+	test_expected();
+#endif
+	test_bind();
+
+	printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
+	return main_ret;
+}